@@ -0,0 +1,357 @@
+/*
+ *
+ *  PRU Debug Program - memory and control backends
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "prudbg.h"
+#include "backend.h"
+#include "uio.h"
+#include "sim.h"
+
+struct pru_backend		*pru_be;
+
+// bulk reads: one 128-bit NEON load per burst where there is NEON, one
+// 64-bit load otherwise; the mapping is page aligned, so aligning the
+// PRUSS offset aligns the access
+#ifdef __ARM_NEON
+#define PRU_BURST		16
+
+static inline void burst_read(volatile uint32_t *src, unsigned char *d)
+{
+	vst1q_u8(d, vreinterpretq_u8_u32(vld1q_u32((const uint32_t *)src)));
+}
+#else
+#define PRU_BURST		8
+
+static inline void burst_read(volatile uint32_t *src, unsigned char *d)
+{
+	uint64_t		v = *(volatile uint64_t *)src;
+
+	memcpy(d, &v, 8);
+}
+#endif
+
+// map len bytes of fd at offset into be, keeping fd open
+static int map_fd(struct pru_backend *be, int fd, size_t len, off_t offset)
+{
+	void			*p;
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+	if (p == MAP_FAILED) {
+		printf("ERROR: could not map memory.\n\n");
+		close(fd);
+		return -1;
+	}
+	be->mem = p;
+	be->len = len;
+	be->fd = fd;
+	return 0;
+}
+
+static void unmap_close(struct pru_backend *be)
+{
+	munmap((void *)be->mem, be->len);
+	if (be->fd != -1)
+		close(be->fd);
+}
+
+// the PRUSS instance arg names by index, NULL (after an error) if none
+static const struct pruss_instance *instance_arg(const char *arg)
+{
+	const struct pruss_instance *p;
+	unsigned int		n;
+	unsigned long		i = strtoul(arg, NULL, 10);
+
+	p = pruss_instances(&n);
+	if (i >= n) {
+		printf("ERROR: no PRUSS instance %lu, %u found (see -l).\n\n", i, n);
+		return NULL;
+	}
+	return &p[i];
+}
+
+// bytes to map for instance p: what sysfs says, checked against the layout
+static int instance_len(const struct pruss_instance *p, const struct pru_layout *l, size_t *len)
+{
+	*len = l->pruss_len;
+	if (!p || !p->map.length)
+		return 0;
+	if (p->map.length < l->pruss_len) {
+		printf("ERROR: %s maps 0x%lx bytes, the selected processor needs 0x%x.\n\n",
+		       p->name, p->map.length, l->pruss_len);
+		return -1;
+	}
+	*len = p->map.length;
+	return 0;
+}
+
+// uio: arg is an instance index or a /dev/uio* file, by default the first
+// instance with a UIO device
+
+static int uio_open(struct pru_backend *be, const struct pru_layout *l, const char *arg)
+{
+	const struct pruss_instance *p = NULL, *all;
+	char			dev[UIO_MAX_DEV_NAME];
+	unsigned int		i, n;
+	size_t			len;
+	int			fd;
+
+	if (!arg) {
+		all = pruss_instances(&n);
+		for (i = 0; i < n && !p; i++) {
+			if (all[i].uio_file[0])
+				p = &all[i];
+		}
+		if (!p)
+			return -1;
+	} else if (isdigit((unsigned char)arg[0])) {
+		p = instance_arg(arg);
+		if (!p)
+			return -1;
+		if (!p->uio_file[0]) {
+			printf("ERROR: PRUSS instance %s has no UIO device.\n\n", arg);
+			return -1;
+		}
+	} else {
+		p = pruss_find_uio(arg);
+	}
+	snprintf(dev, sizeof(dev), "%s", p ? p->uio_file : arg);
+	if (instance_len(p, l, &len))
+		return -1;
+	fd = open(dev, O_RDWR | O_SYNC);
+	if (fd == -1) {
+		printf("ERROR: could not open %s.\n\n", dev);
+		return -1;
+	}
+	return map_fd(be, fd, len, 0);
+}
+
+// /dev/mem: at the processor's PRUSS address, or that of instance arg
+
+static int devmem_open(struct pru_backend *be, const struct pru_layout *l, const char *arg)
+{
+	const struct pruss_instance *p = NULL;
+	unsigned long		address = l->address;
+	size_t			len;
+	int			fd;
+
+	if (arg) {
+		p = instance_arg(arg);
+		if (!p)
+			return -1;
+		address = p->map.address;
+	}
+	if (instance_len(p, l, &len))
+		return -1;
+	fd = open("/dev/mem", O_RDWR | O_SYNC);
+	if (fd == -1) {
+		printf("ERROR: could not open /dev/mem.\n\n");
+		return -1;
+	}
+	return map_fd(be, fd, len, address);
+}
+
+// file image
+
+static int file_open(struct pru_backend *be, const struct pru_layout *l, const char *arg)
+{
+	struct stat		st;
+	int			fd;
+
+	if (!arg) {
+		printf("ERROR: the file backend needs an image file name.\n\n");
+		return -1;
+	}
+	fd = open(arg, O_RDWR | O_CREAT, 0644);
+	if (fd == -1 || fstat(fd, &st)) {
+		printf("ERROR: could not open %s.\n\n", arg);
+		if (fd != -1)
+			close(fd);
+		return -1;
+	}
+	if ((size_t)st.st_size < l->pruss_len && ftruncate(fd, l->pruss_len)) {
+		printf("ERROR: could not grow %s to 0x%x bytes.\n\n", arg, l->pruss_len);
+		close(fd);
+		return -1;
+	}
+	return map_fd(be, fd, l->pruss_len, 0);
+}
+
+// anonymous memory
+
+static int anon_open(struct pru_backend *be, const struct pru_layout *l, const char *arg)
+{
+	void			*p;
+
+	p = mmap(NULL, l->pruss_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		printf("ERROR: could not map memory.\n\n");
+		return -1;
+	}
+	be->mem = p;
+	be->len = l->pruss_len;
+	return 0;
+}
+
+// simulator
+
+static int sim_be_open(struct pru_backend *be, const struct pru_layout *l, const char *arg)
+{
+	struct sim		*s = sim_create(l);
+
+	if (!s) {
+		printf("ERROR: could not create the simulator.\n\n");
+		return -1;
+	}
+	be->priv = s;
+	be->mem = sim_mem(s);
+	be->len = l->pruss_len;
+	return 0;
+}
+
+static void sim_be_close(struct pru_backend *be)
+{
+	sim_free(be->priv);
+}
+
+static void sim_be_ctrl_written(struct pru_backend *be, unsigned int p, unsigned int reg)
+{
+	if (reg == PRU_CTRL_REG)
+		sim_ctrl(be->priv, p);
+}
+
+static int sim_be_halt_fd(struct pru_backend *be)
+{
+	return sim_halt_fd(be->priv);
+}
+
+static const struct pru_backend_ops backends[] = {
+	{"uio",		uio_open,	unmap_close,	NULL,			NULL},
+	{"mem",		devmem_open,	unmap_close,	NULL,			NULL},
+	{"file",	file_open,	unmap_close,	NULL,			NULL},
+	{"anon",	anon_open,	unmap_close,	NULL,			NULL},
+	{"sim",		sim_be_open,	sim_be_close,	sim_be_ctrl_written,	sim_be_halt_fd},
+};
+
+#define NUM_BACKENDS		(sizeof(backends) / sizeof(backends[0]))
+
+// open the backend called name, arg is backend specific; NULL on errors
+struct pru_backend *pru_backend_open(const char *name, const struct pru_layout *l, const char *arg)
+{
+	struct pru_backend	*be;
+	unsigned int		i;
+
+	for (i = 0; i < NUM_BACKENDS && strcmp(backends[i].name, name); i++)
+		;
+	if (i == NUM_BACKENDS) {
+		printf("ERROR: unknown backend %s, use one of: %s\n\n", name, pru_backend_names());
+		return NULL;
+	}
+	be = calloc(1, sizeof(*be));
+	if (!be)
+		return NULL;
+	be->ops = &backends[i];
+	be->fd = -1;
+	if (be->ops->open(be, l, arg)) {
+		free(be);
+		return NULL;
+	}
+	return be;
+}
+
+void pru_backend_close(struct pru_backend *be)
+{
+	if (!be)
+		return;
+	be->ops->close(be);
+	free(be);
+}
+
+const char *pru_backend_names()
+{
+	return "uio[:<instance>|<device>], mem[:<instance>], file:<image>, anon, sim";
+}
+
+// Copy len bytes from byte offset off of the PRUSS.  Device memory is only
+// read with aligned 32-bit or wider loads: the partial words at either end
+// are read whole and just the wanted bytes kept, single words are read up
+// to the burst alignment and the body goes one burst at a time.
+void pru_read_block(unsigned int off, void *dst, size_t len)
+{
+	volatile uint32_t	*w = pru_be->mem;
+	unsigned char		*d = dst;
+	unsigned int		k;
+	uint32_t		v;
+
+	if (len && (off & 3)) {
+		v = w[off / 4];
+		k = 4 - (off & 3);
+		if (k > len)
+			k = len;
+		memcpy(d, (unsigned char *)&v + (off & 3), k);
+		d += k;
+		off += k;
+		len -= k;
+	}
+	for (; len >= 4 && (off & (PRU_BURST - 1)); len -= 4, off += 4, d += 4) {
+		v = w[off / 4];
+		memcpy(d, &v, 4);
+	}
+	for (; len >= PRU_BURST; len -= PRU_BURST, off += PRU_BURST, d += PRU_BURST)
+		burst_read(&w[off / 4], d);
+	for (; len >= 4; len -= 4, off += 4, d += 4) {
+		v = w[off / 4];
+		memcpy(d, &v, 4);
+	}
+	if (len) {
+		v = w[off / 4];
+		memcpy(d, &v, len);
+	}
+}
+
+// Copy len bytes from src (zeros if src is NULL) to byte offset off of the
+// PRUSS, with aligned 32-bit stores for the bulk.
+void pru_write_block(unsigned int off, const void *src, size_t len)
+{
+	volatile unsigned char	*b = (volatile unsigned char *)pru_be->mem;
+	const unsigned char	*s = src;
+	uint32_t		v = 0;
+
+	for (; len && (off & 3); len--, off++)
+		b[off] = s ? *s++ : 0;
+	for (; len >= 4; len -= 4, off += 4) {
+		if (s) {
+			memcpy(&v, s, 4);
+			s += 4;
+		}
+		pru_be->mem[off / 4] = v;
+	}
+	for (; len; len--, off++)
+		b[off] = s ? *s++ : 0;
+}
+
+// write a control register of PRU p and let the backend act on it
+void pru_ctrl_write(unsigned int p, unsigned int reg, uint32_t value)
+{
+	pru_be->mem[pru_ctrl_base[p] + reg] = value;
+	if (pru_be->ops->ctrl_written)
+		pru_be->ops->ctrl_written(pru_be, p, reg);
+}
+
+int pru_halt_fd()
+{
+	return pru_be->ops->halt_fd ? pru_be->ops->halt_fd(pru_be) : -1;
+}
@@ -0,0 +1,77 @@
+/*
+ *
+ *  PRU Debug Program - memory and control backend header file
+ *
+ *  Everything the debugger does to a PRUSS goes through the backend that
+ *  was opened at start-up: word and block access to the PRUSS address
+ *  space, control register writes, and an optional descriptor that becomes
+ *  readable when a PRU stops.  All backends present the PRUSS as one
+ *  word-addressed mapping laid out as described by struct pru_layout, so
+ *  single word accesses are plain loads and stores; block transfers and
+ *  control writes go through the backend so it can batch them or act on
+ *  them.
+ *
+ *	uio	the PRUSS UIO device (/dev/uioN named "pruss*")
+ *	mem	/dev/mem at the PRUSS physical address
+ *	file	a file holding a PRUSS image, created if needed (arg: path)
+ *	anon	anonymous memory, nothing runs
+ *	sim	the instruction set simulator
+ *
+ */
+
+#ifndef BACKEND_H
+#define BACKEND_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include "prudbg.h"
+
+struct pru_backend;
+
+struct pru_backend_ops {
+	const char		*name;
+	int			(*open)(struct pru_backend *be, const struct pru_layout *l, const char *arg);
+	void			(*close)(struct pru_backend *be);
+	// optional: after a control register of PRU p was written
+	void			(*ctrl_written)(struct pru_backend *be, unsigned int p, unsigned int reg);
+	// optional: descriptor readable when a PRU stops, -1 if there is none
+	int			(*halt_fd)(struct pru_backend *be);
+};
+
+struct pru_backend {
+	const struct pru_backend_ops *ops;
+	volatile uint32_t	*mem;		// the PRUSS, 32-bit words
+	size_t			len;		// bytes
+	int			fd;		// kept open by the backend, -1 if none
+	void			*priv;
+};
+
+extern struct pru_backend	*pru_be;
+
+struct pru_backend *pru_backend_open(const char *name, const struct pru_layout *l, const char *arg);
+void pru_backend_close(struct pru_backend *be);
+const char *pru_backend_names();
+
+void pru_read_block(unsigned int off, void *dst, size_t len);
+void pru_write_block(unsigned int off, const void *src, size_t len);
+void pru_ctrl_write(unsigned int p, unsigned int reg, uint32_t value);
+int pru_halt_fd();
+
+// word at word offset off of the PRUSS
+static inline uint32_t pru_read(unsigned int off)
+{
+	return pru_be->mem[off];
+}
+
+static inline void pru_write(unsigned int off, uint32_t value)
+{
+	pru_be->mem[off] = value;
+}
+
+// control or status register of PRU p
+static inline uint32_t pru_ctrl_read(unsigned int p, unsigned int reg)
+{
+	return pru_be->mem[pru_ctrl_base[p] + reg];
+}
+
+#endif // BACKEND_H
@@ -0,0 +1,391 @@
+/*
+ *
+ *  PRU Debug Program - control-flow graph and call-graph extraction
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "da.h"
+#include "cfg.h"
+
+// growable array of fixed-size records
+static void *grow(void *p, uint32_t n, uint32_t *cap, size_t size)
+{
+	void			*q;
+
+	if (n < *cap)
+		return p;
+	*cap = *cap ? *cap * 2 : 64;
+	q = realloc(p, *cap * size);
+	if (!q)
+		free(p);
+	return q;
+}
+
+static int add_edge(struct cfg *g, uint32_t *cap, uint32_t from, uint32_t target, uint32_t kind)
+{
+	struct cfg_edge		*e;
+
+	g->edges = grow(g->edges, g->nedges, cap, sizeof(*g->edges));
+	if (!g->edges)
+		return -1;
+	e = &g->edges[g->nedges++];
+	e->from = from;
+	e->to = cfg_block_at(g, target);
+	e->target = target;
+	e->kind = kind;
+	g->blocks[from].nedges++;
+	return 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t		x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// mark block starts and collect LOOPs and function entries
+static int find_leaders(struct cfg *g, unsigned char *leader, uint32_t **entries, uint32_t *nentries)
+{
+	struct pru_insn		in;
+	uint32_t		i, pc, t, cap_loops = 0, cap_entries = 0;
+	int			target;
+
+	*entries = grow(NULL, 0, &cap_entries, sizeof(uint32_t));
+	if (!*entries)
+		return -1;
+	(*entries)[0] = g->base;
+	*nentries = 1;
+	if (g->len)
+		leader[0] = 1;
+
+	for (i = 0; i < g->len; i++) {
+		pc = g->base + i;
+		pru_decode(g->image[i], &in);
+		if (in.op == PRU_LOOP || in.op == PRU_ILOOP) {
+			target = pru_insn_target(&in, pc);
+			if ((uint32_t)target <= pc + 1)
+				continue;	// empty or malformed body
+			g->loops = grow(g->loops, g->nloops, &cap_loops, sizeof(*g->loops));
+			if (!g->loops)
+				return -1;
+			g->loops[g->nloops].addr = pc;
+			g->loops[g->nloops].start = pc + 1;
+			g->loops[g->nloops].end = target;
+			g->loops[g->nloops].count = in.io ? in.imm + 1 : 0;	// encoded minus one
+			g->loops[g->nloops].reg = in.rs2;
+			g->loops[g->nloops].reg_sel = in.rs2_sel;
+			g->nloops++;
+			if (i + 1 < g->len)
+				leader[i + 1] = 1;
+			if ((t = target - g->base) < g->len)
+				leader[t] = 1;
+			continue;
+		}
+		if (!(in.flags & (PRU_INSN_BRANCH | PRU_INSN_HALT)))
+			continue;
+		if (i + 1 < g->len)
+			leader[i + 1] = 1;
+		target = pru_insn_target(&in, pc);
+		if (target < 0)
+			continue;
+		if ((t = target - g->base) < g->len)
+			leader[t] = 1;
+		if (in.op == PRU_JAL) {
+			*entries = grow(*entries, *nentries, &cap_entries, sizeof(uint32_t));
+			if (!*entries)
+				return -1;
+			(*entries)[(*nentries)++] = target;
+		}
+	}
+	return 0;
+}
+
+// outgoing edges of block b, decided by its last instruction
+static int block_edges(struct cfg *g, uint32_t b, uint32_t *cap)
+{
+	struct cfg_block	*blk = &g->blocks[b];
+	struct pru_insn		in;
+	uint32_t		pc = blk->start + blk->len - 1;
+	int			target, r = 0;
+	uint32_t		i;
+
+	blk->edge = g->nedges;
+	pru_decode(g->image[pc - g->base], &in);
+	target = pru_insn_target(&in, pc);
+
+	if (in.op == PRU_HALT) {
+		blk->flags |= CFG_BLOCK_HALT;
+	} else if (in.op == PRU_JMP) {
+		if (target >= 0)
+			r = add_edge(g, cap, b, target, CFG_EDGE_TAKEN);
+		else if (in.rs2 == 3 && in.rs2_sel == PRU_SEL_W0 + 2)
+			blk->flags |= CFG_BLOCK_RETURN;		// JMP R3.w2
+		else
+			blk->flags |= CFG_BLOCK_INDIRECT;
+	} else if (in.op == PRU_JAL) {
+		blk->flags |= CFG_BLOCK_CALL;
+		if (target < 0)
+			blk->flags |= CFG_BLOCK_INDIRECT;
+		r = add_edge(g, cap, b, pc + 1, CFG_EDGE_RET);
+	} else if (in.op == PRU_QBA) {
+		r = add_edge(g, cap, b, target, CFG_EDGE_TAKEN);
+	} else if (in.flags & PRU_INSN_COND) {
+		r = add_edge(g, cap, b, target, CFG_EDGE_TAKEN);
+		if (!r)
+			r = add_edge(g, cap, b, pc + 1, CFG_EDGE_FALL);
+	} else {
+		r = add_edge(g, cap, b, pc + 1, CFG_EDGE_FALL);
+	}
+
+	for (i = 0; i < g->nloops && !r; i++) {
+		if (g->loops[i].end - 1 == pc) {
+			blk->flags |= CFG_BLOCK_LOOP;
+			r = add_edge(g, cap, b, g->loops[i].start, CFG_EDGE_LOOP);
+		}
+	}
+	return r;
+}
+
+// give every block reachable from a function entry, without following
+// calls, to the first function that reaches it
+static int assign_funcs(struct cfg *g)
+{
+	uint32_t		*stack, sp, f, b, e, to;
+
+	stack = malloc((g->nblocks + 1) * sizeof(uint32_t));
+	if (!stack)
+		return -1;
+	for (b = 0; b < g->nblocks; b++)
+		g->blocks[b].func = CFG_NONE;
+	for (f = 0; f < g->nfuncs; f++) {
+		b = g->funcs[f].block;
+		if (g->blocks[b].func != CFG_NONE)
+			continue;
+		g->blocks[b].func = f;
+		stack[0] = b;
+		sp = 1;
+		while (sp) {
+			b = stack[--sp];
+			for (e = g->blocks[b].edge; e < g->blocks[b].edge + g->blocks[b].nedges; e++) {
+				to = g->edges[e].to;
+				if (to == CFG_NONE || g->blocks[to].func != CFG_NONE)
+					continue;
+				g->blocks[to].func = f;
+				stack[sp++] = to;
+			}
+		}
+	}
+	free(stack);
+	return 0;
+}
+
+int cfg_build(struct cfg *g, const uint32_t *image, uint32_t len, uint32_t base)
+{
+	unsigned char		*leader = NULL;
+	uint32_t		*entries = NULL, nentries = 0;
+	uint32_t		i, b, cap, t, n;
+	struct pru_insn		in;
+
+	memset(g, 0, sizeof(*g));
+	g->image = image;
+	g->len = len;
+	g->base = base;
+	leader = calloc(len + 1, 1);
+	g->block_of = malloc((len + 1) * sizeof(uint32_t));
+	if (!leader || !g->block_of)
+		goto fail;
+	if (find_leaders(g, leader, &entries, &nentries))
+		goto fail;
+
+	// blocks
+	for (i = 0; i < len; i++)
+		g->nblocks += leader[i];
+	g->blocks = calloc(g->nblocks + 1, sizeof(*g->blocks));
+	if (!g->blocks)
+		goto fail;
+	for (i = 0, b = CFG_NONE; i < len; i++) {
+		if (leader[i]) {
+			b++;
+			g->blocks[b].start = base + i;
+		}
+		g->blocks[b].len++;
+		g->block_of[i] = b;
+	}
+
+	// edges
+	cap = 0;
+	for (b = 0; b < g->nblocks; b++)
+		if (block_edges(g, b, &cap))
+			goto fail;
+
+	// functions, one per distinct entry inside the image
+	qsort(entries, nentries, sizeof(uint32_t), cmp_u32);
+	g->funcs = calloc(nentries + 1, sizeof(*g->funcs));
+	if (!g->funcs)
+		goto fail;
+	for (i = 0; i < nentries; i++) {
+		if (i && entries[i] == entries[i - 1])
+			continue;
+		if ((b = cfg_block_at(g, entries[i])) == CFG_NONE)
+			continue;
+		g->funcs[g->nfuncs].entry = entries[i];
+		g->funcs[g->nfuncs].block = b;
+		g->blocks[b].flags |= CFG_BLOCK_ENTRY;
+		g->nfuncs++;
+	}
+	if (assign_funcs(g))
+		goto fail;
+
+	// call sites
+	for (b = 0, cap = 0; b < g->nblocks; b++) {
+		if (!(g->blocks[b].flags & CFG_BLOCK_CALL))
+			continue;
+		t = g->blocks[b].start + g->blocks[b].len - 1;
+		pru_decode(image[t - base], &in);
+		g->calls = grow(g->calls, g->ncalls, &cap, sizeof(*g->calls));
+		if (!g->calls)
+			goto fail;
+		g->calls[g->ncalls].site = t;
+		g->calls[g->ncalls].caller = g->blocks[b].func;
+		g->calls[g->ncalls].target = CFG_NONE;
+		g->calls[g->ncalls].callee = CFG_NONE;
+		if (in.io) {
+			g->calls[g->ncalls].target = in.imm;
+			n = cfg_block_at(g, in.imm);
+			if (n != CFG_NONE)
+				g->calls[g->ncalls].callee = g->blocks[n].func;
+		}
+		g->ncalls++;
+	}
+
+	free(leader);
+	free(entries);
+	return 0;
+
+fail:
+	fprintf(stderr, "cfg: couldn't allocate memory\n");
+	free(leader);
+	free(entries);
+	cfg_free(g);
+	return -1;
+}
+
+void cfg_free(struct cfg *g)
+{
+	free(g->block_of);
+	free(g->blocks);
+	free(g->edges);
+	free(g->funcs);
+	free(g->calls);
+	free(g->loops);
+	memset(g, 0, sizeof(*g));
+}
+
+static const char *edge_style[] = {
+	[CFG_EDGE_FALL]		= "",
+	[CFG_EDGE_TAKEN]	= " [color=blue]",
+	[CFG_EDGE_RET]		= " [style=dotted]",
+	[CFG_EDGE_LOOP]		= " [color=red label=\"loop\"]",
+};
+
+static const char *edge_name[] = {
+	[CFG_EDGE_FALL]		= "fall",
+	[CFG_EDGE_TAKEN]	= "taken",
+	[CFG_EDGE_RET]		= "return",
+	[CFG_EDGE_LOOP]		= "loop",
+};
+
+// one node per block labelled with its listing, calls as dashed edges
+void cfg_write_dot(FILE *f, const struct cfg *g)
+{
+	const struct cfg_block	*blk;
+	const struct cfg_edge	*e;
+	struct pru_insn		in;
+	char			str[64], *p;
+	uint32_t		b, i;
+
+	fprintf(f, "digraph cfg {\n");
+	fprintf(f, "\tnode [shape=box fontname=monospace];\n");
+	for (b = 0; b < g->nblocks; b++) {
+		blk = &g->blocks[b];
+		fprintf(f, "\tb%u [label=\"", b);
+		if (blk->flags & CFG_BLOCK_ENTRY)
+			fprintf(f, "func_%04x:\\l", blk->start);
+		for (i = blk->start; i < blk->start + blk->len; i++) {
+			pru_decode(g->image[i - g->base], &in);
+			pru_format(str, sizeof(str), &in);
+			if ((p = strchr(str, '\n')))
+				*p = 0;
+			fprintf(f, "%04x: %s\\l", i, str);
+		}
+		fprintf(f, "\"];\n");
+	}
+	for (i = 0; i < g->nedges; i++) {
+		e = &g->edges[i];
+		if (e->to == CFG_NONE)
+			continue;
+		fprintf(f, "\tb%u -> b%u%s;\n", e->from, e->to, edge_style[e->kind]);
+	}
+	for (i = 0; i < g->ncalls; i++) {
+		if (g->calls[i].callee == CFG_NONE)
+			continue;
+		fprintf(f, "\tb%u -> b%u [style=dashed];\n", g->block_of[g->calls[i].site - g->base],
+			g->funcs[g->calls[i].callee].block);
+	}
+	fprintf(f, "}\n");
+}
+
+static void json_index(FILE *f, uint32_t v)
+{
+	if (v == CFG_NONE)
+		fprintf(f, "null");
+	else
+		fprintf(f, "%u", v);
+}
+
+void cfg_write_json(FILE *f, const struct cfg *g)
+{
+	const struct cfg_block	*blk;
+	const struct cfg_edge	*e;
+	uint32_t		i, j;
+
+	fprintf(f, "{\n  \"base\": %u,\n  \"length\": %u,\n  \"blocks\": [", g->base, g->len);
+	for (i = 0; i < g->nblocks; i++) {
+		blk = &g->blocks[i];
+		fprintf(f, "%s\n    {\"start\": %u, \"len\": %u, \"func\": ", i ? "," : "", blk->start, blk->len);
+		json_index(f, blk->func);
+		fprintf(f, ", \"flags\": %u, \"succ\": [", blk->flags);
+		for (j = 0; j < blk->nedges; j++) {
+			e = &g->edges[blk->edge + j];
+			fprintf(f, "%s{\"block\": ", j ? ", " : "");
+			json_index(f, e->to);
+			fprintf(f, ", \"addr\": %u, \"kind\": \"%s\"}", e->target, edge_name[e->kind]);
+		}
+		fprintf(f, "]}");
+	}
+	fprintf(f, "\n  ],\n  \"functions\": [");
+	for (i = 0; i < g->nfuncs; i++)
+		fprintf(f, "%s\n    {\"entry\": %u, \"block\": %u}", i ? "," : "",
+			g->funcs[i].entry, g->funcs[i].block);
+	fprintf(f, "\n  ],\n  \"calls\": [");
+	for (i = 0; i < g->ncalls; i++) {
+		fprintf(f, "%s\n    {\"site\": %u, \"target\": ", i ? "," : "", g->calls[i].site);
+		json_index(f, g->calls[i].target);
+		fprintf(f, ", \"caller\": ");
+		json_index(f, g->calls[i].caller);
+		fprintf(f, ", \"callee\": ");
+		json_index(f, g->calls[i].callee);
+		fprintf(f, "}");
+	}
+	fprintf(f, "\n  ],\n  \"loops\": [");
+	for (i = 0; i < g->nloops; i++) {
+		fprintf(f, "%s\n    {\"addr\": %u, \"start\": %u, \"end\": %u, \"count\": %u}", i ? "," : "",
+			g->loops[i].addr, g->loops[i].start, g->loops[i].end, g->loops[i].count);
+	}
+	fprintf(f, "\n  ]\n}\n");
+}
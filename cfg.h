@@ -0,0 +1,115 @@
+/*
+ *
+ *  PRU Debug Program - control-flow graph header file
+ *
+ *  cfg_build() splits an instruction image into basic blocks, links them
+ *  with the edges implied by QBxx/QBA, JMP, JAL, LOOP and HALT, and groups
+ *  them into functions reached from the image start and from JAL targets.
+ *  The block index (cfg_block_at()) is shared by the exporters and by
+ *  anything that wants to work on blocks instead of single addresses.
+ *
+ */
+
+#ifndef CFG_H
+#define CFG_H
+#include <stdio.h>
+#include <stdint.h>
+
+#define CFG_NONE		0xFFFFFFFF
+
+// cfg_edge.kind
+#define CFG_EDGE_FALL		0	// next instruction
+#define CFG_EDGE_TAKEN		1	// branch or jump taken
+#define CFG_EDGE_RET		2	// JAL: where the callee returns to
+#define CFG_EDGE_LOOP		3	// end of a LOOP body back to its start
+
+// cfg_block.flags
+#define CFG_BLOCK_ENTRY		0x01	// first block of a function
+#define CFG_BLOCK_CALL		0x02	// ends in JAL
+#define CFG_BLOCK_RETURN	0x04	// ends in a register-indirect JMP
+#define CFG_BLOCK_HALT		0x08	// ends in HALT
+#define CFG_BLOCK_INDIRECT	0x10	// ends in a jump or call with unknown target
+#define CFG_BLOCK_LOOP		0x20	// last block of a LOOP body
+
+struct cfg_block {
+	uint32_t		start;		// address of the first instruction
+	uint32_t		len;		// number of instructions
+	uint32_t		edge;		// first outgoing edge in cfg.edges
+	uint32_t		nedges;
+	uint32_t		func;		// owning function, CFG_NONE if unreachable
+	uint32_t		flags;		// CFG_BLOCK_*
+};
+
+struct cfg_edge {
+	uint32_t		from, to;	// block indices, to is CFG_NONE if outside the image
+	uint32_t		target;		// destination address
+	uint32_t		kind;		// CFG_EDGE_*
+};
+
+struct cfg_func {
+	uint32_t		entry;		// address
+	uint32_t		block;
+};
+
+struct cfg_call {
+	uint32_t		site;		// address of the JAL
+	uint32_t		target;		// called address, CFG_NONE if indirect
+	uint32_t		caller, callee;	// function indices, callee may be CFG_NONE
+};
+
+struct cfg_loop {
+	uint32_t		addr;		// the LOOP instruction
+	uint32_t		start, end;	// body is [start, end)
+	uint32_t		count;		// iterations, 0 if taken from a register
+	uint32_t		reg;		// count register when count is 0
+	uint32_t		reg_sel;
+};
+
+struct cfg {
+	uint32_t		base;		// address of image[0]
+	uint32_t		len;		// instructions in the image
+	const uint32_t		*image;
+	uint32_t		*block_of;	// block index of every instruction
+	struct cfg_block	*blocks;
+	struct cfg_edge		*edges;
+	struct cfg_func		*funcs;
+	struct cfg_call		*calls;
+	struct cfg_loop		*loops;
+	uint32_t		nblocks, nedges, nfuncs, ncalls, nloops;
+};
+
+int cfg_build(struct cfg *g, const uint32_t *image, uint32_t len, uint32_t base);
+void cfg_free(struct cfg *g);
+void cfg_write_dot(FILE *f, const struct cfg *g);
+void cfg_write_json(FILE *f, const struct cfg *g);
+
+// block containing addr, CFG_NONE if it is outside the image
+static inline uint32_t cfg_block_at(const struct cfg *g, uint32_t addr)
+{
+	return addr - g->base < g->len ? g->block_of[addr - g->base] : CFG_NONE;
+}
+
+// function containing addr, CFG_NONE if unknown
+static inline uint32_t cfg_func_at(const struct cfg *g, uint32_t addr)
+{
+	uint32_t		b = cfg_block_at(g, addr);
+
+	return b == CFG_NONE ? CFG_NONE : g->blocks[b].func;
+}
+
+// function whose entry is addr, CFG_NONE if there is none
+static inline uint32_t cfg_func_entry(const struct cfg *g, uint32_t addr)
+{
+	uint32_t		lo = 0, hi = g->nfuncs, m;
+
+	while (lo < hi) {
+		m = (lo + hi) / 2;
+		if (g->funcs[m].entry < addr)
+			lo = m + 1;
+		else
+			hi = m;
+	}
+	return lo < g->nfuncs && g->funcs[lo].entry == addr ? lo : CFG_NONE;
+}
+
+#endif // CFG_H
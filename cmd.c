@@ -16,17 +16,28 @@
 #include <termios.h>
 #include <sys/ioctl.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "prudbg.h"
+#include "da.h"
+#include "cfg.h"
+#include "wcet.h"
+#include "lint.h"
+#include "stack.h"
+#include "pruelf.h"
+#include "sym.h"
+#include "backend.h"
 
 static char* reg_names[NUM_REGS];
+static struct sym_index* syms[MAX_NUM_OF_PRUS];
 
 unsigned int get_status(){
-	return pru[pru_ctrl_base[pru_num] + PRU_STATUS_REG];
+	return pru_ctrl_read(pru_num, PRU_STATUS_REG);
 }
 
 static unsigned int get_program_counter()
@@ -36,18 +47,12 @@ static unsigned int get_program_counter()
 
 static uint32_t get_instruction(unsigned int addr)
 {
-	return pru[pru_inst_base[pru_num] + addr];
-}
-
-static inline unsigned int br_get_offset(unsigned int i)
-{
-	return pru_inst_base[pru_num] + bp[pru_num][i].address;
+	return iram_read(addr);
 }
 
 static inline void run_hw_disable(unsigned int i)
 {
-	unsigned int offset = br_get_offset(i);
-	pru[offset] = bp[pru_num][i].instruction;
+	iram_unpatch(bp[pru_num][i].address);
 }
 
 static void run_hw_disable_all()
@@ -61,9 +66,7 @@ static void run_hw_disable_all()
 
 static inline void run_hw_enable(unsigned int i)
 {
-	unsigned int offset = br_get_offset(i);
-	bp[pru_num][i].instruction = pru[offset];
-	pru[offset] = INST_HALT;
+	bp[pru_num][i].instruction = iram_patch(bp[pru_num][i].address, INST_HALT);
 }
 
 static void run_hw_enable_all()
@@ -75,6 +78,9 @@ static void run_hw_enable_all()
 	}
 }
 
+static void ctrl_set(unsigned int ctrl);
+static void ctrl_set_pcreset(unsigned int address);
+
 static volatile int loop_should_stop;
 
 static void loop_signal_handler(int signum) {
@@ -91,7 +97,14 @@ void cmd_print_breakpoints()
 	printf("##  Address\n");
 	for (i=0; i<MAX_BREAKPOINTS; i++) {
 		if (bp[pru_num][i].state == BP_ACTIVE) {
-			printf("%02u  0x%04x %s\n", i, bp[pru_num][i].address, bp[pru_num][i].hw ? "hw" : "sw");
+			char where[100] = "";
+			if (syms[pru_num])
+				sym_format(syms[pru_num], bp[pru_num][i].address, where, sizeof(where));
+			printf("%02u  0x%04x %s %s", i, bp[pru_num][i].address, bp[pru_num][i].hw ? "hw" : "sw", where);
+			if (bp[pru_num][i].cond)
+				printf("%sif %s (%lu hits)", where[0] ? " " : "",
+				       cond_text(bp[pru_num][i].cond), bp[pru_num][i].hits);
+			printf("\n");
 		} else {
 			printf("%02u  UNUSED\n", i);
 		}
@@ -99,8 +112,8 @@ void cmd_print_breakpoints()
 	printf("\n");
 }
 
-// set breakpoint
-void cmd_set_breakpoint (unsigned int bpnum, unsigned int addr, unsigned int hw)
+// set breakpoint, which takes over cond
+void cmd_set_breakpoint (unsigned int bpnum, unsigned int addr, unsigned int hw, struct cond *cond)
 {
 	int found = -1;
 	for (unsigned int i=0; i<MAX_BREAKPOINTS; i++) {
@@ -111,10 +124,14 @@ void cmd_set_breakpoint (unsigned int bpnum, unsigned int addr, unsigned int hw)
 	}
 	if (found >= 0) {
 		fprintf(stderr, "Error: trying to insert breakpoint %d at addr %#x, but %d is already set at that address\n", bpnum, addr, found);
+		cond_free(cond);
 	} else {
+		cond_free(bp[pru_num][bpnum].cond);
 		bp[pru_num][bpnum].state = BP_ACTIVE;
 		bp[pru_num][bpnum].address = addr;
 		bp[pru_num][bpnum].hw = hw;
+		bp[pru_num][bpnum].cond = cond;
+		bp[pru_num][bpnum].hits = 0;
 	}
 }
 
@@ -122,6 +139,8 @@ void cmd_set_breakpoint (unsigned int bpnum, unsigned int addr, unsigned int hw)
 void cmd_clear_breakpoint (unsigned int bpnum)
 {
 	bp[pru_num][bpnum].state = BP_UNUSED;
+	cond_free(bp[pru_num][bpnum].cond);
+	bp[pru_num][bpnum].cond = NULL;
 }
 
 // dump data memory
@@ -148,7 +167,16 @@ void cmd_dx_rows (const char * prefix, unsigned char * data, int offset, int add
 
 void cmd_d_rows (int offset, int addr, int len)
 {
-	cmd_dx_rows("", (unsigned char*)pru, offset, addr, len);
+	unsigned char		*buf;
+
+	buf = malloc(len);
+	if (!buf) {
+		printf("ERROR: out of memory\n");
+		return;
+	}
+	pru_read_block(offset+addr, buf, len);
+	cmd_dx_rows("", buf, -addr, addr, len);
+	free(buf);
 }
 
 void cmd_d (int offset, int addr, int len)
@@ -159,6 +187,71 @@ void cmd_d (int offset, int addr, int len)
 	printf("\n");
 }
 
+static double elapsed_ms(const struct timespec *t0)
+{
+	struct timespec		t1;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) * 1e3 + (t1.tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+// Time reading len bytes of the active PRU's data RAM, in passes over the
+// RAM if it is smaller: byte by byte, word by word and with pru_read_block.
+void cmd_bench(unsigned int len)
+{
+	static const char	*method[] = {"bytes", "32-bit words", "block read"};
+	volatile unsigned char	*b = (volatile unsigned char *)pru_be->mem;
+	unsigned int		base = pru_data_base[pru_num] * 4;
+	unsigned int		m, i, n, done;
+	unsigned char		*buf;
+	struct timespec		t0;
+	double			ms[3];
+	uint32_t		v;
+
+	// the byte and word passes read the mapping itself
+	if (!b) {
+		printf("ERROR: the %s backend has no memory mapping to benchmark\n", pru_be->ops->name);
+		return;
+	}
+	buf = malloc(pru_dram_len);
+	if (!buf) {
+		printf("ERROR: out of memory\n");
+		return;
+	}
+	for (m = 0; m < 3; m++) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (done = 0; done < len; done += n) {
+			n = len - done < pru_dram_len ? len - done : pru_dram_len;
+			if (m == 0) {
+				for (i = 0; i < n; i++)
+					buf[i] = b[base + i];
+			} else if (m == 1) {
+				for (i = 0; i + 4 <= n; i += 4) {
+					v = pru_read((base + i) / 4);
+					memcpy(&buf[i], &v, 4);
+				}
+				for (; i < n; i++)
+					buf[i] = b[base + i];
+			} else {
+				pru_read_block(base, buf, n);
+			}
+		}
+		ms[m] = elapsed_ms(&t0);
+	}
+	free(buf);
+
+	printf("Read %u bytes of PRU%u data RAM in passes of up to %u bytes:\n",
+	       len, pru_num, pru_dram_len);
+	for (m = 0; m < 3; m++) {
+		printf("  %-13s %10.3f ms %10.1f MB/s", method[m], ms[m],
+		       ms[m] > 0 ? len / (ms[m] * 1e3) : 0);
+		if (m && ms[m] > 0)
+			printf("  %6.1fx", ms[0] / ms[m]);
+		printf("\n");
+	}
+	printf("\n");
+}
+
 // disassemble instruction memory
 void cmd_dis (int offset, int addr, int len)
 {
@@ -167,53 +260,443 @@ void cmd_dis (int offset, int addr, int len)
 	unsigned int		program_counter;
 	char			*pc[] = {"  ", ">>"};
 	int			pc_on = 0;
+	struct pru_insn		insn;
+
+	struct sym_loc		loc, last = {0};
 
 	program_counter = get_program_counter();
 
 	for (i=0; i<len; i++) {
 		if (program_counter == (addr + i)) pc_on = 1; else pc_on = 0;
-		disassemble(inst_str, sizeof(inst_str), pru[offset+addr+i]);
-		printf ("[0x%04x] 0x%08x %s %s\n", addr+i, pru[offset+addr+i], pc[pc_on], inst_str);
+		pru_decode(iram_read(addr+i), &insn);
+		pru_format(inst_str, sizeof(inst_str), &insn);
+		if (!syms[pru_num]) {
+			printf ("[0x%04x] 0x%08x %s %s\n", addr+i, insn.inst, pc[pc_on], inst_str);
+			continue;
+		}
+		// with symbols: a label at each function start and the source
+		// line whenever it changes
+		sym_lookup(syms[pru_num], addr+i, &loc);
+		if (loc.func && loc.offset == 0)
+			printf("%s:\n", loc.func);
+		printf ("[0x%04x] 0x%08x %s %-32s", addr+i, insn.inst, pc[pc_on], inst_str);
+		if (loc.file && (loc.file != last.file || loc.line != last.line))
+			printf(" ; %s:%u", loc.file, loc.line);
+		printf("\n");
+		last = loc;
 	}
 	printf("\n");
 }
 
+// control-flow graph of the active PRU's instruction memory, as DOT or JSON
+void cmd_cfg(const char *format, const char *filename)
+{
+	uint32_t		*image;
+	unsigned int		len;
+	struct cfg		g;
+	FILE			*stream = stdout;
+
+	image = malloc(pru_iram_len * sizeof(uint32_t));
+	if (!image) {
+		fprintf(stderr, "cfg: couldn't allocate memory\n");
+		return;
+	}
+	len = iram_read_block(0, image, pru_iram_len);
+	if (cfg_build(&g, image, len, 0))
+		goto cleanup;
+	if (filename) {
+		stream = fopen(filename, "w");
+		if (!stream) {
+			fprintf(stderr, "Error %d %s while creating %s\n", errno, strerror(errno), filename);
+			goto cleanup_cfg;
+		}
+	}
+	if (format && !strcasecmp(format, "json"))
+		cfg_write_json(stream, &g);
+	else
+		cfg_write_dot(stream, &g);
+	if (filename) {
+		if (fclose(stream))
+			fprintf(stderr, "Error %d %s while closing file %s\n", errno, strerror(errno), filename);
+		else
+			printf("%u blocks, %u functions written to %s\n", g.nblocks, g.nfuncs, filename);
+	}
+	printf("\n");
+cleanup_cfg:
+	cfg_free(&g);
+cleanup:
+	free(image);
+}
+
+// worst-case cycle counts of the active PRU's instruction memory, with the
+// worst path from-to unless from is negative
+void cmd_wcet(long from, long to, const char *filename)
+{
+	struct wcet_opts	o = {0};
+	uint32_t		*image;
+	unsigned int		len;
+	struct cfg		g;
+
+	if (filename && wcet_load(&o, filename))
+		goto cleanup_opts;
+	image = malloc(pru_iram_len * sizeof(uint32_t));
+	if (!image) {
+		fprintf(stderr, "wcet: couldn't allocate memory\n");
+		goto cleanup_opts;
+	}
+	len = iram_read_block(0, image, pru_iram_len);
+	if (cfg_build(&g, image, len, 0) == 0) {
+		wcet_report(stdout, &g, &o, from < 0 ? CFG_NONE : from, to);
+		printf("\n");
+		cfg_free(&g);
+	}
+	free(image);
+cleanup_opts:
+	wcet_free(&o);
+}
+
+// performance lint of the active PRU's instruction memory
+void cmd_lint()
+{
+	uint32_t		*image;
+	unsigned int		len;
+	struct cfg		g;
+
+	image = malloc(pru_iram_len * sizeof(uint32_t));
+	if (!image) {
+		fprintf(stderr, "lint: couldn't allocate memory\n");
+		return;
+	}
+	len = iram_read_block(0, image, pru_iram_len);
+	if (cfg_build(&g, image, len, 0) == 0) {
+		lint_report(stdout, &g);
+		printf("\n");
+		cfg_free(&g);
+	}
+	free(image);
+}
+
+// stack depth of the active PRU's instruction memory, and the data
+// footprint of elf_file against the data RAM sizes when it is given
+void cmd_stack(const char *elf_file)
+{
+	uint32_t		*image, depth;
+	unsigned int		len;
+	struct cfg		g;
+
+	image = malloc(pru_iram_len * sizeof(uint32_t));
+	if (!image) {
+		fprintf(stderr, "stack: couldn't allocate memory\n");
+		return;
+	}
+	len = iram_read_block(0, image, pru_iram_len);
+	if (cfg_build(&g, image, len, 0) == 0) {
+		if (stack_report(stdout, &g, &depth) == 0 && elf_file)
+			stack_footprint(stdout, elf_file, pru_dram_len, pru_shared_len, depth);
+		printf("\n");
+		cfg_free(&g);
+	}
+	free(image);
+}
+
 // halt the current PRU
 void cmd_halt()
 {
 	unsigned int		ctrl_reg;
 
-	ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+	ctrl_reg = pru_ctrl_read(pru_num, PRU_CTRL_REG);
 	ctrl_reg &= ~PRU_REG_PROC_EN;
-	pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG] = ctrl_reg;
+	ctrl_set(ctrl_reg);
 	printf("PRU%u Halted.\n", pru_num);
 }
 
+static int in_region(unsigned int addr, unsigned int len, unsigned int base, unsigned int size)
+{
+	// no addr + len, which can wrap
+	return addr >= base && len <= size && addr - base <= size - len;
+}
+
+// byte offset in the PRU mapping of the PRU-local data address addr, or -1
+// if [addr, addr+len) doesn't fit in one of the data RAMs
+static long data_local_offset(unsigned int addr, unsigned int len)
+{
+	if (in_region(addr, len, PRU_LOCAL_DRAM, pru_dram_len))
+		return pru_data_base[pru_num] * 4 + addr - PRU_LOCAL_DRAM;
+	if (in_region(addr, len, PRU_LOCAL_DRAM_OTHER, pru_dram_len))
+		return pru_data_base[pru_num ^ 1] * 4 + addr - PRU_LOCAL_DRAM_OTHER;
+	if (in_region(addr, len, PRU_LOCAL_SHARED, pru_shared_len))
+		return pru_shared_base * 4 + addr - PRU_LOCAL_SHARED;
+	return -1;
+}
+
+static const char *data_ram_name(unsigned int addr)
+{
+	if (addr >= PRU_LOCAL_SHARED)
+		return "shared RAM";
+	return addr >= PRU_LOCAL_DRAM_OTHER ? "other PRU's data RAM" : "data RAM";
+}
+
+// write the contents of file fn to the PRU-local data address addr
+void cmd_wrf(unsigned int addr, const char *fn)
+{
+	struct timespec		t0;
+	unsigned char		*buf;
+	struct stat		st;
+	long			off;
+	FILE			*f;
+
+	f = fopen(fn, "rb");
+	if (!f || fstat(fileno(f), &st)) {
+		printf("ERROR: could not open %s\n", fn);
+		if (f)
+			fclose(f);
+		return;
+	}
+	// st_size is wider than the length data_local_offset takes
+	off = st.st_size > pru_dram_len && st.st_size > pru_shared_len ? -1 :
+	      data_local_offset(addr, st.st_size);
+	if (off < 0 || st.st_size == 0) {
+		printf("ERROR: %s (%ld bytes) does not fit in a data RAM at 0x%05x\n",
+		       fn, (long)st.st_size, addr);
+		fclose(f);
+		return;
+	}
+	buf = malloc(st.st_size);
+	if (!buf || fread(buf, 1, st.st_size, f) != (size_t)st.st_size) {
+		printf("ERROR: could not read %s\n", fn);
+		free(buf);
+		fclose(f);
+		return;
+	}
+	fclose(f);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	pru_write_block(off, buf, st.st_size);
+	printf("Wrote %ld bytes to %s 0x%05x-0x%05x in %.3f ms\n\n", (long)st.st_size,
+	       data_ram_name(addr), addr, addr + (unsigned int)st.st_size - 1, elapsed_ms(&t0));
+	free(buf);
+}
+
+// fill len bytes at the PRU-local data address addr with value, repeated
+// every size (1, 2 or 4) bytes in PRU (little-endian) byte order
+void cmd_fill(unsigned int addr, unsigned int len, uint32_t value, unsigned int size)
+{
+	unsigned char		chunk[4096];
+	struct timespec		t0;
+	unsigned int		i, n;
+	long			off;
+
+	if (size != 1 && size != 2 && size != 4) {
+		printf("ERROR: size must be 1, 2 or 4\n");
+		return;
+	}
+	if (size < 4 && value >> (8 * size)) {
+		printf("ERROR: 0x%x does not fit in %u byte%s\n", value, size, size > 1 ? "s" : "");
+		return;
+	}
+	off = data_local_offset(addr, len);
+	if (off < 0 || len == 0) {
+		printf("ERROR: 0x%05x+%u is not in a data RAM\n", addr, len);
+		return;
+	}
+	// the chunk size is a multiple of size, so every chunk starts in phase
+	for (i = 0; i < sizeof(chunk); i++)
+		chunk[i] = value >> (8 * (i % size));
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < len; i += n) {
+		n = len - i < sizeof(chunk) ? len - i : sizeof(chunk);
+		pru_write_block(off + i, chunk, n);
+	}
+	printf("Filled %s 0x%05x-0x%05x in %.3f ms\n\n", data_ram_name(addr),
+	       addr, addr + len - 1, elapsed_ms(&t0));
+}
+
+// copy len bytes between PRU-local data addresses, overlapping is fine
+void cmd_copy(unsigned int src, unsigned int dst, unsigned int len)
+{
+	struct timespec		t0;
+	unsigned char		*buf;
+	long			from, to;
+
+	from = data_local_offset(src, len);
+	to = data_local_offset(dst, len);
+	if (from < 0 || to < 0 || len == 0) {
+		printf("ERROR: 0x%05x+%u is not in a data RAM\n", from < 0 ? src : dst, len);
+		return;
+	}
+	buf = malloc(len);
+	if (!buf) {
+		printf("ERROR: out of memory\n");
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	pru_read_block(from, buf, len);
+	pru_write_block(to, buf, len);
+	printf("Copied %u bytes from 0x%05x to %s 0x%05x in %.3f ms\n\n", len, src,
+	       data_ram_name(dst), dst, elapsed_ms(&t0));
+	free(buf);
+}
+
+// load the PT_LOAD segments of a clpru/pru-gcc executable and set the
+// reset PC to its entry point
+int cmd_loadelf(char *fn)
+{
+	struct pru_elf		e;
+	const Elf32_Phdr	*ph;
+	uint32_t		*buf, addr;
+	unsigned int		i, code = 0, data = 0;
+	long			off;
+	int			r = 0;
+
+	if (pru_elf_open(&e, fn))
+		return 1;
+	for (i = 0; i < e.eh->e_phnum; i++) {
+		ph = &e.ph[i];
+		if (ph->p_type != PT_LOAD || ph->p_memsz == 0)
+			continue;
+		if (ph->p_offset + (size_t)ph->p_filesz > e.size || ph->p_filesz > ph->p_memsz) {
+			printf("ERROR: segment %u is outside the file\n", i);
+			r = 1;
+			break;
+		}
+		addr = pru_elf_addr(ph);
+		if (pru_elf_is_code(ph)) {
+			if ((addr & 3) || (ph->p_filesz & 3) || addr / 4 + ph->p_filesz / 4 > pru_iram_len) {
+				printf("ERROR: code segment %u at 0x%x (%u bytes) doesn't fit instruction RAM\n",
+				       i, addr, ph->p_filesz);
+				r = 1;
+				break;
+			}
+			// the file offset need not be word aligned
+			buf = malloc(ph->p_filesz + 4);
+			if (!buf) {
+				printf("ERROR: could not allocate memory\n");
+				r = 1;
+				break;
+			}
+			memcpy(buf, e.data + ph->p_offset, ph->p_filesz);
+			iram_write(addr / 4, buf, ph->p_filesz / 4);
+			free(buf);
+			code += ph->p_filesz;
+			printf("  IRAM   0x%04x %6u bytes\n", addr / 4, ph->p_filesz);
+		} else {
+			off = data_local_offset(addr, ph->p_memsz);
+			if (off < 0) {
+				printf("ERROR: data segment %u at 0x%x (%u bytes) is not in a data RAM\n",
+				       i, addr, ph->p_memsz);
+				r = 1;
+				break;
+			}
+			pru_write_block(off, e.data + ph->p_offset, ph->p_filesz);
+			pru_write_block(off + ph->p_filesz, NULL, ph->p_memsz - ph->p_filesz);
+			data += ph->p_memsz;
+			printf("  %-6s 0x%05x %6u bytes\n", addr >= PRU_LOCAL_SHARED ? "SHARED" : "DRAM",
+			       addr, ph->p_memsz);
+		}
+	}
+	if (r == 0) {
+		ctrl_set_pcreset(pru_elf_entry(&e));
+		printf("ELF file loaded into PRU%u: %u bytes of code, %u bytes of data, entry 0x%04x.\n",
+		       pru_num, code, data, pru_elf_entry(&e));
+	}
+	pru_elf_close(&e);
+	if (r == 0)
+		cmd_load_symbols(fn);
+	return r;
+}
+
+// symbols and line table of the firmware on the active PRU
+void cmd_load_symbols(const char *fn)
+{
+	struct sym_index	*s = sym_load(fn);
+
+	if (!s)
+		return;
+	sym_free(syms[pru_num]);
+	syms[pru_num] = s;
+	printf("Symbols for PRU%u: %u functions, %u line entries in %u files.\n",
+	       pru_num, s->hdr->nfuncs, s->hdr->nlines, s->hdr->nfiles);
+}
+
+void cmd_print_symbol(unsigned int addr)
+{
+	char			where[100];
+
+	if (!syms[pru_num])
+		printf("No symbols loaded for PRU%u.\n\n", pru_num);
+	else if (sym_format(syms[pru_num], addr, where, sizeof(where)))
+		printf("0x%04x: %s\n\n", addr, where);
+	else
+		printf("0x%04x: no symbol\n\n", addr);
+}
+
+// instruction address from a number or "symbol[+offset]", -1 if unknown
+int parse_symbol(const char *str, unsigned int *addr)
+{
+	uint32_t		a;
+
+	if (!syms[pru_num] || sym_resolve(syms[pru_num], str, &a))
+		return -1;
+	*addr = a;
+	return 0;
+}
+
 // load program into instruction memory
 int cmd_loadprog(unsigned int addr, char *fn)
 {
-	int			f, r;
+	int			f;
+	ssize_t			r;
+	size_t			got;
 	struct stat		file_info;
+	uint32_t		*buf;
 
-	r = stat(fn, &file_info);
-	if (r == -1) {
+	if (stat(fn, &file_info) == -1) {
 		printf("ERROR: could not open file\n");
 		return 1;
 	}
+	if (pru_elf_is_elf(fn))
+		return cmd_loadelf(fn);
+	if (file_info.st_size == 0) {
+		printf("ERROR: %s is empty\n", fn);
+		return 1;
+	}
 	if (((file_info.st_size/4)*4) != file_info.st_size) {
 		printf("ERROR: file size is not evenly divisible by 4\n");
-	} else {
-		f = open(fn, O_RDONLY);
-		if (f == -1) {
-			printf("ERROR: could not open file 2\n");
-		} else {
-			if (read(f, (unsigned int*)&pru[pru_inst_base[pru_num] + addr], file_info.st_size) < 0) {
-				perror("loadprog");
-			}
+		return 1;
+	}
+	if (addr >= pru_iram_len || file_info.st_size / 4 > pru_iram_len - addr) {
+		printf("ERROR: %s (%ld bytes) does not fit in instruction RAM at 0x%04x\n",
+		       fn, (long)file_info.st_size, addr);
+		return 1;
+	}
+	f = open(fn, O_RDONLY);
+	if (f == -1) {
+		printf("ERROR: could not open %s: %s\n", fn, strerror(errno));
+		return 1;
+	}
+	buf = malloc(file_info.st_size);
+	if (!buf) {
+		printf("ERROR: out of memory\n");
+		close(f);
+		return 1;
+	}
+	for (got = 0; got < (size_t)file_info.st_size; got += r) {
+		r = read(f, (char *)buf + got, file_info.st_size - got);
+		if (r < 0 && errno == EINTR) {
+			r = 0;
+			continue;
+		}
+		if (r <= 0) {
+			printf("ERROR: could not read %s: %s\n", fn, r ? strerror(errno) : "file shrank");
+			free(buf);
 			close(f);
-			printf("Binary file of size %ld bytes loaded into PRU%u instruction RAM.\n", file_info.st_size, pru_num);
+			return 1;
 		}
 	}
+	close(f);
+	// store with word writes, keeping the IRAM shadow in step
+	iram_write(addr, buf, file_info.st_size / 4);
+	free(buf);
+	printf("Binary file of size %ld bytes loaded into PRU%u instruction RAM.\n", file_info.st_size, pru_num);
 	return 0;
 }
 
@@ -252,9 +735,10 @@ void cmd_printrcs(enum RegOrConst type)
 	unsigned int		ctrl_reg, reset_pc;
 	char			*run_state, *single_step, *cycle_cnt_en, *pru_sleep, *proc_en;
 	unsigned int		i;
-	char			inst_str[50];
+	char			inst_str[50], where[100];
+	struct pru_insn		insn;
 
-	ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+	ctrl_reg = pru_ctrl_read(pru_num, PRU_CTRL_REG);
 	reset_pc = (ctrl_reg >> 16);
 	if (ctrl_reg&PRU_REG_RUNSTATE)
 		run_state = "RUNNING";
@@ -290,11 +774,15 @@ void cmd_printrcs(enum RegOrConst type)
 	} else if(ctrl_reg&PRU_REG_RUNSTATE) {
 		snprintf(inst_str, sizeof(inst_str), "not available since PRU is RUNNING");
 	} else {
-		disassemble(inst_str, sizeof(inst_str), get_instruction(get_program_counter()));
+		pru_decode(get_instruction(get_program_counter()), &insn);
+		pru_format(inst_str, sizeof(inst_str), &insn);
 	}
-	printf("    Program counter: 0x%04x\n", get_program_counter());
+	if (syms[pru_num] && sym_format(syms[pru_num], get_program_counter(), where, sizeof(where)))
+		printf("    Program counter: 0x%04x  <%s>\n", get_program_counter(), where);
+	else
+		printf("    Program counter: 0x%04x\n", get_program_counter());
 	printf("      Current instruction: %s\n", inst_str);
-	printf("      Cycle counter: %u, stall counter: %u\n\n", pru[pru_ctrl_base[pru_num] + PRU_CYCLE_REG], pru[pru_ctrl_base[pru_num] + PRU_STALL_REG]);
+	printf("      Cycle counter: %u, stall counter: %u\n\n", pru_ctrl_read(pru_num, PRU_CYCLE_REG), pru_ctrl_read(pru_num, PRU_STALL_REG));
 
 	if (ctrl_reg&PRU_REG_RUNSTATE) {
 		printf("    %s not available since PRU is RUNNING.\n", kReg == type ? "Rxx registers" : "Cxx constants");
@@ -319,7 +807,7 @@ void cmd_printrcs(enum RegOrConst type)
 				if(names_len[c])
 					printf(" %*s", names_len[c], name ? name : "");
 
-				printf(": 0x%08x   ", pru[pru_ctrl_base[pru_num] + offset + reg]);
+				printf(": 0x%08x   ", pru_ctrl_read(pru_num, offset + reg));
 			}
 			printf("\n");
 		}
@@ -333,7 +821,7 @@ void cmd_printrc(unsigned int i, enum RegOrConst type)
 {
 	unsigned int ctrl_reg;
 
-	ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+	ctrl_reg = pru_ctrl_read(pru_num, PRU_CTRL_REG);
 
 	if (ctrl_reg&PRU_REG_RUNSTATE) {
 		printf("Rxx registers not available since PRU is RUNNING.\n");
@@ -341,7 +829,7 @@ void cmd_printrc(unsigned int i, enum RegOrConst type)
 		unsigned int offset = kReg == type ? PRU_INTGPR_REG : PRU_INTCT_REG;
 		printf("%c%02u: 0x%08x\n\n",
 		       kReg == type ? 'R' : 'C',
-		       i, pru[pru_ctrl_base[pru_num] + offset + i]);
+		       i, pru_ctrl_read(pru_num, offset + i));
 	}
 }
 
@@ -350,51 +838,51 @@ void cmd_setreg(int i, unsigned int value)
 {
 	unsigned int		ctrl_reg;
 
-	ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+	ctrl_reg = pru_ctrl_read(pru_num, PRU_CTRL_REG);
 
 	if (ctrl_reg&PRU_REG_RUNSTATE) {
 		printf("Rxx registers not available since PRU is RUNNING.\n");
 	} else {
-		pru[pru_ctrl_base[pru_num] + PRU_INTGPR_REG + i] = value;
+		pru_write(pru_ctrl_base[pru_num] + PRU_INTGPR_REG + i, value);
 	}
 }
 
 // print current single specific PRU registers
 void cmd_print_ctrlreg(const char * name, unsigned int i)
 {
-	printf("%s: 0x%08x\n\n", name, pru[pru_ctrl_base[pru_num] + i]);
+	printf("%s: 0x%08x\n\n", name, pru_ctrl_read(pru_num, i));
 }
 
 // print current single specific PRU registers
 void cmd_print_ctrlreg_uint(const char * name, unsigned int i)
 {
-	printf("%s: %u\n\n", name, pru[pru_ctrl_base[pru_num] + i]);
+	printf("%s: %u\n\n", name, pru_ctrl_read(pru_num, i));
 }
 
 // print current single specific PRU registers
 void cmd_set_ctrlreg(unsigned int i, unsigned int value)
 {
-	pru[pru_ctrl_base[pru_num] + i] = value;
+	pru_ctrl_write(pru_num, i, value);
 }
 
 // print current single specific PRU registers
 void cmd_set_ctrlreg_bits(unsigned int i, unsigned int bits)
 {
-	pru[pru_ctrl_base[pru_num] + i] |= bits;
+	pru_ctrl_write(pru_num, i, pru_ctrl_read(pru_num, i) | bits);
 }
 
 // print current single specific PRU registers
 void cmd_clr_ctrlreg_bits(unsigned int i, unsigned int bits)
 {
-	pru[pru_ctrl_base[pru_num] + i] &= ~bits;
+	pru_ctrl_write(pru_num, i, pru_ctrl_read(pru_num, i) & ~bits);
 }
 
 static void ctrl_set(unsigned int ctrl){
-	pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG] = ctrl;
+	pru_ctrl_write(pru_num, PRU_CTRL_REG, ctrl);
 }
 
 static unsigned int ctrl_get(){
-	return pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+	return pru_ctrl_read(pru_num, PRU_CTRL_REG);
 }
 
 static unsigned int ctrl_get_pcreset(){
@@ -427,10 +915,38 @@ void cmd_run()
 	unsigned int		ctrl_reg;
 
 	// disable single step mode and enable processor
-	ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+	ctrl_reg = pru_ctrl_read(pru_num, PRU_CTRL_REG);
 	ctrl_reg |= PRU_REG_PROC_EN;
 	ctrl_reg &= ~PRU_REG_SINGLE_STEP;
-	pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG] = ctrl_reg;
+	ctrl_set(ctrl_reg);
+}
+
+// wait up to ms for a PRU to stop: poll the backend's halt fd, or sleep if it has none
+static void halt_wait(int fd, int ms)
+{
+	struct pollfd		pfd = { .fd = fd, .events = POLLIN };
+	uint64_t		n;
+
+	if (fd < 0) {
+		usleep(ms * 1000);
+		return;
+	}
+	if (poll(&pfd, 1, ms) > 0 && read(fd, &n, sizeof(n)) != sizeof(n))
+		n = 0;
+}
+
+// whether watch w lies entirely inside a data RAM or the shared RAM, the
+// only memory store mode sees changes of
+static int watch_in_ram(const struct watchvariable *w)
+{
+	unsigned long		off = pru_data_base[pru_num] * 4ul + w->address;
+	unsigned int		i;
+
+	for (i = 0; i < pruss_layout.num_of_pruss; i++) {
+		if (off >= pru_data_base[i] * 4ul && off + w->len <= pru_data_base[i] * 4ul + pru_dram_len)
+			return 1;
+	}
+	return off >= pru_shared_base * 4ul && off + w->len <= pru_shared_base * 4ul + pru_shared_len;
 }
 
 // run PRU in a single stepping mode - used for breakpoints and watch variables
@@ -438,9 +954,9 @@ void cmd_run()
 void cmd_runss(long count)
 {
 	unsigned int		i, addr;
-	unsigned int		done = 0;
 	unsigned int		ctrl_reg;
-	unsigned long		t_cyc = 0;
+	int			run_hw_hit = -1;
+	int			halt_fd;
 
 	if (count > 0) {
 		printf("Running (will run for %ld steps or until a breakpoint is hit or a key is pressed)....\n", count);
@@ -449,12 +965,15 @@ void cmd_runss(long count)
 		printf("Running (will run until a breakpoint is hit or ctrl-C is pressed)....\n");
 	}
 	unsigned int hw_break = 0;
-	unsigned int sw_break = 0;
+	unsigned int sw_break = step_break_count();
 	unsigned int sw_watch = 0;
+	unsigned int cond_break = 0;
 	int is_on_breakpoint = -1;
 	addr = get_program_counter();
 	for (i=0; i<MAX_BREAKPOINTS; i++) {
 		if (bp[pru_num][i].state == BP_ACTIVE) {
+			if (bp[pru_num][i].cond)
+				cond_break++;
 			if(bp[pru_num][i].hw) {
 				hw_break++;
 				if(bp[pru_num][i].address == addr)
@@ -464,117 +983,68 @@ void cmd_runss(long count)
 			}
 		}
 	}
+	unsigned int reg_watch = 0;
 	for (i=0; i<MAX_WATCH; ++i) {
-		if (wa[pru_num][i].state != WA_UNUSED)
+		if (wa[pru_num][i].state != WA_UNUSED) {
 			sw_watch++;
+			if (!watch_in_ram(&wa[pru_num][i]))
+				reg_watch++;
+		}
 	}
 
-	int run_hw = !sw_watch && !sw_break && count < 0;
-	int run_hw_hit = -1;
+	// recording needs every step
+	int recording = rec_active();
+	int run_hw = !sw_watch && !sw_break && !cond_break && !recording && count < 0;
+	// with watches or conditions, run at full speed and stop only at
+	// stores and breakpoints; watches on registers or the cycle counter
+	// change without a store and need every step
+	int run_stores = (sw_watch || cond_break) && !sw_break && !reg_watch && !recording && count < 0;
 
+	loop_should_stop = 0;
 	signal(SIGINT, loop_signal_handler);
-	// enter single-step loop
-	do {
-		// decrease count
-		if (count > 0)
-			--count;
-
-		// prep some 'select' magic to detect keypress to escape
-
-		if (run_hw) {
-			printf("Running with hw breakpoints (real-time performance guaranteed%s)\n", is_on_breakpoint ? " after the first instruction" : "");
-			run_hw_enable_all();
-			if(is_on_breakpoint >= 0) {
-				run_hw_disable(is_on_breakpoint);
-				// single-step exactly once with this breakpoint disabled
-				ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
-				ctrl_reg |= PRU_REG_PROC_EN | PRU_REG_SINGLE_STEP;
-				ctrl_reg &= ~PRU_REG_SINGLE_STEP;
-				while(addr == get_program_counter())
-					;
-				// once we've stepped and gotten out of the breakpoint,
-				// re-enable it
-				run_hw_enable(is_on_breakpoint);
-			}
-			// run as usual, it will stop when it hits one of the
-			// HALT we added in run_hw_enable_all()
-			cmd_run();
-			// wait until we reach HALT or a keypress
-			while(!loop_should_stop)
-			{
-				usleep(50000);
-				if(get_instruction(get_program_counter()) == INST_HALT) {
-					done = 1;
-					break;
-				}
-			}
-		} else {
-			printf("Running with sw single-stepping (real-time performance not guaranteed)\n");
-			// set single step mode and enable processor
-			ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+	if (run_hw) {
+		printf("Running with hw breakpoints (real-time performance guaranteed%s)\n", is_on_breakpoint ? " after the first instruction" : "");
+		run_hw_enable_all();
+		if(is_on_breakpoint >= 0) {
+			run_hw_disable(is_on_breakpoint);
+			// single-step exactly once with this breakpoint disabled
+			ctrl_reg = pru_ctrl_read(pru_num, PRU_CTRL_REG);
 			ctrl_reg |= PRU_REG_PROC_EN | PRU_REG_SINGLE_STEP;
-			pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG] = ctrl_reg;
-		}
-
-		// check if we've hit a breakpoint
-		addr = get_program_counter();
-		for (i=0; i<MAX_BREAKPOINTS; i++) if ((bp[pru_num][i].state == BP_ACTIVE) && (bp[pru_num][i].address == addr)) {
-			done = 1;
-			if(run_hw)
-				run_hw_hit = i;
+			ctrl_set(ctrl_reg);
+			while(addr == get_program_counter())
+				;
+			// once we've stepped and gotten out of the breakpoint,
+			// re-enable it
+			run_hw_enable(is_on_breakpoint);
 		}
-
-		// check if we've hit a watch point
-		for (i=0; i<MAX_WATCH; ++i) {
-			unsigned char *pru_u8 = (unsigned char*)pru;
-
-			if ((wa[pru_num][i].state == WA_PRINT_ON_ANY) &&
-			    (memcmp(wa[pru_num][i].old_value,
-				    pru_u8 + pru_data_base[pru_num]*4
-					   + wa[pru_num][i].address,
-				    wa[pru_num][i].len) != 0)) {
-
-				printf("@0x%04x  [0x%05x] t=%lu: ",
-				       addr, wa[pru_num][i].address, t_cyc);
-				cmd_d_rows(pru_data_base[pru_num]*4,
-					   wa[pru_num][i].address,
-					   wa[pru_num][i].len);
-
-				memcpy(wa[pru_num][i].old_value,
-				       pru_u8 + pru_data_base[pru_num]*4
-					      + wa[pru_num][i].address,
-				       wa[pru_num][i].len);
-			} else if ((wa[pru_num][i].state == WA_HALT_ON_VALUE) &&
-				   (memcmp(wa[pru_num][i].value,
-					   pru_u8 + pru_data_base[pru_num]*4
-						  + wa[pru_num][i].address,
-					   wa[pru_num][i].len) == 0)) {
-
-				printf("@0x%04x  [0x%05x] t=%lu: ",
-				       addr, wa[pru_num][i].address, t_cyc);
-				cmd_d_rows(pru_data_base[pru_num]*4,
-					   wa[pru_num][i].address,
-					   wa[pru_num][i].len);
-
-				done = 1;
-			}
+		// run as usual, it will stop when it hits one of the
+		// HALT we added in run_hw_enable_all()
+		halt_fd = pru_halt_fd();
+		halt_wait(halt_fd, 0);		// drop stops from earlier runs
+		cmd_run();
+		// wait until we reach HALT or a keypress
+		while(!loop_should_stop)
+		{
+			halt_wait(halt_fd, 50);
+			if(iram_is_halt(get_program_counter()))
+				break;
 		}
 
-		// check if we are on a HALT instruction - if so, stop single step execution
-		if (get_instruction(addr) == INST_HALT) {
+		// check if we've hit a breakpoint or a HALT of the program
+		addr = get_program_counter();
+		for (i=0; i<MAX_BREAKPOINTS; i++) if ((bp[pru_num][i].state == BP_ACTIVE) && (bp[pru_num][i].address == addr))
+			run_hw_hit = i;
+		if (iram_is_halt(addr)) {
 			if(run_hw_hit != -1)
 				printf("\nBreakpoint %d hit at %#x.\n", run_hw_hit, addr);
 			else
 				printf("\nHALT instruction hit.\n");
-			done = 1;
 		}
-
-
-		// increase time
-		t_cyc++;
-	} while (!loop_should_stop && (!done) && (count != 0));
-	if(run_hw) {
 		run_hw_disable_all();
+	} else if (run_stores) {
+		step_run_stores(&loop_should_stop);
+	} else {
+		step_run(count, &loop_should_stop);
 	}
 
 	printf("\n");
@@ -583,10 +1053,10 @@ void cmd_runss(long count)
 	cmd_printrcs(kReg);
 
 	// disable single step mode and disable processor
-	ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+	ctrl_reg = pru_ctrl_read(pru_num, PRU_CTRL_REG);
 	ctrl_reg &= ~PRU_REG_PROC_EN;
 	ctrl_reg &= ~PRU_REG_SINGLE_STEP;
-	pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG] = ctrl_reg;
+	ctrl_set(ctrl_reg);
 }
 
 void cmd_single_step(unsigned int N)
@@ -596,22 +1066,22 @@ void cmd_single_step(unsigned int N)
 
 	for (i = 0; i < N; ++i ) {
 		// set single step mode and enable processor
-		ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+		ctrl_reg = pru_ctrl_read(pru_num, PRU_CTRL_REG);
 		ctrl_reg |= PRU_REG_PROC_EN | PRU_REG_SINGLE_STEP;
-		pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG] = ctrl_reg;
+		ctrl_set(ctrl_reg);
 	}
 
 	// print the registers
 	cmd_printrcs(kReg);
 
 	// disable single step mode and disable processor
-	ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+	ctrl_reg = pru_ctrl_read(pru_num, PRU_CTRL_REG);
 	ctrl_reg &= ~PRU_REG_PROC_EN;
 	ctrl_reg &= ~PRU_REG_SINGLE_STEP;
-	pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG] = ctrl_reg;
+	ctrl_set(ctrl_reg);
 }
 
-void cmd_trace(unsigned int k_elements, unsigned int on_halt, const char* filename)
+void cmd_trace(unsigned int k_elements, unsigned int on_halt)
 {
 	size_t len = k_elements * 1000;
 	uint16_t* trace = (uint16_t*)calloc(sizeof(uint16_t), len);
@@ -631,53 +1101,53 @@ void cmd_trace(unsigned int k_elements, unsigned int on_halt, const char* filena
 		if (addr != trace[count - 1])
 			trace[count++] = addr;
 		if (on_halt) {
-			if(INST_HALT == get_instruction(addr))
+			if(iram_is_halt(addr))
 				break;
 		}
 	}
-	if (filename) {
-		FILE* stream = fopen(filename, "w");
-		char str[10];
-		if (!stream) {
-			fprintf(stderr, "Error %d %s while creating %s\n", errno, strerror(errno), filename);
-			goto cleanup;
-		}
-		for (size_t n = 0; n < count; ++n)
-		{
-			snprintf(str, sizeof(str), "0x%04x\n", trace[n]);
-			size_t ret = fwrite(str, strlen(str), 1, stream);
-			if(ret != 1) {
-				fprintf(stderr, "Error while writing to file %s. It may be truncated\n", filename);
-				break;
-			}
-		}
-		int ret = fclose(stream);
-		if (ret) {
-			fprintf(stderr, "Error %d %s while closing file %s\n", errno, strerror(errno), filename);
-			goto cleanup;
-		}
-		printf("Trace written to %s\n", filename);
-	} else {
-		printf("Trace [%d]:\n", count);
-		for(size_t n = 0; n < count; ++n)
-		{
-			printf("0x%04x ", trace[n]);
-			if((count % 16) == 15)
-				printf("\n");
-		}
-		printf("\n");
+	printf("Trace [%d]:\n", count);
+	for(size_t n = 0; n < count; ++n)
+	{
+		printf("0x%04x ", trace[n]);
+		if((count % 16) == 15)
+			printf("\n");
 	}
-cleanup:
+	printf("\n");
 	free(trace);
 }
 
+void cmd_trace_stream(const char *fn, const struct trace_opts *opts)
+{
+	loop_should_stop = 0;
+	signal(SIGINT, loop_signal_handler);
+	trace_stream(fn, opts, &loop_should_stop);
+}
+
+void cmd_prof(double seconds, unsigned long rate)
+{
+	loop_should_stop = 0;
+	signal(SIGINT, loop_signal_handler);
+	prof_run(seconds, rate, &loop_should_stop);
+}
+
+// PROF DIS, FUNC and FOLDED, with the symbols of the active PRU
+void cmd_prof_report(const char *what, unsigned int addr, unsigned int len, const char *fn)
+{
+	if (!strcasecmp(what, "DIS"))
+		prof_dis(syms[pru_num], addr, len);
+	else if (!strcasecmp(what, "FUNC"))
+		prof_funcs(syms[pru_num]);
+	else
+		prof_folded(syms[pru_num], fn);
+}
+
 void cmd_soft_reset()
 {
 	unsigned int		ctrl_reg;
 
-	ctrl_reg = pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG];
+	ctrl_reg = pru_ctrl_read(pru_num, PRU_CTRL_REG);
 	ctrl_reg &= ~PRU_REG_SOFT_RESET;
-	pru[pru_ctrl_base[pru_num] + PRU_CTRL_REG] = ctrl_reg;
+	ctrl_set(ctrl_reg);
 
 	printf("PRU%u reset.\n", pru_num);
 }
@@ -685,62 +1155,99 @@ void cmd_soft_reset()
 // print list of watches
 void cmd_print_watch()
 {
-	int			i;
+	unsigned int		i, n = 0;
 
-	printf("##  Address  Value\n");
+	printf("##   Address  Value\n");
 	for (i=0; i<MAX_WATCH; i++) {
 		if (wa[pru_num][i].state == WA_PRINT_ON_ANY) {
-			printf("%02u  0x%05x     Print on any change from:\n",
+			printf("%03u  0x%05x     Print on any change from:\n",
 			       i, wa[pru_num][i].address);
 			cmd_dx_rows("\t\t", wa[pru_num][i].old_value, 0, 0x0,
 				    wa[pru_num][i].len);
+			n++;
 
 		} else if (wa[pru_num][i].state == WA_HALT_ON_VALUE) {
-			printf("%02u  0x%05x     Halt = \n",
+			printf("%03u  0x%05x     Halt = \n",
 			       i, wa[pru_num][i].address);
 			cmd_dx_rows("\t\t", wa[pru_num][i].value, 0, 0x0,
 				    wa[pru_num][i].len);
-
-		} else {
-			printf("%02u  UNUSED\n", i);
+			n++;
 		}
 	}
-	printf("\n");
+	printf("%u of %u watch points set\n\n", n, MAX_WATCH);
 }
 
 // clear a watch from list
 void cmd_clear_watch (unsigned int wanum)
 {
 	wa[pru_num][wanum].state = WA_UNUSED;
+	free(wa[pru_num][wanum].value);
+	free(wa[pru_num][wanum].old_value);
+	wa[pru_num][wanum].value = NULL;
+	wa[pru_num][wanum].old_value = NULL;
 }
 
 inline unsigned int min(unsigned int a, unsigned int b) {
 	return a < b ? a : b;
 }
 
+// (re)allocate the buffer of a watch for len bytes at addr, 0 on success
+static int watch_alloc(unsigned int addr, unsigned int len, unsigned char **buf)
+{
+	unsigned int		base = pru_data_base[pru_num]*4, size = pruss_layout.pruss_len;
+	unsigned char		*p;
+
+	// no base + addr + len, which can wrap
+	if (base > size || len > size - base || addr > size - base - len) {
+		printf("ERROR: watch 0x%x+0x%x is outside the PRUSS\n", addr, len);
+		return -1;
+	}
+	p = realloc(*buf, len ? len : 1);
+	if (!p) {
+		printf("ERROR: out of memory\n");
+		return -1;
+	}
+	*buf = p;
+	return 0;
+}
+
 // set a watch for any change in value and no halt
 void cmd_set_watch_any (unsigned int wanum, unsigned int addr, unsigned int len)
 {
-	unsigned char * pru_u8 = (unsigned char*)pru;
+	len = min(len, MAX_WATCH_LEN);
+	if (watch_alloc(addr, len, &wa[pru_num][wanum].old_value))
+		return;
 	wa[pru_num][wanum].state	= WA_PRINT_ON_ANY;
 	wa[pru_num][wanum].address	= addr;
 	wa[pru_num][wanum].len		= len;
-	memcpy(wa[pru_num][wanum].old_value,
-	       pru_u8 + pru_data_base[pru_num]*4 + addr,
-	       min(len, MAX_WATCH_LEN));
+	pru_read_block(pru_data_base[pru_num]*4 + addr,
+		       wa[pru_num][wanum].old_value, len);
 }
 
 // set a watch for a specific value and halt
 void cmd_set_watch (unsigned int wanum, unsigned int addr,
 		    unsigned int len, unsigned char * value)
 {
+	len = min(len, MAX_WATCH_LEN);
+	if (watch_alloc(addr, len, &wa[pru_num][wanum].value))
+		return;
 	wa[pru_num][wanum].state	= WA_HALT_ON_VALUE;
 	wa[pru_num][wanum].address	= addr;
 	wa[pru_num][wanum].len		= len;
-	memcpy(wa[pru_num][wanum].value, value,
-	       min(len, MAX_WATCH_LEN));
+	memcpy(wa[pru_num][wanum].value, value, len);
 }
 
 void cmd_free() {
 	free_reg_names();
+	prof_free();
+	rec_stop();
+	for (unsigned int i = 0; i < MAX_NUM_OF_PRUS; i++) {
+		sym_free(syms[i]);
+		for (unsigned int j = 0; j < MAX_BREAKPOINTS; j++)
+			cond_free(bp[i][j].cond);
+		for (unsigned int j = 0; j < MAX_WATCH; j++) {
+			free(wa[i][j].value);
+			free(wa[i][j].old_value);
+		}
+	}
 }
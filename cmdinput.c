@@ -63,7 +63,7 @@ int cmd_input(char *prompt, char *cmd, char *cmdargs, unsigned int *argptrs, uns
 	// build index array and count number of arguments
 	for (i=strlen(cmd), on_zero=TRUE, numargs[0]=0; i<full_len; i++) {
 		if (on_zero) {
-			if (buf[i] != 0) {
+			if (buf[i] != 0 && numargs[0] < MAX_ARGS) {
 				on_zero = FALSE;
 				argptrs[numargs[0]++] = i;
 			}
@@ -0,0 +1,359 @@
+/*
+ *
+ *  PRU Debug Program - breakpoint conditions
+ *
+ *  A condition such as "R5.w0 > 100 && HITS >= 3000" is compiled once,
+ *  when the breakpoint is set, into a short program for a stack machine
+ *  over unsigned 32-bit values.  Running it is a switch per operation;
+ *  the only device accesses are the register, cycle counter and memory
+ *  reads the condition names, each register read at most once per
+ *  evaluation, and && and || skip the side they don't need.
+ *
+ *  Operands: numbers (decimal, 0x, 0b), R0..R31 with an optional .b0-.b3
+ *  or .w0-.w2 field, CYCLE and STALL (counter registers), HITS (times the
+ *  breakpoint was reached, this time included) and [expr], the 32-bit
+ *  word at byte address expr of data memory as seen by WA, also with an
+ *  optional field.  Operators are those of C with C precedence:
+ *  || && | ^ & == != < <= > >= << >> + - * / % and unary ! ~ -.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "prudbg.h"
+#include "backend.h"
+
+#define COND_MAX_OPS		64
+#define COND_STACK		16
+
+enum cond_opcode {
+	C_NUM,		// push v
+	C_REG,		// push register a
+	C_CYCLE, C_STALL, C_HITS,
+	C_MEM,		// replace the address on top with the word there
+	C_FIELD,	// top = (top >> a) & v
+	C_JZ,		// top == 0: jump to v, else pop
+	C_JNZ,		// top != 0: top = 1 and jump to v, else pop
+	C_BOOL,		// top = top != 0
+	C_NOT, C_INV, C_NEG,
+	C_MUL, C_DIV, C_MOD, C_ADD, C_SUB, C_SHL, C_SHR,
+	C_LT, C_LE, C_GT, C_GE, C_EQ, C_NE, C_AND, C_XOR, C_OR,
+};
+
+struct cond_op {
+	uint8_t			op;
+	uint8_t			a;
+	uint32_t		v;
+};
+
+struct cond {
+	unsigned int		n;
+	struct cond_op		ops[COND_MAX_OPS];
+	char			text[];
+};
+
+// compiler state
+struct cond_parse {
+	const char		*s, *start;
+	struct cond		*c;
+	int			depth, max_depth;
+	int			err;
+};
+
+static int parse_expr(struct cond_parse *p, int prec);
+
+static void perr(struct cond_parse *p, const char *msg)
+{
+	if (!p->err)
+		printf("ERROR: %s at column %u of condition\n", msg, (unsigned int)(p->s - p->start) + 1);
+	p->err = 1;
+}
+
+static void skip_space(struct cond_parse *p)
+{
+	while (isspace((unsigned char)*p->s))
+		p->s++;
+}
+
+// append an operation; delta is its effect on the stack depth
+static unsigned int emit(struct cond_parse *p, int op, int a, uint32_t v, int delta)
+{
+	if (p->c->n == COND_MAX_OPS) {
+		perr(p, "condition too long");
+		return 0;
+	}
+	p->c->ops[p->c->n].op = op;
+	p->c->ops[p->c->n].a = a;
+	p->c->ops[p->c->n].v = v;
+	p->depth += delta;
+	if (p->depth > p->max_depth)
+		p->max_depth = p->depth;
+	return p->c->n++;
+}
+
+static int match_word(struct cond_parse *p, const char *w)
+{
+	size_t			n = strlen(w);
+
+	if (strncasecmp(p->s, w, n) || isalnum((unsigned char)p->s[n]) || p->s[n] == '_')
+		return 0;
+	p->s += n;
+	return 1;
+}
+
+// optional .b0-.b3 or .w0-.w2 after a register or memory operand
+static void parse_field(struct cond_parse *p)
+{
+	char			k;
+	unsigned int		i;
+
+	if (*p->s != '.')
+		return;
+	k = toupper((unsigned char)p->s[1]);
+	i = p->s[2] - '0';
+	if ((k == 'B' && i <= 3) || (k == 'W' && i <= 2)) {
+		p->s += 3;
+		emit(p, C_FIELD, i * 8, k == 'B' ? 0xFF : 0xFFFF, 0);
+	} else {
+		perr(p, "expected .b0-.b3 or .w0-.w2");
+	}
+}
+
+static void parse_primary(struct cond_parse *p)
+{
+	char			*end;
+	unsigned long		v;
+
+	skip_space(p);
+	if (*p->s == '(') {
+		p->s++;
+		parse_expr(p, 0);
+		skip_space(p);
+		if (*p->s != ')')
+			perr(p, "expected )");
+		else
+			p->s++;
+	} else if (*p->s == '[') {
+		p->s++;
+		parse_expr(p, 0);
+		skip_space(p);
+		if (*p->s != ']') {
+			perr(p, "expected ]");
+			return;
+		}
+		p->s++;
+		emit(p, C_MEM, 0, 0, 0);
+		parse_field(p);
+	} else if (*p->s == '!' || *p->s == '~' || *p->s == '-') {
+		char op = *p->s++;
+
+		parse_primary(p);
+		emit(p, op == '!' ? C_NOT : op == '~' ? C_INV : C_NEG, 0, 0, 0);
+	} else if (toupper((unsigned char)*p->s) == 'R' && isdigit((unsigned char)p->s[1])) {
+		v = strtoul(p->s + 1, &end, 10);
+		if (v >= NUM_REGS || isalnum((unsigned char)*end)) {
+			perr(p, "no such register");
+			return;
+		}
+		p->s = end;
+		emit(p, C_REG, v, 0, 1);
+		parse_field(p);
+	} else if (match_word(p, "CYCLE")) {
+		emit(p, C_CYCLE, 0, 0, 1);
+	} else if (match_word(p, "STALL")) {
+		emit(p, C_STALL, 0, 0, 1);
+	} else if (match_word(p, "HITS")) {
+		emit(p, C_HITS, 0, 0, 1);
+	} else if (isdigit((unsigned char)*p->s)) {
+		if (!strncasecmp(p->s, "0b", 2))
+			v = strtoul(p->s + 2, &end, 2);
+		else
+			v = strtoul(p->s, &end, 0);
+		if (isalnum((unsigned char)*end)) {
+			perr(p, "bad number");
+			return;
+		}
+		p->s = end;
+		emit(p, C_NUM, 0, v, 1);
+	} else {
+		perr(p, "expected a number, register, CYCLE, STALL, HITS or [address]");
+	}
+}
+
+// binary operators: text, precedence (higher binds tighter), opcode
+static const struct {
+	const char		*s;
+	int			prec;
+	int			op;
+} binops[] = {
+	{"||", 1, C_OR}, {"&&", 2, C_AND},
+	{"==", 6, C_EQ}, {"!=", 6, C_NE}, {"<=", 7, C_LE}, {">=", 7, C_GE},
+	{"<<", 8, C_SHL}, {">>", 8, C_SHR},
+	{"|", 3, C_OR}, {"^", 4, C_XOR}, {"&", 5, C_AND},
+	{"<", 7, C_LT}, {">", 7, C_GT},
+	{"+", 9, C_ADD}, {"-", 9, C_SUB},
+	{"*", 10, C_MUL}, {"/", 10, C_DIV}, {"%", 10, C_MOD},
+};
+
+// precedence climbing; && and || become jumps around their right side
+static int parse_expr(struct cond_parse *p, int prec)
+{
+	unsigned int		i, j;
+
+	parse_primary(p);
+	while (!p->err) {
+		skip_space(p);
+		for (i = 0; i < sizeof(binops) / sizeof(binops[0]); i++) {
+			if (!strncmp(p->s, binops[i].s, strlen(binops[i].s)))
+				break;
+		}
+		if (i == sizeof(binops) / sizeof(binops[0]) || binops[i].prec <= prec)
+			return 0;
+		p->s += strlen(binops[i].s);
+		if (binops[i].prec <= 2) {
+			j = emit(p, binops[i].prec == 2 ? C_JZ : C_JNZ, 0, 0, -1);
+			parse_expr(p, binops[i].prec);
+			emit(p, C_BOOL, 0, 0, 0);
+			p->c->ops[j].v = p->c->n;
+		} else {
+			parse_expr(p, binops[i].prec);
+			emit(p, binops[i].op, 0, 0, -1);
+		}
+	}
+	return 0;
+}
+
+// compile text, NULL after printing an error
+struct cond *cond_compile(const char *text)
+{
+	struct cond_parse	p = { .s = text, .start = text };
+
+	p.c = calloc(1, sizeof(*p.c) + strlen(text) + 1);
+	if (!p.c) {
+		printf("ERROR: out of memory\n");
+		return NULL;
+	}
+	strcpy(p.c->text, text);
+	parse_expr(&p, 0);
+	skip_space(&p);
+	if (!p.err && *p.s)
+		perr(&p, "unexpected text");
+	if (!p.err && p.max_depth > COND_STACK)
+		perr(&p, "condition too deeply nested");
+	if (p.err) {
+		free(p.c);
+		return NULL;
+	}
+	return p.c;
+}
+
+void cond_free(struct cond *c)
+{
+	free(c);
+}
+
+const char *cond_text(const struct cond *c)
+{
+	return c->text;
+}
+
+// the 32-bit word at byte address addr of the active PRU's data memory
+static uint32_t cond_mem(uint32_t addr)
+{
+	uint32_t		v = 0;
+	unsigned long		off = pru_data_base[pru_num] * 4ul + addr;
+
+	if (off + 4 <= pruss_layout.pruss_len)
+		pru_read_block(off, &v, 4);
+	return v;
+}
+
+// evaluate c for a halted PRU that reached its breakpoint for the hits-th time
+int cond_eval(const struct cond *c, unsigned long hits)
+{
+	uint32_t		st[COND_STACK + 1], regs[NUM_REGS], loaded = 0;
+	const struct cond_op	*o;
+	unsigned int		pc, sp = 0;
+	uint32_t		b;
+
+	for (pc = 0; pc < c->n; pc++) {
+		o = &c->ops[pc];
+		switch (o->op) {
+		case C_NUM:
+			st[sp++] = o->v;
+			break;
+		case C_REG:
+			if (!(loaded & (1u << o->a))) {
+				regs[o->a] = pru_ctrl_read(pru_num, PRU_INTGPR_REG + o->a);
+				loaded |= 1u << o->a;
+			}
+			st[sp++] = regs[o->a];
+			break;
+		case C_CYCLE:
+			st[sp++] = pru_ctrl_read(pru_num, PRU_CYCLE_REG);
+			break;
+		case C_STALL:
+			st[sp++] = pru_ctrl_read(pru_num, PRU_STALL_REG);
+			break;
+		case C_HITS:
+			st[sp++] = hits;
+			break;
+		case C_MEM:
+			st[sp - 1] = cond_mem(st[sp - 1]);
+			break;
+		case C_FIELD:
+			st[sp - 1] = (st[sp - 1] >> o->a) & o->v;
+			break;
+		case C_JZ:
+			if (!st[sp - 1])
+				pc = o->v - 1;
+			else
+				sp--;
+			break;
+		case C_JNZ:
+			if (st[sp - 1]) {
+				st[sp - 1] = 1;
+				pc = o->v - 1;
+			} else {
+				sp--;
+			}
+			break;
+		case C_BOOL:
+			st[sp - 1] = st[sp - 1] != 0;
+			break;
+		case C_NOT:
+			st[sp - 1] = !st[sp - 1];
+			break;
+		case C_INV:
+			st[sp - 1] = ~st[sp - 1];
+			break;
+		case C_NEG:
+			st[sp - 1] = -st[sp - 1];
+			break;
+		default:
+			b = st[--sp];
+			switch (o->op) {
+			case C_MUL: st[sp - 1] *= b; break;
+			case C_DIV: st[sp - 1] = b ? st[sp - 1] / b : 0; break;
+			case C_MOD: st[sp - 1] = b ? st[sp - 1] % b : 0; break;
+			case C_ADD: st[sp - 1] += b; break;
+			case C_SUB: st[sp - 1] -= b; break;
+			case C_SHL: st[sp - 1] = b < 32 ? st[sp - 1] << b : 0; break;
+			case C_SHR: st[sp - 1] = b < 32 ? st[sp - 1] >> b : 0; break;
+			case C_LT: st[sp - 1] = st[sp - 1] < b; break;
+			case C_LE: st[sp - 1] = st[sp - 1] <= b; break;
+			case C_GT: st[sp - 1] = st[sp - 1] > b; break;
+			case C_GE: st[sp - 1] = st[sp - 1] >= b; break;
+			case C_EQ: st[sp - 1] = st[sp - 1] == b; break;
+			case C_NE: st[sp - 1] = st[sp - 1] != b; break;
+			case C_AND: st[sp - 1] &= b; break;
+			case C_XOR: st[sp - 1] ^= b; break;
+			case C_OR: st[sp - 1] |= b; break;
+			}
+		}
+	}
+	return sp && st[sp - 1];
+}
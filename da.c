@@ -1,6 +1,6 @@
-/* 
+/*
  *
- *  PRU Debug Program - disassembly routines
+ *  PRU Debug Program - instruction decoder and disassembly routines
  *  (c) Copyright 2011 by Arctica Technologies
  *  Written by Steven Anderson
  *
@@ -16,366 +16,690 @@
 #include <termios.h>
 #include <sys/ioctl.h>
 #include <sys/select.h>
+#include <string.h>
 
 #include "prudbg.h"
+#include "da.h"
 
-// util function to decode BurstLen in Format 6 instructions
-void GetBurstLen(char *tempstr, unsigned int len, unsigned int BurstLen)
+#define DA_OP_NAME(op, name)	[op] = name,
+#define DA_OP_LEN(op, name)	[op] = sizeof(name) - 1,
+const char pru_op_name[PRU_NUM_OPS][8] = { PRU_OPS(DA_OP_NAME) };
+static const unsigned char pru_op_len[PRU_NUM_OPS] = { PRU_OPS(DA_OP_LEN) };
+
+struct da_entry {
+	unsigned char		op;
+	unsigned char		fmt;
+	unsigned char		flags;
+};
+
+// Decode table indexed by the top 7 bits of the instruction (inst >> 25),
+// i.e. the 3-bit OP field followed by the 4 bits that hold the ALUOP/SUBOP,
+// the branch test or the load/store flag depending on the format.
+#define DA_QB(op)	{op, 4, PRU_INSN_BRANCH | PRU_INSN_COND}
+#define DA_QBB(op)	{op, 5, PRU_INSN_BRANCH | PRU_INSN_COND}
+#define DA_QBX(f)	{PRU_QBXX, f, PRU_INSN_INVALID}
+#define DA_QBA		{PRU_QBA, 4, PRU_INSN_BRANCH}
+#define DA_LD(op)	{op, 6, PRU_INSN_LOAD}
+#define DA_ST(op)	{op, 6, PRU_INSN_STORE}
+#define DA_BAD(f)	{PRU_INVALID, f, PRU_INSN_INVALID}
+#define DA_ROW4(e)	e, e, e, e
+#define DA_ROW8(e)	e, e, e, e, e, e, e, e
+
+static const struct da_entry da_table[128] = {
+	// OP 0 - format 1
+	{PRU_ADD, 1, 0}, {PRU_ADC, 1, 0}, {PRU_SUB, 1, 0}, {PRU_SUC, 1, 0},
+	{PRU_LSL, 1, 0}, {PRU_LSR, 1, 0}, {PRU_RSB, 1, 0}, {PRU_RSC, 1, 0},
+	{PRU_AND, 1, 0}, {PRU_OR, 1, 0}, {PRU_XOR, 1, 0}, {PRU_NOT, 1, 0},
+	{PRU_MIN, 1, 0}, {PRU_MAX, 1, 0}, {PRU_CLR, 1, 0}, {PRU_SET, 1, 0},
+	// OP 1 - format 2
+	{PRU_JMP, 2, PRU_INSN_BRANCH},
+	{PRU_JAL, 2, PRU_INSN_BRANCH | PRU_INSN_CALL},
+	{PRU_LDI, 2, 0}, {PRU_LMBD, 2, 0}, {PRU_SCAN, 2, 0},
+	{PRU_HALT, 2, PRU_INSN_HALT}, {PRU_MVI, 2, 0},
+	{PRU_XIN, 2, 0},	// or XOUT/XCHG, see pru_decode()
+	{PRU_LOOP, 2, 0},
+	DA_BAD(2), DA_BAD(2), DA_BAD(2), DA_BAD(2), DA_BAD(2), DA_BAD(2),
+	{PRU_SLP, 2, 0},
+	// OP 2 & 3 - format 4, test is bits 29..27
+	DA_ROW4(DA_QBX(4)), DA_ROW4(DA_QB(PRU_QBLT)),
+	DA_ROW4(DA_QB(PRU_QBEQ)), DA_ROW4(DA_QB(PRU_QBLE)),
+	DA_ROW4(DA_QB(PRU_QBGT)), DA_ROW4(DA_QB(PRU_QBNE)),
+	DA_ROW4(DA_QB(PRU_QBGE)), DA_ROW4(DA_QBA),
+	// OP 4 - format 6, load/store is bit 28
+	DA_ROW8(DA_ST(PRU_SBCO)),
+	DA_ROW8(DA_LD(PRU_LBCO)),
+	// OP 5
+	DA_ROW8(DA_BAD(0)), DA_ROW8(DA_BAD(0)),
+	// OP 6 - format 5, test is bits 28..27
+	DA_ROW4(DA_QBX(5)), DA_ROW4(DA_QBB(PRU_QBBC)),
+	DA_ROW4(DA_QBB(PRU_QBBS)), DA_ROW4(DA_QBX(5)),
+	// OP 7 - format 6, load/store is bit 28
+	DA_ROW8(DA_ST(PRU_SBBO)),
+	DA_ROW8(DA_LD(PRU_LBBO)),
+};
+
+// constant table after reset, as on the AM335x PRU-ICSS; C24..C31 assume
+// their programmable block offsets are still zero
+const uint32_t pru_ct_reset[32] = {
+	0x00020000, 0x48040000, 0x4802A000, 0x00030000,
+	0x00026000, 0x4806A000, 0x48030000, 0x00028000,
+	0x46000000, 0x4A100000, 0x48318000, 0x48022000,
+	0x48024000, 0x48310000, 0x481CC000, 0x481D0000,
+	0x481A0000, 0x4819C000, 0x48300000, 0x48302000,
+	0x48304000, 0x00032400, 0x480C8000, 0x480CA000,
+	0x00000000, 0x00002000, 0x0002E000, 0x00032000,
+	0x00010000, 0x49000000, 0x40000000, 0x80000000,
+};
+
+static const char	sis[8][4] = {".b0", ".b1", ".b2", ".b3", ".w0", ".w1", ".w2", ""};
+static const char	sis_len[] = {3, 3, 3, 3, 3, 3, 3, 0};
+static const char	*bytenum[] = {"", ".b1", ".b2", ".b3"};
+
+// Output cursor.  Instructions are formatted into a scratch buffer that is
+// always large enough for the longest mnemonic and operand list, so the
+// emitters don't need any bounds checks; disassemble() copies the result
+// out with snprintf()-like truncation.  Mnemonics and field suffixes are
+// copied as fixed 8 and 4-byte blocks, which relies on the same slack.
+#define DA_MAX_STR		64
+
+struct da_out {
+	char			*p;
+};
+
+static inline void out_c(struct da_out *o, char c)
 {
-	if (BurstLen < 124) {
-		snprintf(tempstr, len, "%u", BurstLen+1);
-	} else if (BurstLen == 124) {
-		snprintf(tempstr, len, "b0");
-	} else if (BurstLen == 125) {
-		snprintf(tempstr, len, "b1");
-	} else if (BurstLen == 126) {
-		snprintf(tempstr, len, "b2");
-	} else if (BurstLen == 127) {
-		snprintf(tempstr, len, "b3");
+	*o->p++ = c;
+}
+
+static inline void out_s(struct da_out *o, const char *s)
+{
+	while (*s)
+		*o->p++ = *s++;
+}
+
+static void out_u_slow(struct da_out *o, unsigned int v)
+{
+	char			tmp[10];
+	int			n = 0;
+
+	do {
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	while (n)
+		*o->p++ = tmp[--n];
+}
+
+// operands are nearly always below 100, keep that path inline
+static inline void out_u(struct da_out *o, unsigned int v)
+{
+	if (v < 10) {
+		*o->p++ = '0' + v;
+	} else if (v < 100) {
+		o->p[0] = '0' + v / 10;
+		o->p[1] = '0' + v % 10;
+		o->p += 2;
 	} else {
-		snprintf(tempstr, len, "XX");
+		out_u_slow(o, v);
 	}
 }
 
-// disassemble the inst instruction and place string in str
-void disassemble(char *str, unsigned int len, unsigned int inst)
+static void out_d(struct da_out *o, int v)
 {
-	unsigned short		Imm;
-	unsigned char		OP, ALUOP, Rs2Sel, Rs2, Rs1Sel, Rs1, RdSel, Rd, IO, Imm2, SUBOP, Test;
-	unsigned char		LoadStore, BurstLen, RxByteAddr, Rx, Ro, RoSel, Rb;
-	short			BrOff;
-	char			tempstr[50];
-
-	char			*f1_inst[] = {
-					"ADD", "ADC", "SUB", "SUC", "LSL",
-					"LSR", "RSB", "RSC", "AND", "OR",
-					"XOR", "NOT", "MIN", "MAX", "CLR",
-					"SET"};
-	char			*f2_inst[] = {
-					"JMP", "JAL", "LDI", "LMBD", "SCAN",
-					"HALT", "MVI", "RESERVED", "LOOP",
-					"RESERVED", "RESERVED", "RESERVED",
-					"RESERVED", "RESERVED", "RESERVED",
-					"SLP"};
-	char			*f4_inst[] = {"xx", "LT", "EQ", "LE", "GT", "NE", "GE", "A"};
-	char			*f5_inst[] = {"xx", "BC", "BS", "xx"};
-	char			*f6_7_inst[] = {"SBBO", "LBBO"};
-	char			*f6_4_inst[] = {"SBCO", "LBCO"};
-	char			*sis[] = {".b0", ".b1", ".b2", ".b3", ".w0", ".w1", ".w2", ""};
-	char			*bytenum[] = {"", ".b1", ".b2", ".b3"};
-
-	OP = (inst & 0xE0000000) >> 29;
-
-	switch (OP) {
-		case 0:		// format 1
-			ALUOP = (inst & 0x1E000000) >> 25;
-			IO = (inst & 0x01000000) >> 24;
-			Rs1Sel = (inst & 0x0000E000) >> 13;
-			Rs1 = (inst & 0x00001F00) >> 8;
-			RdSel = (inst & 0x000000E0) >> 5;
-			Rd = (inst & 0x0000001F);
-			if (IO) {
-				Imm2 = (inst & 0x00FF0000) >> 16;
-				snprintf(str, len,"%s R%u%s, R%u%s, 0x%02x", f1_inst[ALUOP], Rd, sis[RdSel], Rs1, sis[Rs1Sel], Imm2);
-			} else {
-				Rs2Sel = (inst & 0x00E00000) >> 21;
-				Rs2 = (inst & 0x001F0000) >> 16;
-				snprintf(str, len,"%s R%u%s, R%u%s, R%u%s", f1_inst[ALUOP], Rd, sis[RdSel], Rs1, sis[Rs1Sel], Rs2, sis[Rs2Sel]);
-			}
-			break;
+	if (v < 0) {
+		out_c(o, '-');
+		out_u(o, -(unsigned int)v);
+	} else {
+		out_u(o, v);
+	}
+}
 
-		case 1:		// format 2
-			SUBOP = (inst & 0x1E000000) >> 25;
-			switch (SUBOP) {
-				case 0:			// JMP & JAL
-				case 1:
-					IO = (inst & 0x01000000) >> 24;
-					RdSel = (inst & 0x000000E0) >> 5;
-					Rd = (inst & 0x0000001F);
-					if (IO) {
-						Imm = (inst & 0x00FFFF00) >> 8;
-						if (SUBOP == 0)
-							snprintf(str, len,"%s 0x%04x", f2_inst[SUBOP], Imm);
-						else
-							snprintf(str, len,"%s R%u%s, 0x%04x", f2_inst[SUBOP], Rd, sis[RdSel], Imm);
-					} else {
-						Rs2Sel = (inst & 0x00E00000) >> 21;
-						Rs2 = (inst & 0x001F0000) >> 16;
-						if (SUBOP == 0)
-							snprintf(str, len,"%s R%u%s", f2_inst[SUBOP], Rs2, sis[Rs2Sel]);
-						else
-							snprintf(str, len,"%s R%u%s, R%u%s", f2_inst[SUBOP], Rd, sis[RdSel], Rs2, sis[Rs2Sel]);
-					}
-					break;
+// lower case hex, zero padded to at least width digits
+static void out_x(struct da_out *o, unsigned int v, int width)
+{
+	static const char	digits[] = "0123456789abcdef";
+	char			tmp[8];
+	int			n = 0;
 
-				case 2:  // LDI
-					Imm = (inst & 0x00FFFF00) >> 8;
-					RdSel = (inst & 0x000000E0) >> 5;
-					Rd = (inst & 0x0000001F);
-					snprintf(str, len,"%s R%u%s, 0x%04x", f2_inst[SUBOP], Rd, sis[RdSel], Imm);
-					break;
+	do {
+		tmp[n++] = digits[v & 0xF];
+		v >>= 4;
+	} while (v);
+	while (width-- > n)
+		*o->p++ = '0';
+	while (n)
+		*o->p++ = tmp[--n];
+}
 
-				case 3:  // LMBD
-					IO = (inst & 0x01000000) >> 24;
-					Rs1Sel = (inst & 0x0000E000) >> 13;
-					Rs1 = (inst & 0x00001F00) >> 8;
-					RdSel = (inst & 0x000000E0) >> 5;
-					Rd = (inst & 0x0000001F);
-					Rs2Sel = (inst & 0x00E00000) >> 21;
-					Rs2 = (inst & 0x001F0000) >> 16;
-					Imm2 = (inst & 0x00FF0000) >> 16;
-					
-					if (IO) {
-						snprintf(str, len,"%s R%u%s, R%u%s, 0x%04x", f2_inst[SUBOP], Rd, sis[RdSel], Rs1, sis[Rs1Sel], Imm2);
-					} else {
-						snprintf(str, len,"%s R%u%s, R%u%s, R%u%s", f2_inst[SUBOP], Rd, sis[RdSel], Rs1, sis[Rs1Sel], Rs2, sis[Rs2Sel]);
-					}
+// same as printf's "%#x"
+static void out_altx(struct da_out *o, unsigned int v)
+{
+	if (v)
+		out_s(o, "0x");
+	out_x(o, v, 1);
+}
 
-					break;
+// mnemonic, copied as a fixed block
+static inline void out_mnemonic(struct da_out *o, unsigned int op)
+{
+	memcpy(o->p, pru_op_name[op], sizeof(pru_op_name[op]));
+	o->p += pru_op_len[op];
+}
+
+// "R<n><field>"
+static inline void out_reg(struct da_out *o, unsigned int r, unsigned int sel)
+{
+	*o->p++ = 'R';
+	if (r >= 10) {
+		*o->p++ = '0' + r / 10;
+		r %= 10;
+	}
+	*o->p++ = '0' + r;
+	memcpy(o->p, sis[sel], 4);
+	o->p += sis_len[sel];
+}
 
-				case 4:  // SCAN
-					IO = (inst & 0x01000000) >> 24;
-					RdSel = (inst & 0x000000E0) >> 5;
-					Rd = (inst & 0x0000001F);
-					Rs2Sel = (inst & 0x00E00000) >> 21;
-					Rs2 = (inst & 0x001F0000) >> 16;
-					Imm2 = (inst & 0x00FF0000) >> 16;
+// ", " separator
+static inline void out_sep(struct da_out *o)
+{
+	o->p[0] = ',';
+	o->p[1] = ' ';
+	o->p += 2;
+}
+
+// BurstLen in Format 6 instructions
+static void out_burst(struct da_out *o, unsigned int BurstLen)
+{
+	if (BurstLen < 124) {
+		out_u(o, BurstLen+1);
+	} else {
+		out_c(o, 'b');
+		out_c(o, '0' + BurstLen - 124);
+	}
+}
 
-					if (IO) {
-						snprintf(str, len,"%s R%u%s, 0x%04x", f2_inst[SUBOP], Rd, sis[RdSel], Imm2);
-					} else {
-						snprintf(str, len,"%s R%u%s, R%u%s", f2_inst[SUBOP], Rd, sis[RdSel], Rs2, sis[Rs2Sel]);
-					}
 
-					break;
+// split inst into its fields
+static inline __attribute__((always_inline))
+void da_decode(uint32_t inst, struct pru_insn *in)
+{
+	const struct da_entry	*e = &da_table[inst >> 25];
+	unsigned int		n, bits;
+
+	in->inst	= inst;
+	in->op		= e->op;
+	in->fmt		= e->fmt;
+	in->flags	= e->flags;
+	in->io		= (inst & 0x01000000) >> 24;
+	in->rd		= inst & 0x1F;
+	in->rd_sel	= (inst & 0xE0) >> 5;
+	in->rs1		= (inst & 0x1F00) >> 8;
+	in->rs1_sel	= (inst & 0xE000) >> 13;
+	in->rs2		= (inst & 0x001F0000) >> 16;
+	in->rs2_sel	= (inst & 0x00E00000) >> 21;
+	in->byte	= 0;
+	in->burst	= 0;
+	in->imm		= (inst & 0x00FF0000) >> 16;
+	in->broff	= 0;
+
+	switch (e->op) {
+		case PRU_JMP:
+		case PRU_JAL:
+			in->imm = (inst & 0x00FFFF00) >> 8;
+			if (!in->io)
+				in->flags |= PRU_INSN_INDIRECT;
+			break;
+
+		case PRU_LDI:
+			in->imm = (inst & 0x00FFFF00) >> 8;
+			in->io = 1;
+			break;
 
-				case 5:  // HALT
-					snprintf(str, len,"%s", f2_inst[SUBOP]);
+		case PRU_MVI:
+			// only recognise a subset, those in CODE_MVI_PLUS in
+			// pasmop.c with args R1.bX.  The error code is kept in
+			// imm for the formatter.
+			in->imm = 0;
+			for (n = 0; n < 2; ++n) {
+				bits = 0x3 & (inst >> (23 - n * 2));
+				// TODO: I think bits == 0 is a valid
+				// instruction, but with different args or
+				// something like that? Unsupported for now
+				if (0 == bits)
+					in->imm = 1;
+			}
+			// some three argument version? Unsupported for now
+			if (inst & (1 << 20))
+				in->imm = 2;
+			in->byte = (inst & 0x00030000) >> 16;	// width
+			if (in->byte == 3)
+				in->imm = 3;
+			if (in->imm)
+				in->flags |= PRU_INSN_INVALID;
+			break;
+
+		case PRU_XIN:
+			switch ((inst >> 23) & 0x5F) {
+				case 0x5D:
 					break;
-				case 6: // MVIB/MVIW/MIVIX
-				{
-					// only recognise a subset, those in CODE_MVI_PLUS in pasmop.c
-					// with args R1.bX
-					unsigned int err = 0;
-					unsigned int widthBits = (inst & 0x00030000) >> 16;
-					unsigned int itype = (inst & 0x01E00000) >> 21;//increment type
-					unsigned char hasPostInc[2];
-					unsigned char hasPreDec[2];
-					for(unsigned int n = 0; n < 2; ++n)
-					{
-						unsigned char bits = 0x3 & (itype >> ((1 - n) * 2));
-						hasPostInc[n] = bits == 2;
-						hasPreDec[n] = bits == 3;
-						// TODO: I think bits == 0 is a
-						// valid instruction, but with
-						// different args or something
-						// like that? Unsupported for now
-						if (0 == bits)
-							err = 1;
-					}
-					if(inst & (1 << 20))
-					{
-						// some three argument version? Unsupported for now
-						err = 2;
-					}
-					Rs1Sel = (inst & 0x0000E000) >> 13;
-					Rs1 = (inst & 0x00001F00) >> 8;
-					RdSel = (inst & 0x000000E0) >> 5;
-					Rd = (inst & 0x0000001F);
-					char const* widthStr;
-					switch(widthBits) {
-						case 0: // 1 byte
-							widthStr = "B";
-							break;
-						case 1: // 2 bytes
-							widthStr = "W";
-							break;
-						case 2: // 4 bytes
-							widthStr = "D";
-							break;
-						default:
-							err = 3;
-					}
-					if(err) {
-						snprintf(str, len,"UNKNOWN MVIx: %#x err: %d\n", inst, err);
-					} else {
-						snprintf(str, len,"%s%s *%sR%u%s%s, *%sR%u%s%s\n",
-							f2_inst[SUBOP], widthStr,
-							hasPreDec[0] ? "--" : "",
-							Rd, sis[RdSel],
-							hasPostInc[0] ? "++" : "",
-							hasPreDec[1] ? "--" : "",
-							Rs1,
-							sis[Rs1Sel],
-							hasPostInc[1] ? "++" : ""
-						);
-					}
-				}
+				case 0x5E:
+					in->op = PRU_XOUT;
 					break;
-				case 7: // XI/XOUT/XCHG
-				{
-					// OPCODE IM(253), Rdst, OP(124), n    -or-
-					// OPCODE IM(253), Rdst, bn
-					char* op = NULL;
-					switch((inst >> 23) & 0x5F) {
-						case 0x5D:
-							op = "XIN";
-							break;
-						case 0x5E:
-							op = "XOUT";
-							break;
-						case 0x5F:
-							op = "XCHG";
-							break;
-						default:
-							snprintf(str, len,"UNKNOWN-XI/XOUT: %#x\n", inst);
-							return;
-					}
-					// first argument is always an immediate
-					unsigned int imm0 = inst >> 15 & 0xff;
-					// Second argument is a REG, but pasmop.c shows
-					// it can be an immediate, too? If I understand the code
-					// right, and with a bit of a guesstimate, the opcode
-					// only allows for REG, but `pasm` tries to be clever
-					// and encode a number as a 5 bit register plus a FIELDTYPE.
-					// So, ultimately, when disassembling we only care about
-					// the register format
-					unsigned int arg1Val = inst & 0x7F;
-					// wX bitfields decay to bX
-					// because the allowed address
-					// range fits in it
-					char* bitFieldStr = "";
-					switch(0x3 & (inst >> 5)) {
-						case 0:
-							bitFieldStr = ".b0"; // could be left as ""
-							break;
-						case 1:
-							bitFieldStr = ".b1";
-							break;
-						case 2:
-							bitFieldStr = ".b2";
-							break;
-						case 3:
-							bitFieldStr = ".b3";
-							break;
-					}
-					unsigned int reg = arg1Val & 0x1F;
-					// third argument is an immediate if < 124,
-					// or a R0's bx byte otherwise
-					unsigned int arg2Val = (inst >> 7) & 0x7F;
-					char arg2Str[4];
-					if(arg2Val < 124) {
-						snprintf(arg2Str, sizeof(arg2Str),
-								"%d", arg2Val + 1); // encoded as imm -1
-					} else {
-						snprintf(arg2Str, sizeof(arg2Str),
-								"b%d", arg2Val - 124);
-					}
-					snprintf(str, len,"%s %d, &R%d%s, %s", op, imm0, reg, bitFieldStr, arg2Str);
-				}
+				case 0x5F:
+					in->op = PRU_XCHG;
 					break;
-				case 8: { // [I]LOOP
-					const char * I = (inst & (1<<15)) ? "I" : "";
-
-					BrOff  = (short)(inst & 0xff);
-					IO     = (inst & 0x01000000) >> 24;
-					Rs2Sel = (inst & 0x00E00000) >> 21;
-					Rs2    = (inst & 0x001F0000) >> 16;
-					Imm2   = (inst & 0x00FF0000) >> 16;
-
-					if (IO) {
-						snprintf(str, len,"%s%s %d, 0x%04x", I, f2_inst[SUBOP], BrOff, Imm2);
-					} else {
-						snprintf(str, len,"%s%s %d, R%u%s", I, f2_inst[SUBOP], BrOff, Rs2, sis[Rs2Sel]);
-					}
+				default:
+					in->op = PRU_INVALID;
+					in->flags |= PRU_INSN_INVALID;
 					break;
-				}
+			}
+			// XIN/XOUT/XCHG device, &Rx.bn, length
+			in->imm = (inst >> 15) & 0xff;
+			in->byte = (inst & 0x60) >> 5;
+			in->burst = (inst >> 7) & 0x7F;
+			in->rd_sel = in->byte;
+			in->rs1 = in->rs2 = 0;
+			in->rs1_sel = in->rs2_sel = PRU_SEL_FULL;
+			in->io = 0;
+			break;
 
-				case 15:  // SLP
-					Imm = (inst & 0x00800000) >> 23;
-					snprintf(str, len,"%s %u", f2_inst[SUBOP], Imm);
-					break;
+		case PRU_LOOP:
+			if (inst & (1<<15))
+				in->op = PRU_ILOOP;
+			in->broff = inst & 0xff;
+			break;
 
-				default:
-					snprintf(str, len,"UNKNOWN-F2 %#x %#x", inst, SUBOP);
-					break;
+		case PRU_SLP:
+			in->imm = (inst & 0x00800000) >> 23;
+			break;
+
+		case PRU_SBBO:
+		case PRU_LBBO:
+		case PRU_SBCO:
+		case PRU_LBCO:
+			in->burst = ((inst & 0x0E000000) >> 21) | ((inst & 0x0000E000) >> 12) | ((inst & 0x00000080) >> 7);
+			in->byte = (inst & 0x60) >> 5;
+			in->rd_sel = in->byte;
+			in->rs1_sel = PRU_SEL_FULL;
+			break;
+
+		default:
+			if (e->fmt == 4 || e->fmt == 5) {
+				in->broff = ((inst & 0x06000000) >> 17) | (inst & 0x000000FF);
+				if (in->broff & 0x0200)
+					in->broff -= 0x0400;
+				if (e->fmt == 5)
+					in->imm = in->rs2;
+			}
+			break;
+	}
+}
+
+static void da_mvi(struct da_out *o, const struct pru_insn *in)
+{
+	unsigned int		itype = (in->inst & 0x01E00000) >> 21;//increment type
+	unsigned int		dst = itype >> 2, src = itype & 3;
+
+	if (in->imm) {
+		out_s(o, "UNKNOWN MVIx: ");
+		out_altx(o, in->inst);
+		out_s(o, " err: ");
+		out_u(o, in->imm);
+		out_c(o, '\n');
+		return;
+	}
+	// 2 is post-increment, 3 is pre-decrement
+	out_s(o, "MVI");
+	out_c(o, "BWD"[in->byte]);
+	out_s(o, " *");
+	if (dst == 3)
+		out_s(o, "--");
+	out_reg(o, in->rd, in->rd_sel);
+	if (dst == 2)
+		out_s(o, "++");
+	out_s(o, ", *");
+	if (src == 3)
+		out_s(o, "--");
+	out_reg(o, in->rs1, in->rs1_sel);
+	if (src == 2)
+		out_s(o, "++");
+	out_c(o, '\n');
+}
+
+static void da_xio(struct da_out *o, const struct pru_insn *in)
+{
+	// OPCODE IM(253), Rdst, OP(124), n    -or-
+	// OPCODE IM(253), Rdst, bn
+	// The second argument is a REG, but pasmop.c shows it can be an
+	// immediate, too? If I understand the code right, and with a bit of a
+	// guesstimate, the opcode only allows for REG, but `pasm` tries to be
+	// clever and encode a number as a 5 bit register plus a FIELDTYPE.
+	// So, ultimately, when disassembling we only care about the register
+	// format.  wX bitfields decay to bX because the allowed address range
+	// fits in it.
+	out_mnemonic(o, in->op);
+	out_c(o, ' ');
+	out_u(o, in->imm);
+	out_s(o, ", &R");
+	out_u(o, in->rd);
+	out_s(o, sis[in->byte]);
+	out_sep(o);
+	// third argument is an immediate if < 124, or a R0's bx byte otherwise
+	out_burst(o, in->burst);
+}
+
+// format a decoded instruction into str, never writing more than len bytes
+static inline __attribute__((always_inline))
+void da_format(char *str, unsigned int len, const struct pru_insn *in)
+{
+	char			buf[DA_MAX_STR];
+	struct da_out		o;
+	size_t			n;
+
+	if (len == 0)
+		return;
+	o.p = buf;
+
+	switch (in->op) {
+		case PRU_ADD ... PRU_SET:
+			out_mnemonic(&o, in->op);
+			out_c(&o, ' ');
+			out_reg(&o, in->rd, in->rd_sel);
+			out_sep(&o);
+			out_reg(&o, in->rs1, in->rs1_sel);
+			out_sep(&o);
+			if (in->io) {
+				out_s(&o, "0x");
+				out_x(&o, in->imm, 2);
+			} else {
+				out_reg(&o, in->rs2, in->rs2_sel);
 			}
 			break;
 
-		case 2:  // Format 4a & 4b - Quick Arithmetic Test and Branch
-		case 3:
-			Test = (inst & 0x38000000) >> 27;
-			IO = (inst & 0x01000000) >> 24;
-			Rs2Sel = (inst & 0x00E00000) >> 21;
-			Rs2 = (inst & 0x001F0000) >> 16;
-			Rs1Sel = (inst & 0x0000E000) >> 13;
-			Rs1 = (inst & 0x00001F00) >> 8;
-			Imm = (inst & 0x00FF0000) >> 16;
-			BrOff = ((inst & 0x06000000) >> 17) | (inst & 0x000000FF);
-			if (BrOff & 0x0200) BrOff |= 0xFC00;
-
-			if (Test == 7) {
-				snprintf(str, len,"QBA %d", BrOff);
+		case PRU_JMP:
+		case PRU_JAL:
+			out_mnemonic(&o, in->op);
+			out_c(&o, ' ');
+			if (in->op == PRU_JAL) {
+				out_reg(&o, in->rd, in->rd_sel);
+				out_sep(&o);
+			}
+			if (in->io) {
+				out_s(&o, "0x");
+				out_x(&o, in->imm, 4);
 			} else {
-				if (IO) {
-					snprintf(str, len,"QB%s %d, R%u%s, %u", f4_inst[Test], BrOff, Rs1, sis[Rs1Sel], Imm);
-				} else {
-					snprintf(str, len,"QB%s %d, R%u%s, R%u%s", f4_inst[Test], BrOff, Rs1, sis[Rs1Sel], Rs2, sis[Rs2Sel]);
-				}
+				out_reg(&o, in->rs2, in->rs2_sel);
 			}
+			break;
 
+		case PRU_LDI:
+			out_s(&o, "LDI ");
+			out_reg(&o, in->rd, in->rd_sel);
+			out_s(&o, ", 0x");
+			out_x(&o, in->imm, 4);
 			break;
 
-		case 6:  // Format 5 - Quick bit test and banch instructions
-			Test = (inst & 0x18000000) >> 27;
-			IO = (inst & 0x01000000) >> 24;
-			Rs2Sel = (inst & 0x00E00000) >> 21;
-			Rs2 = (inst & 0x001F0000) >> 16;
-			Rs1Sel = (inst & 0x0000E000) >> 13;
-			Rs1 = (inst & 0x00001F00) >> 8;
-			Imm = (inst & 0x001F0000) >> 16;
-			BrOff = ((inst & 0x06000000) >> 17) | (inst & 0x000000FF);
-			if (BrOff & 0x0200) BrOff |= 0xFC00;
-
-			if (IO) {
-				snprintf(str, len,"QB%s %d, R%u%s, %u", f5_inst[Test], BrOff, Rs1, sis[Rs1Sel], Imm);
+		case PRU_LMBD:
+		case PRU_SCAN:
+			out_mnemonic(&o, in->op);
+			out_c(&o, ' ');
+			out_reg(&o, in->rd, in->rd_sel);
+			out_sep(&o);
+			if (in->op == PRU_LMBD) {
+				out_reg(&o, in->rs1, in->rs1_sel);
+				out_sep(&o);
+			}
+			if (in->io) {
+				out_s(&o, "0x");
+				out_x(&o, in->imm, 4);
 			} else {
-				snprintf(str, len,"QB%s %d, R%u%s, R%u%s", f5_inst[Test], BrOff, Rs1, sis[Rs1Sel], Rs2, sis[Rs2Sel]);
+				out_reg(&o, in->rs2, in->rs2_sel);
 			}
-			
 			break;
 
-		case 4:
-		case 7:  // Format 6 - LBBO/SBBO/LBCO/SBCO instructions
-			LoadStore = (inst & 0x10000000) >> 28;
-			BurstLen = ((inst & 0x0E000000) >> 21) | ((inst & 0x0000E000) >> 12) | ((inst & 0x00000080) >> 7);
-			IO = (inst & 0x01000000) >> 24;
-			RxByteAddr = (inst & 0x00000060) >> 5;
-			Rx = (inst & 0x0000001F);
-			RoSel = (inst & 0x00E00000) >> 21;
-			Ro = (inst & 0x001F0000) >> 16;
-			Rb = (inst & 0x00001F00) >> 8;
-			Imm = (inst & 0x00FF0000) >> 16;
-			GetBurstLen(tempstr, sizeof(tempstr), BurstLen);
-
-			if (OP == 7) {
-				if (IO) {
-					snprintf(str, len,"%s &R%u%s, R%u, %u, %s", f6_7_inst[LoadStore], Rx, bytenum[RxByteAddr], Rb, Imm, tempstr);
-				} else {
-					snprintf(str, len,"%s &R%u%s, R%u, R%u%s, %s", f6_7_inst[LoadStore], Rx, bytenum[RxByteAddr], Rb, Ro, sis[RoSel], tempstr);
-				}
-			} else {  // OP==4
-				if (IO) {
-					snprintf(str, len,"%s &R%u%s, C%u, %u, %s", f6_4_inst[LoadStore], Rx, bytenum[RxByteAddr], Rb, Imm, tempstr);
-				} else {
-					snprintf(str, len,"%s &R%u%s, C%u, R%u%s, %s", f6_4_inst[LoadStore], Rx, bytenum[RxByteAddr], Rb, Ro, sis[RoSel], tempstr);
-				}
+		case PRU_HALT:
+			out_s(&o, "HALT");
+			break;
+
+		case PRU_MVI:
+			da_mvi(&o, in);
+			break;
+
+		case PRU_XIN:
+		case PRU_XOUT:
+		case PRU_XCHG:
+			da_xio(&o, in);
+			break;
+
+		case PRU_LOOP:
+		case PRU_ILOOP:
+			out_mnemonic(&o, in->op);
+			out_c(&o, ' ');
+			out_u(&o, in->broff);
+			out_sep(&o);
+			if (in->io) {
+				out_s(&o, "0x");
+				out_x(&o, in->imm, 4);
+			} else {
+				out_reg(&o, in->rs2, in->rs2_sel);
+			}
+			break;
+
+		case PRU_SLP:
+			out_s(&o, "SLP ");
+			out_u(&o, in->imm);
+			break;
+
+		case PRU_QBGT ... PRU_QBXX:
+			out_mnemonic(&o, in->op);
+			out_c(&o, ' ');
+			out_d(&o, in->broff);
+			if (in->op == PRU_QBA)
+				break;
+			out_sep(&o);
+			out_reg(&o, in->rs1, in->rs1_sel);
+			out_sep(&o);
+			if (in->io)
+				out_u(&o, in->imm);
+			else
+				out_reg(&o, in->rs2, in->rs2_sel);
+			break;
+
+		case PRU_SBBO ... PRU_LBCO:
+			out_mnemonic(&o, in->op);
+			out_s(&o, " &R");
+			out_u(&o, in->rd);
+			out_s(&o, bytenum[in->byte]);
+			out_s(&o, in->op == PRU_SBBO || in->op == PRU_LBBO ? ", R" : ", C");
+			out_u(&o, in->rs1);
+			out_sep(&o);
+			if (in->io)
+				out_u(&o, in->imm);
+			else
+				out_reg(&o, in->rs2, in->rs2_sel);
+			out_sep(&o);
+			out_burst(&o, in->burst);
+			break;
+
+		default:
+			if (in->fmt == 2 && ((in->inst & 0x1E000000) >> 25) == 7) {
+				out_s(&o, "UNKNOWN-XI/XOUT: ");
+				out_altx(&o, in->inst);
+				out_c(&o, '\n');
+			} else if (in->fmt == 2) {
+				out_s(&o, "UNKNOWN-F2 ");
+				out_altx(&o, in->inst);
+				out_c(&o, ' ');
+				out_altx(&o, (in->inst & 0x1E000000) >> 25);
+			} else {
+				out_s(&o, "UNKNOWN ");
+				out_altx(&o, in->inst);
+			}
+			break;
+	}
+
+	n = o.p - buf;
+	if (n > len - 1)
+		n = len - 1;
+	memcpy(str, buf, n);
+	str[n] = 0;
+}
+
+void pru_decode(uint32_t inst, struct pru_insn *in)
+{
+	da_decode(inst, in);
+}
+
+void pru_format(char *str, unsigned int len, const struct pru_insn *in)
+{
+	da_format(str, len, in);
+}
+
+// mask of the registers touched by len bytes starting at byte of reg
+static uint32_t reg_range(unsigned int reg, unsigned int byte, unsigned int len)
+{
+	unsigned int		first = reg * 4 + byte;
+	unsigned int		last = first + len - 1;
+	uint32_t		mask = 0;
+
+	if (last > NUM_REGS * 4 - 1)
+		last = NUM_REGS * 4 - 1;
+	for (reg = first / 4; reg <= last / 4; reg++)
+		mask |= 1u << reg;
+	return mask;
+}
+
+// registers read and written by an instruction, as bit masks of R0..R31
+void pru_insn_regs(const struct pru_insn *in, uint32_t *read, uint32_t *write)
+{
+	uint32_t		r = 0, w = 0, xfer = 0;
+	unsigned int		len = pru_burst_len(in);
+
+	if (in->op <= PRU_SET || in->op == PRU_LMBD) {
+		w = 1u << in->rd;
+		r = 1u << in->rs1;
+	} else if (in->op == PRU_JAL || in->op == PRU_LDI || in->op == PRU_SCAN) {
+		w = 1u << in->rd;
+	}
+
+	switch (in->op) {
+		case PRU_ADD ... PRU_SET:
+		case PRU_JMP:
+		case PRU_JAL:
+		case PRU_LMBD:
+		case PRU_SCAN:
+		case PRU_LOOP:
+		case PRU_ILOOP:
+		case PRU_QBGT ... PRU_QBBS:
+			if (!in->io && in->op != PRU_QBA)
+				r |= 1u << in->rs2;
+			if (in->fmt == 4 || in->fmt == 5)
+				r |= in->op == PRU_QBA ? 0 : 1u << in->rs1;
+			break;
+
+		case PRU_MVI:
+			// register-indirect, could be anything
+			r = w = 0xFFFFFFFF;
+			break;
+
+		case PRU_SBBO ... PRU_LBCO:
+		case PRU_XIN ... PRU_XCHG:
+			// the burst length may come from R0.bn, in which case
+			// it could reach up to the end of the register file
+			if (len) {
+				xfer = reg_range(in->rd, in->byte, len);
+			} else {
+				xfer = reg_range(in->rd, in->byte, NUM_REGS * 4);
+				r |= 1;
 			}
+			if (in->op == PRU_SBBO || in->op == PRU_LBBO)
+				r |= 1u << in->rs1;
+			if (in->fmt == 6 && !in->io)
+				r |= 1u << in->rs2;
+			if (in->op == PRU_LBBO || in->op == PRU_LBCO || in->op == PRU_XIN)
+				w |= xfer;
+			else if (in->op == PRU_XCHG)
+				r |= xfer, w |= xfer;
+			else
+				r |= xfer;
 			break;
 
 		default:
-			snprintf(str, len,"UNKNOWN %#x", inst);
 			break;
 	}
+	*read = r;
+	*write = w;
+}
+
+// value of a register field, if all of its bytes are known
+int pru_regval_get(const struct pru_regval *t, unsigned int reg, unsigned int sel, uint32_t *v)
+{
+	unsigned int		shift = pru_sel_shift(sel), width = pru_sel_width(sel);
+	unsigned int		bytes = ((1u << (width / 8)) - 1) << (shift / 8);
+
+	if ((t->known[reg] & bytes) != bytes)
+		return 0;
+	*v = width == 32 ? t->val[reg] : (t->val[reg] >> shift) & ((1u << width) - 1);
+	return 1;
 }
 
+// an LDI sets the bytes it writes, anything else that writes a register
+// forgets all of it
+void pru_regval_update(struct pru_regval *t, const struct pru_insn *in)
+{
+	uint32_t		rd, wr, mask;
+	unsigned int		shift, width, r;
+
+	if (in->op == PRU_LDI) {
+		shift = pru_sel_shift(in->rd_sel);
+		width = pru_sel_width(in->rd_sel);
+		mask = width == 32 ? 0xFFFFFFFF : ((1u << width) - 1) << shift;
+		t->val[in->rd] = (t->val[in->rd] & ~mask) | ((in->imm << shift) & mask);
+		t->known[in->rd] |= width == 32 ? 0xF : ((1u << (width / 8)) - 1) << (shift / 8);
+		return;
+	}
+	pru_insn_regs(in, &rd, &wr);
+	for (r = 0; r < NUM_REGS; r++)
+		if (wr & (1u << r))
+			t->known[r] = 0;
+}
+
+// keep only the bytes both states agree on, where control flow merges
+void pru_regval_meet(struct pru_regval *t, const struct pru_regval *o)
+{
+	unsigned int		r, b;
+	uint32_t		diff;
+
+	for (r = 0; r < NUM_REGS; r++) {
+		diff = t->val[r] ^ o->val[r];
+		t->known[r] &= o->known[r];
+		for (b = 0; b < 4; b++)
+			if (diff & (0xFFu << (b * 8)))
+				t->known[r] &= ~(1u << b);
+	}
+}
+
+// data address of a load or store, if its base and offset are known; the
+// constant table is taken at its reset values
+int pru_mem_addr(const struct pru_insn *in, const struct pru_regval *t, uint32_t *addr)
+{
+	uint32_t		base, off = in->imm;
+
+	if (in->op == PRU_LBCO || in->op == PRU_SBCO)
+		base = pru_ct_reset[in->rs1];
+	else if (!pru_regval_get(t, in->rs1, PRU_SEL_FULL, &base))
+		return 0;
+	if (!in->io && !pru_regval_get(t, in->rs2, in->rs2_sel, &off))
+		return 0;
+	*addr = base + off;
+	return 1;
+}
+
+// disassemble the inst instruction and place string in str
+void disassemble(char *str, unsigned int len, unsigned int inst)
+{
+	struct pru_insn		in;
+
+	da_decode(inst, &in);
+	da_format(str, len, &in);
+}
@@ -0,0 +1,118 @@
+/*
+ *
+ *  PRU Debug Program - instruction decoder header file
+ *
+ *  pru_decode() splits an instruction word into a struct pru_insn once, so
+ *  the text formatter and any analysis of the instruction stream work from
+ *  the same fields instead of re-parsing bits or disassembly text.
+ *
+ */
+
+#ifndef DA_H
+#define DA_H
+#include <stdint.h>
+
+// every operation with its mnemonic, in encoding order within each format
+#define PRU_OPS(X) \
+	X(PRU_ADD, "ADD") X(PRU_ADC, "ADC") X(PRU_SUB, "SUB") X(PRU_SUC, "SUC") \
+	X(PRU_LSL, "LSL") X(PRU_LSR, "LSR") X(PRU_RSB, "RSB") X(PRU_RSC, "RSC") \
+	X(PRU_AND, "AND") X(PRU_OR, "OR") X(PRU_XOR, "XOR") X(PRU_NOT, "NOT") \
+	X(PRU_MIN, "MIN") X(PRU_MAX, "MAX") X(PRU_CLR, "CLR") X(PRU_SET, "SET") \
+	X(PRU_JMP, "JMP") X(PRU_JAL, "JAL") X(PRU_LDI, "LDI") X(PRU_LMBD, "LMBD") \
+	X(PRU_SCAN, "SCAN") X(PRU_HALT, "HALT") X(PRU_MVI, "MVI") \
+	X(PRU_XIN, "XIN") X(PRU_XOUT, "XOUT") X(PRU_XCHG, "XCHG") \
+	X(PRU_LOOP, "LOOP") X(PRU_ILOOP, "ILOOP") X(PRU_SLP, "SLP") \
+	X(PRU_QBGT, "QBGT") X(PRU_QBGE, "QBGE") X(PRU_QBLT, "QBLT") \
+	X(PRU_QBLE, "QBLE") X(PRU_QBEQ, "QBEQ") X(PRU_QBNE, "QBNE") \
+	X(PRU_QBA, "QBA") X(PRU_QBBC, "QBBC") X(PRU_QBBS, "QBBS") \
+	X(PRU_QBXX, "QBxx") /* reserved test encoding */ \
+	X(PRU_SBBO, "SBBO") X(PRU_LBBO, "LBBO") X(PRU_SBCO, "SBCO") X(PRU_LBCO, "LBCO") \
+	X(PRU_INVALID, "UNKNOWN")
+
+#define PRU_OP_ENUM(op, name)	op,
+enum pru_op {
+	PRU_OPS(PRU_OP_ENUM)
+	PRU_NUM_OPS
+};
+#undef PRU_OP_ENUM
+
+// pru_insn.flags
+#define PRU_INSN_BRANCH		0x01	// may change the flow: JMP, JAL, QBxx
+#define PRU_INSN_COND		0x02	// conditional branch
+#define PRU_INSN_CALL		0x04	// JAL
+#define PRU_INSN_INDIRECT	0x08	// target is in a register
+#define PRU_INSN_LOAD		0x10	// LBBO/LBCO
+#define PRU_INSN_STORE		0x20	// SBBO/SBCO
+#define PRU_INSN_HALT		0x40
+#define PRU_INSN_INVALID	0x80	// reserved or unsupported encoding
+
+// field selectors (rd_sel, rs1_sel, rs2_sel)
+#define PRU_SEL_B0		0
+#define PRU_SEL_W0		4
+#define PRU_SEL_FULL		7
+
+// burst values above this take the length from R0.b0..R0.b3
+#define PRU_BURST_R0		124
+
+struct pru_insn {
+	uint32_t		inst;		// raw encoding
+	uint8_t			op;		// enum pru_op
+	uint8_t			fmt;		// 1, 2, 4, 5, 6 or 0 if unknown
+	uint8_t			flags;		// PRU_INSN_*
+	uint8_t			io;		// last operand is imm, not rs2
+	uint8_t			rd, rd_sel;	// destination, &Rx of format 6 and XIN/XOUT
+	uint8_t			rs1, rs1_sel;	// source 1, base Rb/Cb of format 6
+	uint8_t			rs2, rs2_sel;	// source 2, offset Ro of format 6
+	uint8_t			byte;		// start byte of &Rx (format 6, XIN/XOUT)
+	uint8_t			burst;		// encoded burst length, see pru_burst_len()
+	uint16_t		imm;		// immediate, XIN/XOUT device id, MVI error
+	int16_t			broff;		// QBxx branch or LOOP end offset
+};
+
+// register bytes known to hold a constant, from LDIs seen on the way
+struct pru_regval {
+	uint32_t		val[32];
+	uint8_t			known[32];	// mask of known bytes
+};
+
+extern const char pru_op_name[PRU_NUM_OPS][8];
+extern const uint32_t pru_ct_reset[32];
+
+void pru_decode(uint32_t inst, struct pru_insn *in);
+void pru_format(char *str, unsigned int len, const struct pru_insn *in);
+void pru_insn_regs(const struct pru_insn *in, uint32_t *read, uint32_t *write);
+int pru_regval_get(const struct pru_regval *t, unsigned int reg, unsigned int sel, uint32_t *v);
+void pru_regval_update(struct pru_regval *t, const struct pru_insn *in);
+void pru_regval_meet(struct pru_regval *t, const struct pru_regval *o);
+int pru_mem_addr(const struct pru_insn *in, const struct pru_regval *t, uint32_t *addr);
+
+// bytes moved by a burst, 0 if taken from R0 at run time
+static inline unsigned int pru_burst_len(const struct pru_insn *in)
+{
+	return in->burst < PRU_BURST_R0 ? in->burst + 1 : 0;
+}
+
+// width in bits and bit position of a register field selector
+static inline unsigned int pru_sel_width(unsigned int sel)
+{
+	return sel < 4 ? 8 : sel < 7 ? 16 : 32;
+}
+
+static inline unsigned int pru_sel_shift(unsigned int sel)
+{
+	return sel < 4 ? sel * 8 : sel < 7 ? (sel - 4) * 8 : 0;
+}
+
+// static branch target for an instruction at pc, -1 if there is none
+static inline int pru_insn_target(const struct pru_insn *in, unsigned int pc)
+{
+	if (in->op == PRU_LOOP || in->op == PRU_ILOOP)
+		return (pc + in->broff) & 0xFFFF;
+	if (!(in->flags & PRU_INSN_BRANCH) || (in->flags & PRU_INSN_INDIRECT))
+		return -1;
+	if (in->op == PRU_JMP || in->op == PRU_JAL)
+		return in->imm;
+	return (pc + in->broff) & 0xFFFF;
+}
+
+#endif // DA_H
@@ -0,0 +1,226 @@
+/*
+ *
+ *  PRU Debug Program - host-side IRAM shadow
+ *
+ *  Instruction RAM is read once per PRU with a bulk copy and kept in a host
+ *  buffer, so DIS, the stepping loops and the trace sampler don't have to
+ *  go over the interconnect for every instruction they look at.  Writes
+ *  made through the debugger (L, WR/WRI) are mirrored into the shadow.
+ *  HALTs patched in for hardware breakpoints only go to the device; the
+ *  shadow keeps the original instruction and a bitmap records the patch.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "prudbg.h"
+#include "backend.h"
+
+#define IRAM_MAP_WORDS		(IRAM_MAX_LEN / 32)
+
+struct iram_shadow {
+	unsigned char		valid;
+	uint32_t		inst[IRAM_MAX_LEN];
+	uint32_t		patched[IRAM_MAP_WORDS];	// HALT inserted on the device
+};
+
+static struct iram_shadow	iram[MAX_NUM_OF_PRUS];
+
+// word offset in the PRUSS of instruction addr of PRU p
+static inline unsigned int iram_dev(unsigned int p, unsigned int addr)
+{
+	return pru_inst_base[p] + addr;
+}
+
+static inline int is_patched(const struct iram_shadow *s, unsigned int addr)
+{
+	return (s->patched[addr / 32] >> (addr % 32)) & 1;
+}
+
+// bulk read of the whole IRAM of PRU p, dropping any patch records
+void iram_sync(unsigned int p)
+{
+	struct iram_shadow	*s = &iram[p];
+
+	pru_read_block(iram_dev(p, 0) * 4, s->inst, pru_iram_len * 4);
+	memset(s->patched, 0, sizeof(s->patched));
+	s->valid = 1;
+}
+
+static inline struct iram_shadow *iram_get(unsigned int p)
+{
+	if (!iram[p].valid)
+		iram_sync(p);
+	return &iram[p];
+}
+
+// instruction at addr of the active PRU, as loaded (never a patched HALT)
+uint32_t iram_read(unsigned int addr)
+{
+	if (addr >= pru_iram_len)
+		return pru_read(iram_dev(pru_num, addr));
+	return iram_get(pru_num)->inst[addr];
+}
+
+// copy len instructions starting at addr into buf, returns the count copied
+unsigned int iram_read_block(unsigned int addr, uint32_t *buf, unsigned int len)
+{
+	struct iram_shadow	*s = iram_get(pru_num);
+
+	if (addr >= pru_iram_len)
+		return 0;
+	if (len > pru_iram_len - addr)
+		len = pru_iram_len - addr;
+	memcpy(buf, &s->inst[addr], len * sizeof(uint32_t));
+	return len;
+}
+
+// true if the PRU will stop at addr: a HALT in the program or a breakpoint
+int iram_is_halt(unsigned int addr)
+{
+	struct iram_shadow	*s;
+
+	if (addr >= pru_iram_len)
+		return pru_read(iram_dev(pru_num, addr)) == INST_HALT;
+	s = iram_get(pru_num);
+	return s->inst[addr] == INST_HALT || is_patched(s, addr);
+}
+
+// write len instructions to the active PRU's IRAM and its shadow; words
+// past the end of IRAM are dropped
+void iram_write(unsigned int addr, const uint32_t *inst, unsigned int len)
+{
+	struct iram_shadow	*s = iram_get(pru_num);
+	unsigned int		i;
+
+	if (addr >= pru_iram_len)
+		return;
+	if (len > pru_iram_len - addr)
+		len = pru_iram_len - addr;
+	for (i = 0; i < len; i++) {
+		s->inst[addr + i] = inst[i];
+		s->patched[(addr + i) / 32] &= ~(1u << ((addr + i) % 32));
+	}
+	pru_write_block(iram_dev(pru_num, addr) * 4, inst, len * 4);
+}
+
+// The device was written behind the shadow's back (byte writes from WR/WRI).
+// addr and len are byte offsets into the whole PRU mapping; every PRU whose
+// IRAM overlaps the range re-reads the affected words.
+void iram_written(unsigned int addr, unsigned int len)
+{
+	unsigned int		p, first, last, i;
+	unsigned int		start, end;
+
+	if (len == 0)
+		return;
+	for (p = 0; p < MAX_NUM_OF_PRUS; p++) {
+		if (!iram[p].valid)
+			continue;
+		start = pru_inst_base[p] * 4;
+		end = start + pru_iram_len * 4;
+		if (addr >= end || addr + len <= start)
+			continue;
+		first = (addr > start ? addr - start : 0) / 4;
+		last = (addr + len - start - 1) / 4;
+		if (last >= pru_iram_len)
+			last = pru_iram_len - 1;
+		for (i = first; i <= last; i++) {
+			iram[p].inst[i] = pru_read(iram_dev(p, i));
+			iram[p].patched[i / 32] &= ~(1u << (i % 32));
+		}
+	}
+}
+
+// put inst (normally INST_HALT) on the device at addr, returns the
+// instruction it replaced
+uint32_t iram_patch(unsigned int addr, uint32_t inst)
+{
+	struct iram_shadow	*s = iram_get(pru_num);
+
+	if (addr >= pru_iram_len) {
+		uint32_t old = pru_read(iram_dev(pru_num, addr));
+		pru_write(iram_dev(pru_num, addr), inst);
+		return old;
+	}
+	pru_write(iram_dev(pru_num, addr), inst);
+	s->patched[addr / 32] |= 1u << (addr % 32);
+	return s->inst[addr];
+}
+
+// restore the original instruction under a patch
+void iram_unpatch(unsigned int addr)
+{
+	struct iram_shadow	*s = iram_get(pru_num);
+
+	if (addr >= pru_iram_len || !is_patched(s, addr))
+		return;
+	pru_write(iram_dev(pru_num, addr), s->inst[addr]);
+	s->patched[addr / 32] &= ~(1u << (addr % 32));
+}
+
+// Fletcher-32 over the instruction words
+static uint32_t iram_checksum(const uint32_t *inst, unsigned int len)
+{
+	uint32_t		a = 0xFFFF, b = 0xFFFF;
+	unsigned int		i;
+
+	for (i = 0; i < len; i++) {
+		a = (a + (inst[i] & 0xFFFF)) % 0xFFFF;
+		b = (b + a) % 0xFFFF;
+		a = (a + (inst[i] >> 16)) % 0xFFFF;
+		b = (b + a) % 0xFFFF;
+	}
+	return (b << 16) | a;
+}
+
+// Compare the device against the shadow, taking breakpoint patches into
+// account, and report words changed from outside the debugger.  The shadow
+// is refreshed from the device.  Returns the number of differing words.
+unsigned int iram_check(unsigned int p)
+{
+	struct iram_shadow	*s = iram_get(p);
+	uint32_t		dev[IRAM_MAX_LEN];
+	unsigned int		i, n = 0;
+	uint32_t		v;
+
+	pru_read_block(iram_dev(p, 0) * 4, dev, pru_iram_len * 4);
+	for (i = 0; i < pru_iram_len; i++) {
+		v = dev[i];
+		if (is_patched(s, i) || v == s->inst[i])
+			continue;
+		if (n < 16)
+			printf("  [0x%04x] shadow 0x%08x device 0x%08x\n", i, s->inst[i], v);
+		s->inst[i] = v;
+		n++;
+	}
+	if (n > 16)
+		printf("  ... %u more\n", n - 16);
+	return n;
+}
+
+void cmd_iram(const char *op)
+{
+	struct iram_shadow	*s;
+	unsigned int		i, npatched = 0, n;
+
+	if (op == NULL) {
+		s = iram_get(pru_num);
+		for (i = 0; i < IRAM_MAP_WORDS; i++)
+			npatched += __builtin_popcount(s->patched[i]);
+		printf("PRU%u IRAM shadow: %u words, checksum 0x%08x, %u breakpoint patches\n\n",
+		       pru_num, pru_iram_len, iram_checksum(s->inst, pru_iram_len), npatched);
+	} else if (!strcasecmp(op, "SYNC")) {
+		iram_sync(pru_num);
+		printf("PRU%u IRAM shadow reloaded from the device.\n\n", pru_num);
+	} else if (!strcasecmp(op, "CHECK")) {
+		n = iram_check(pru_num);
+		if (n)
+			printf("PRU%u IRAM: %u words modified outside the debugger, shadow updated.\n\n", pru_num, n);
+		else
+			printf("PRU%u IRAM matches the shadow.\n\n", pru_num);
+	} else {
+		printf("ERROR: invalid argument\n");
+	}
+}
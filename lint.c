@@ -0,0 +1,465 @@
+/*
+ *
+ *  PRU Debug Program - firmware performance lint
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "prudbg.h"
+#include "da.h"
+#include "cfg.h"
+#include "lint.h"
+
+#define LINT_MAX_CHAIN		16		// jumps followed before giving up
+#define LINT_NO_LDI		0xFFFFFFFF
+
+// lint.inloop
+#define LOOP_COUNTED		0x01	// in a LOOP with an immediate count
+#define LOOP_OPEN		0x02	// in a loop of unknown trip count
+
+struct lint_finding {
+	uint32_t		addr;
+	uint64_t		cycles;		// estimated, for one pass or one iteration
+	int			per_iter;	// inside a loop of unknown trip count
+	char			msg[120];
+};
+
+struct lint {
+	const struct cfg	*g;
+	struct pru_regval	*entry;		// registers on entry to each block
+	unsigned char		*seen;		// entry[] holds something
+	unsigned char		*inloop;	// LOOP_*
+	uint64_t		*trips;		// product of the LOOP counts around a block
+	struct lint_finding	*found;
+	uint32_t		nfound, cap;
+};
+
+static int add_finding(struct lint *l, uint32_t b, uint32_t addr, uint64_t cycles, const char *fmt, ...)
+	__attribute__((format(printf, 5, 6)));
+
+static int add_finding(struct lint *l, uint32_t b, uint32_t addr, uint64_t cycles, const char *fmt, ...)
+{
+	struct lint_finding	*p;
+	va_list			ap;
+
+	if (l->nfound == l->cap) {
+		p = realloc(l->found, (l->cap * 2 + 16) * sizeof(*p));
+		if (!p)
+			return -1;
+		l->found = p;
+		l->cap = l->cap * 2 + 16;
+	}
+	p = &l->found[l->nfound++];
+	p->addr = addr;
+	p->cycles = cycles * l->trips[b];
+	p->per_iter = !!(l->inloop[b] & LOOP_OPEN);
+	va_start(ap, fmt);
+	vsnprintf(p->msg, sizeof(p->msg), fmt, ap);
+	va_end(ap);
+	return 0;
+}
+
+static int cmp_finding(const void *a, const void *b)
+{
+	const struct lint_finding *x = a, *y = b;
+
+	if (x->addr != y->addr)
+		return x->addr < y->addr ? -1 : 1;
+	return strcmp(x->msg, y->msg);
+}
+
+// cycles of one burst of len bytes at addr (local if unknown)
+static uint32_t access_cycles(const struct pru_insn *in, int known, uint32_t addr, uint32_t len)
+{
+	uint32_t		c = LINT_LOCAL_CYCLES;
+
+	if (known && addr >= LINT_EXT_BASE)
+		c = in->flags & PRU_INSN_LOAD ? LINT_EXT_LOAD_CYCLES : LINT_EXT_STORE_CYCLES;
+	return c + (len + 3) / 4;
+}
+
+// loops
+
+// Mark the blocks of LOOP bodies, with their trip counts, and the natural
+// loop of every back edge found by a depth-first walk from each function.
+// LOOP edges are left out of the walk, the bodies above already cover them.
+static int find_loops(struct lint *l)
+{
+	const struct cfg	*g = l->g;
+	const struct cfg_edge	*e;
+	uint32_t		*pred_of, *pred, *fill, *stack, *epos, *list;
+	unsigned char		*state, *body;
+	uint32_t		i, f, b, u, k, sp, n, nb = g->nblocks;
+	int			r = -1;
+
+	for (b = 0; b < nb; b++)
+		l->trips[b] = 1;
+	for (i = 0; i < g->nloops; i++) {
+		for (b = cfg_block_at(g, g->loops[i].start); b != CFG_NONE && b < nb &&
+		     g->blocks[b].start < g->loops[i].end; b++) {
+			if (g->loops[i].count) {
+				l->inloop[b] |= LOOP_COUNTED;
+				l->trips[b] *= g->loops[i].count;
+			} else {
+				l->inloop[b] |= LOOP_OPEN;
+			}
+		}
+	}
+
+	pred_of = calloc(nb + 2, sizeof(uint32_t));
+	pred = calloc(g->nedges + 1, sizeof(uint32_t));
+	fill = calloc(nb + 1, sizeof(uint32_t));
+	stack = calloc(nb + 1, sizeof(uint32_t));
+	epos = calloc(nb + 1, sizeof(uint32_t));
+	list = calloc(nb + 1, sizeof(uint32_t));
+	state = calloc(nb + 1, 1);
+	body = calloc(nb + 1, 1);
+	if (!pred_of || !pred || !fill || !stack || !epos || !list || !state || !body)
+		goto cleanup;
+
+	for (i = 0; i < g->nedges; i++)
+		if (g->edges[i].to != CFG_NONE && g->edges[i].kind != CFG_EDGE_LOOP)
+			pred_of[g->edges[i].to + 1]++;
+	for (b = 0; b < nb; b++) {
+		pred_of[b + 1] += pred_of[b];
+		fill[b] = pred_of[b];
+	}
+	for (i = 0; i < g->nedges; i++)
+		if (g->edges[i].to != CFG_NONE && g->edges[i].kind != CFG_EDGE_LOOP)
+			pred[fill[g->edges[i].to]++] = g->edges[i].from;
+
+	// state: 0 not visited, 1 on the walk's stack, 2 finished
+	for (f = 0; f < g->nfuncs; f++) {
+		b = g->funcs[f].block;
+		if (state[b])
+			continue;
+		state[b] = 1;
+		epos[b] = 0;
+		stack[0] = b;
+		sp = 1;
+		while (sp) {
+			b = stack[sp - 1];
+			if (epos[b] == g->blocks[b].nedges) {
+				state[b] = 2;
+				sp--;
+				continue;
+			}
+			e = &g->edges[g->blocks[b].edge + epos[b]++];
+			if (e->to == CFG_NONE || e->kind == CFG_EDGE_LOOP)
+				continue;
+			if (!state[e->to]) {
+				state[e->to] = 1;
+				epos[e->to] = 0;
+				stack[sp++] = e->to;
+				continue;
+			}
+			if (state[e->to] != 1)
+				continue;
+
+			// back edge b -> e->to: walk up from b to the header
+			memset(body, 0, nb);
+			body[e->to] = 1;
+			l->inloop[e->to] |= LOOP_OPEN;
+			n = 0;
+			if (!body[b]) {
+				body[b] = 1;
+				list[n++] = b;
+			}
+			for (k = 0; k < n; k++) {
+				l->inloop[list[k]] |= LOOP_OPEN;
+				for (i = pred_of[list[k]]; i < pred_of[list[k] + 1]; i++) {
+					u = pred[i];
+					if (!body[u]) {
+						body[u] = 1;
+						list[n++] = u;
+					}
+				}
+			}
+		}
+	}
+	r = 0;
+
+cleanup:
+	free(pred_of);
+	free(pred);
+	free(fill);
+	free(stack);
+	free(epos);
+	free(list);
+	free(state);
+	free(body);
+	return r;
+}
+
+// registers known on entry to each block: what every predecessor agrees
+// on, nothing at function entries and after a call
+static void find_constants(struct lint *l)
+{
+	const struct cfg	*g = l->g;
+	const struct cfg_block	*blk;
+	const struct cfg_edge	*e;
+	struct pru_regval	t, old;
+	struct pru_insn		in;
+	uint32_t		b, k, pc;
+	int			changed = 1;
+
+	for (k = 0; k < g->nfuncs; k++)
+		l->seen[g->funcs[k].block] = 1;
+	while (changed) {
+		changed = 0;
+		for (b = 0; b < g->nblocks; b++) {
+			if (!l->seen[b])
+				continue;
+			blk = &g->blocks[b];
+			t = l->entry[b];
+			for (pc = blk->start; pc < blk->start + blk->len; pc++) {
+				pru_decode(g->image[pc - g->base], &in);
+				pru_regval_update(&t, &in);
+			}
+			for (k = 0, e = &g->edges[blk->edge]; k < blk->nedges; k++, e++) {
+				if (e->to == CFG_NONE || (g->blocks[e->to].flags & CFG_BLOCK_ENTRY))
+					continue;
+				if (e->kind == CFG_EDGE_RET)
+					memset(&t, 0, sizeof(t));
+				if (!l->seen[e->to]) {
+					l->entry[e->to] = t;
+					l->seen[e->to] = 1;
+					changed = 1;
+					continue;
+				}
+				old = l->entry[e->to];
+				pru_regval_meet(&l->entry[e->to], &t);
+				if (memcmp(&old.known, &l->entry[e->to].known, sizeof(old.known)))
+					changed = 1;
+			}
+		}
+	}
+}
+
+// the per-block checks
+
+// neighbouring accesses with the same base, collected while scanning
+struct burst_run {
+	uint32_t		first, n;	// address of the first, accesses in the run
+	struct pru_insn		head, last;
+	uint32_t		bytes;		// total length
+	uint32_t		overhead;	// cycles of all accesses beyond moving the data
+	uint32_t		touched, written; // registers used since the last access
+	int			regs_ok;	// registers are contiguous, too
+};
+
+static int burst_flush(struct lint *l, uint32_t b, struct burst_run *run)
+{
+	int			r = 0;
+
+	// one access keeps its overhead, the others' is saved
+	if (run->n >= 2) {
+		r = add_finding(l, b, run->first, run->overhead - run->overhead / run->n,
+				"burst: %u %s accesses of %u bytes in total could be one burst%s",
+				run->n, pru_op_name[run->head.op], run->bytes,
+				run->regs_ok ? "" : " after moving the registers together");
+	}
+	run->n = 0;
+	return r;
+}
+
+// does access in continue the run at the next byte of memory?
+static int burst_continues(const struct burst_run *run, const struct pru_insn *in, uint32_t xfer)
+{
+	const struct pru_insn	*p = &run->last;
+	uint32_t		len = pru_burst_len(in), plen = pru_burst_len(p);
+
+	return run->n && in->op == p->op && in->rs1 == p->rs1 && in->io && p->io &&
+	       len && plen && in->imm == p->imm + plen &&
+	       run->bytes + len <= PRU_BURST_R0 &&
+	       !((in->op == PRU_LBBO || in->op == PRU_SBBO) && (run->written & (1u << in->rs1))) &&
+	       !(run->touched & xfer);
+}
+
+static void burst_add(struct burst_run *run, uint32_t pc, const struct pru_insn *in, uint32_t cycles)
+{
+	const struct pru_insn	*p = &run->last;
+
+	if (!run->n) {
+		run->first = pc;
+		run->head = *in;
+		run->bytes = 0;
+		run->overhead = 0;
+		run->regs_ok = 1;
+	} else if (in->rd * 4 + in->byte != p->rd * 4 + p->byte + pru_burst_len(p)) {
+		run->regs_ok = 0;
+	}
+	run->last = *in;
+	run->bytes += pru_burst_len(in);
+	run->overhead += cycles - (pru_burst_len(in) + 3) / 4;
+	run->touched = run->written = 0;
+	run->n++;
+}
+
+// follow branches to QBA/JMP, returns the hops and the final target
+static uint32_t jump_chain(const struct cfg *g, uint32_t target, uint32_t *final)
+{
+	struct pru_insn		in;
+	uint32_t		hops = 0;
+	int			t;
+
+	while (hops < LINT_MAX_CHAIN && target - g->base < g->len) {
+		pru_decode(g->image[target - g->base], &in);
+		if (in.op != PRU_QBA && !(in.op == PRU_JMP && in.io))
+			break;
+		t = pru_insn_target(&in, target);
+		if ((uint32_t)t == target)
+			break;
+		target = t;
+		hops++;
+	}
+	*final = target;
+	return hops;
+}
+
+static int lint_block(struct lint *l, uint32_t b)
+{
+	const struct cfg	*g = l->g;
+	const struct cfg_block	*blk = &g->blocks[b];
+	struct pru_regval	t = l->entry[b];
+	struct burst_run	run = {0};
+	struct pru_insn		in, prev;
+	uint32_t		ldi_at[NUM_REGS][4];	// pending LDI of each byte
+	uint32_t		pc, rd, wr, xfer, addr, len, mask, hops, final, v, r, k, p;
+	int			known, t_ok;
+
+	memset(ldi_at, 0xFF, sizeof(ldi_at));
+	for (pc = blk->start; pc < blk->start + blk->len; pc++) {
+		pru_decode(g->image[pc - g->base], &in);
+		pru_insn_regs(&in, &rd, &wr);
+
+		if (in.flags & (PRU_INSN_LOAD | PRU_INSN_STORE)) {
+			len = pru_burst_len(&in);
+			known = pru_mem_addr(&in, &t, &addr);
+			if (known && addr >= LINT_EXT_BASE && l->inloop[b] &&
+			    add_finding(l, b, pc, access_cycles(&in, known, addr, len),
+					"ext-in-loop: %s %s %u bytes at 0x%08x inside a loop",
+					pru_op_name[in.op], in.flags & PRU_INSN_LOAD ? "reads" : "writes",
+					len, addr))
+				return -1;
+			xfer = in.flags & PRU_INSN_LOAD ? wr : rd & ~(1u << in.rs1);
+			if (!burst_continues(&run, &in, xfer) && burst_flush(l, b, &run))
+				return -1;
+			if (len)
+				burst_add(&run, pc, &in, access_cycles(&in, known, addr, len));
+		} else {
+			run.touched |= rd | wr;
+			run.written |= wr;
+		}
+
+		if (in.op == PRU_LDI) {
+			mask = pru_sel_width(in.rd_sel) == 32 ? 0xF :
+			       ((1u << (pru_sel_width(in.rd_sel) / 8)) - 1) << (pru_sel_shift(in.rd_sel) / 8);
+			t_ok = pru_regval_get(&t, in.rd, in.rd_sel, &v);
+			if (t_ok && v == in.imm) {
+				if (add_finding(l, b, pc, 1, "ldi: r%u already holds 0x%x", in.rd, in.imm))
+					return -1;
+				mask = 0;
+			} else {
+				// an earlier LDI whose bytes are all overwritten unread is dead
+				for (k = 0; k < 4; k++) {
+					p = ldi_at[in.rd][k];
+					if (p == LINT_NO_LDI || !(mask & (1u << k)))
+						continue;
+					for (r = 0; r < 4; r++)
+						if (ldi_at[in.rd][r] == p && !(mask & (1u << r)))
+							break;
+					if (r == 4) {
+						if (add_finding(l, b, p, 1, "ldi: value is overwritten at 0x%04x before it is used", pc))
+							return -1;
+						for (r = 0; r < 4; r++)
+							if (ldi_at[in.rd][r] == p)
+								ldi_at[in.rd][r] = LINT_NO_LDI;
+					}
+				}
+				// LDI r.w0 and LDI r.w2, 0 in either order: one LDI r does both
+				if (mask == 0x3 || mask == 0xC) {
+					p = ldi_at[in.rd][mask == 0x3 ? 2 : 0];
+					if (p != LINT_NO_LDI && p == ldi_at[in.rd][mask == 0x3 ? 3 : 1]) {
+						pru_decode(g->image[p - g->base], &prev);
+						if ((prev.rd_sel == PRU_SEL_W0 + 2 && mask == 0x3 && prev.imm == 0) ||
+						    (prev.rd_sel == PRU_SEL_W0 && mask == 0xC && in.imm == 0)) {
+							if (add_finding(l, b, p, 1, "ldi: 16-bit constant loaded in halves with 0x%04x, one LDI r%u will do",
+									pc, in.rd))
+								return -1;
+						}
+					}
+				}
+			}
+			for (k = 0; k < 4; k++)
+				if (mask & (1u << k))
+					ldi_at[in.rd][k] = pc;
+		} else {
+			for (r = 0; r < NUM_REGS; r++)
+				if ((rd | wr) & (1u << r))
+					memset(ldi_at[r], 0xFF, sizeof(ldi_at[r]));
+		}
+
+		if (in.op == PRU_QBA && in.broff == 1) {
+			if (add_finding(l, b, pc, 1, "jump-chain: QBA to the next instruction"))
+				return -1;
+		} else if ((in.flags & PRU_INSN_BRANCH) && pru_insn_target(&in, pc) >= 0 &&
+			   (hops = jump_chain(g, pru_insn_target(&in, pc), &final))) {
+			if (add_finding(l, b, pc, hops, "jump-chain: %s reaches 0x%04x through %u jump%s",
+					pru_op_name[in.op], final, hops, hops == 1 ? "" : "s"))
+				return -1;
+		}
+
+		pru_regval_update(&t, &in);
+	}
+	return burst_flush(l, b, &run);
+}
+
+int lint_report(FILE *f, const struct cfg *g)
+{
+	struct lint		l = {0};
+	uint64_t		total = 0;
+	uint32_t		b, i;
+	int			r = -1;
+
+	l.g = g;
+	l.entry = calloc(g->nblocks + 1, sizeof(*l.entry));
+	l.seen = calloc(g->nblocks + 1, 1);
+	l.inloop = calloc(g->nblocks + 1, 1);
+	l.trips = calloc(g->nblocks + 1, sizeof(*l.trips));
+	if (!l.entry || !l.seen || !l.inloop || !l.trips || find_loops(&l))
+		goto fail;
+	find_constants(&l);
+	for (b = 0; b < g->nblocks; b++)
+		if (lint_block(&l, b))
+			goto fail;
+
+	qsort(l.found, l.nfound, sizeof(*l.found), cmp_finding);
+	for (i = 0; i < l.nfound; i++) {
+		fprintf(f, "0x%04x: %s (~%llu cycle%s%s)\n", l.found[i].addr, l.found[i].msg,
+			(unsigned long long)l.found[i].cycles, l.found[i].cycles == 1 ? "" : "s",
+			l.found[i].per_iter ? " per iteration" : "");
+		total += l.found[i].cycles;
+	}
+	if (l.nfound)
+		fprintf(f, "%u finding%s, ~%llu cycle%s\n", l.nfound, l.nfound == 1 ? "" : "s",
+			(unsigned long long)total, total == 1 ? "" : "s");
+	else
+		fprintf(f, "No findings.\n");
+	r = l.nfound;
+	goto cleanup;
+
+fail:
+	fprintf(stderr, "lint: couldn't allocate memory\n");
+cleanup:
+	free(l.entry);
+	free(l.seen);
+	free(l.inloop);
+	free(l.trips);
+	free(l.found);
+	return r;
+}
@@ -0,0 +1,35 @@
+/*
+ *
+ *  PRU Debug Program - firmware performance lint header file
+ *
+ *  lint_report() walks a struct cfg and flags code patterns that are known
+ *  to waste cycles on the PRU, each with an estimate of the cycles lost:
+ *	ext-in-loop	LBBO/SBBO/LBCO/SBCO outside the PRUSS inside a loop
+ *	burst		neighbouring accesses that one wider burst could do
+ *	ldi		LDIs that are dead, already hold the value, or split
+ *			a 16-bit constant into two halves
+ *	jump-chain	branches to a QBA/JMP, or a QBA to the next instruction
+ *  Addresses are found by following LDIs through the graph; the constant
+ *  table is taken at its reset values.  The estimates use the fixed costs
+ *  below, they are meant to rank findings, not to replace measurements.
+ *
+ */
+
+#ifndef LINT_H
+#define LINT_H
+#include <stdio.h>
+#include <stdint.h>
+
+#include "cfg.h"
+
+// data addresses at and above this go out through the OCP master
+#define LINT_EXT_BASE		0x00080000
+
+// cycles of one access, on top of one cycle per 4 bytes moved
+#define LINT_LOCAL_CYCLES	1
+#define LINT_EXT_LOAD_CYCLES	40	// read round trip to L3/DDR
+#define LINT_EXT_STORE_CYCLES	4	// posted write
+
+int lint_report(FILE *f, const struct cfg *g);
+
+#endif // LINT_H
@@ -25,7 +25,20 @@ void printhelp()
 			"display the next\n");
 	printf("      block\n\n");
 
-	printf("BR [breakpoint_number [address [s]]]\n");
+	printf("BA [CLEAR] [address ...]\n");
+	printf("    Set, or with CLEAR remove, software breakpoints that have "
+			"no number; any\n");
+	printf("    number of them can be set.  Without addresses, BA lists "
+			"them and BA CLEAR\n");
+	printf("    removes all.  GSS single-steps while any is set\n\n");
+
+	printf("BENCH [length]\n");
+	printf("    Time reading <length> bytes (default 64 KB) of the PRU's "
+			"data RAM byte by\n");
+	printf("    byte, word by word and with the burst reads used by the "
+			"dumps\n\n");
+
+	printf("BR [breakpoint_number [address [s] [IF condition]]]\n");
 	printf("    View or set an instruction breakpoint\n");
 	printf("     - 'b' by itself will display current breakpoints\n");
 	printf("     - breakpoint_number is the breakpoint reference and ranges"
@@ -35,7 +48,31 @@ void printhelp()
 	printf("       at (instruction is not executed)\n");
 	printf("     - \"s\" forces it to be a software breakpoint that requires single-stepping and may break real-time performance\n");
 	printf("     - if no address is provided, then the breakpoint is "
-			"cleared\n\n");
+			"cleared\n");
+	printf("     - with IF, GSS only stops when the condition is true, "
+			"e.g.\n");
+	printf("         br 0 0x1a4 if R5.w0 > 100 && HITS >= 3000\n");
+	printf("       Operands: numbers, R0..R31 with .b0-.b3/.w0-.w2, "
+			"CYCLE, STALL, HITS (times\n");
+	printf("       the address was reached) and [address], the data "
+			"memory word at a WA\n");
+	printf("       address; operators as in C: || && | ^ & == != < <= > >= "
+			"<< >> + - * / %% ! ~\n");
+	printf("       A conditional hw breakpoint still runs at full speed, "
+			"halting briefly at\n");
+	printf("       the address to evaluate the condition\n\n");
+
+	printf("CFG [dot | json] [filename]\n");
+	printf("    Print the basic blocks, branches, loops and calls of "
+			"instruction memory\n");
+	printf("    as a Graphviz DOT graph (default) or JSON, to stdout or "
+			"<filename>\n\n");
+
+	printf("COPY <src> <dst> <length>\n");
+	printf("    Copy <length> bytes within data and shared RAM.  Addresses "
+			"are as the PRU\n");
+	printf("    sees them: 0x00000 its data RAM, 0x02000 the other PRU's, "
+			"0x10000 shared RAM\n\n");
 
 	printf("CYCLE [clear | off | on ]\n");
 	printf("    Display, clear, disable, or enable the cycle count "
@@ -60,6 +97,12 @@ void printhelp()
 			"beginning of PRU\n");
 	printf("    instruction memory)\n\n");
 
+	printf("FILL <address> <length> <value> [size]\n");
+	printf("    Fill <length> bytes of data or shared RAM (PRU-local "
+			"address, see COPY)\n");
+	printf("    with <value> repeated every <size> bytes (1, 2 or 4, "
+			"default 4)\n\n");
+
 	printf("G\n");
 	printf("    Start processor execution of instructions (at current "
 			"IP)\n\n");
@@ -72,22 +115,88 @@ void printhelp()
 	printf("    given, only <count> steps will be made.  If <count> is "
 			"either not specified\n");
 	printf("    or given as '0', stepping will continue until otherwise "
-			"interrupted.\n\n");
+			"interrupted.\n");
+	printf("    Without <count>, with watch points set and only hw "
+			"breakpoints, the program\n");
+	printf("    runs at full speed and is only stepped over its SBBO, "
+			"SBCO, XOUT and XCHG\n");
+	printf("    instructions, after which the watch points are checked; "
+			"memory written by\n");
+	printf("    the other PRU or the host is not noticed in this "
+			"mode\n\n");
+
+	printf("SYM <elf_file | address>\n");
+	printf("    Load the function symbols and DWARF line table of the "
+			"firmware running on\n");
+	printf("    the current PRU (done automatically by L for ELF files), "
+			"or show the\n");
+	printf("    function and source line of an instruction address.  "
+			"Once loaded, BR, DIS\n");
+	printf("    and J accept symbol[+offset] in place of an address.  "
+			"The index is cached\n");
+	printf("    in <elf_file>.symidx.\n\n");
 
 	printf("TRACE [<k_elements>] [<stop_on_halt> [<filename>]]\n");
 	printf("    Start processor execution while sampling its program counter]\n");
 	printf("    - <k_elements> how many thousand elements to store (defaults to 1)\n");
 	printf("    - if <stop_on_halt> is true, it will stop automatically when a HALT\n");
 	printf("      instruction is encountered. This will result in lower sampling rate.\n");
-	printf("    - if <filename> is passed, the trace will be written to it instead of stdout\n\n");
+	printf("    - if <filename> is passed, the trace is streamed to it as with TRACE STREAM\n");
+	printf("      in the compressed binary format; \"prudis --trace <filename>\" prints\n");
+	printf("      it as text, one PC per line\n\n");
+
+	printf("TRACE STREAM <filename> [HALT] [CPU <n>] [FIFO]\n");
+	printf("    Run the processor and stream every change of its program "
+			"counter, with a\n");
+	printf("    timestamp and the number of polls that saw it, to a binary "
+			"file until ctrl-C\n");
+	printf("    (or a HALT instruction with HALT).  A sampler thread polls "
+			"the PC and a\n");
+	printf("    writer thread writes the file, so the trace length is only "
+			"limited by disk.\n");
+	printf("    CPU pins the sampler to core <n>, FIFO runs it under "
+			"SCHED_FIFO (needs\n");
+	printf("    CAP_SYS_NICE; on a single core it starves the writer).  "
+			"The achieved poll\n");
+	printf("    rate and any records dropped because the writer fell "
+			"behind are reported.\n");
+	printf("    The file is delta and run-length encoded in blocks with "
+			"an index, so tools\n");
+	printf("    can seek to a sample or time without decoding it all "
+			"(trace.h).\n\n");
 
 	printf("HALT\n");
 	printf("    Halt the processor\n\n");
 
-	printf("L <32bit-address> file_name\n");
+	printf("IRAM [sync | check]\n");
+	printf("    Show the host-side copy of instruction memory that DIS and the "
+			"stepping\n");
+	printf("    loops read from.  'sync' reloads it from the PRU, 'check' "
+			"reports and\n");
+	printf("    picks up words changed outside the debugger.\n\n");
+
+	printf("L [<32bit-address>] file_name\n");
 	printf("    Load program file into instruction memory at 32-bit word "
 			"address provided\n");
-	printf("    (offset from beginning of instruction memory\n\n");
+	printf("    (offset from beginning of instruction memory\n");
+	printf("    ELF executables from clpru or pru-gcc are recognized "
+			"automatically: their\n");
+	printf("    code and data segments are loaded into instruction, data "
+			"and shared RAM,\n");
+	printf("    the reset PC is set to the entry point and the address "
+			"is not needed.\n\n");
+	printf("LINT\n");
+	printf("    Flag stall-prone code in instruction memory with an "
+			"estimate of the cycles\n");
+	printf("    lost: loads and stores outside the PRUSS inside loops, "
+			"neighbouring\n");
+	printf("    accesses that fit one burst, dead or redundant LDIs and "
+			"jumps to jumps\n\n");
+	printf("LOADSTATE file_name\n");
+	printf("    Restore a checkpoint written by SAVESTATE: memories and "
+			"registers of all\n");
+	printf("    PRUs.  The file is checked first; the PRUs are left "
+			"halted at the saved PC.\n\n");
 	printf("J address\n");
 	printf("    Move the program counter to the specified address (absolute or relative). If <address> is not provided, jumps to +1\n\n");
 
@@ -98,6 +207,25 @@ void printhelp()
 	printf("    Some debugger commands do action on active PRU (such as "
 			"halt and reset)\n\n");
 
+	printf("PROF [<seconds>] [RATE <hz>]\n");
+	printf("    Sample the program counter of the running PRU <hz> times "
+			"a second (%u by\n", PROF_DEFAULT_RATE);
+	printf("    default, 0 for as fast as possible) for <seconds> or until "
+			"ctrl-C or HALT.\n");
+	printf("    Only the status register is read, the PRU is not halted "
+			"or slowed down.\n");
+	printf("    The samples per instruction of the whole IRAM are kept "
+			"for the reports:\n");
+	printf("    PROF DIS [<address> [<length>]] - DIS listing with the "
+			"share of samples of\n");
+	printf("      each instruction, by default of the sampled range\n");
+	printf("    PROF FUNC - samples per function, by symbol if SYM has "
+			"loaded any\n");
+	printf("    PROF FOLDED [<file>] - folded stacks for flame graph "
+			"tools; the callers come\n");
+	printf("      from the static call graph, \"?\" marks a function "
+			"with several callers\n\n");
+
 	printf("Q\n");
 	printf("    Quit the debugger and return to shell prompt.\n\n");
 
@@ -116,12 +244,39 @@ void printhelp()
 	printf("     Display value from the constant table, e.g.:\n");
 	printf("     C2 // prints C2 \n");
 
+	printf("REC [<file> | OFF]\n");
+	printf("    Record the PC and R0-R31 after every step of the GSS runs "
+			"that follow, as\n");
+	printf("    deltas of the changed registers (a few bytes per step), "
+			"and write the whole\n");
+	printf("    history to <file> each time a run stops.  GSS steps every "
+			"instruction while\n");
+	printf("    recording.  \"prudis --rec <file>\" prints it.  REC OFF "
+			"stops recording,\n");
+	printf("    REC alone shows its state.\n\n");
+
 	printf("RESET\n");
 	printf("    Reset the current PRU\n\n");
 
+	printf("SAVESTATE file_name [zstd]\n");
+	printf("    Checkpoint instruction, data and shared RAM, control "
+			"registers and, for\n");
+	printf("    halted PRUs, R0-R31 and C0-C31 of all PRUs into one "
+			"file, zstd compressed\n");
+	printf("    if asked and prudebug was built with ZSTD=1\n\n");
+
 	printf("SS [n_steps]\n");
 	printf("    Single step the current instruction.\n\n");
 
+	printf("STACK [elf_file]\n");
+	printf("    Worst stack depth of every function and entry point in "
+			"instruction memory,\n");
+	printf("    following the R2 adjustments of each frame through calls "
+			"and tail jumps.\n");
+	printf("    With <elf_file> also the data used per data RAM and the "
+			"room left for the\n");
+	printf("    stack, against the RAM sizes of the selected processor\n");
+
 	printf("WA [watch_num [<address> [ (len | : value0 [value1 ...]) ]]]\n");
 	printf("    Clear or set a watch point\n");
 	printf("    For the `WA` command, the <address> may also utilize "
@@ -153,9 +308,25 @@ void printhelp()
 			"halted when the\n");
 	printf("       memory span at that location location equals the values "
 			"specified\n");
+	printf("     Up to %u watch points of up to %u bytes each can be set; "
+			"watches that\n", MAX_WATCH, MAX_WATCH_LEN);
+	printf("     overlap or lie close together are read as one block per "
+			"step\n");
 	printf("     NOTE: for watchpoints to work, you must use gss command "
 			"to run the program\n\n");
 
+	printf("WCET [<from> <to>] [annotation_file]\n");
+	printf("    Static worst-case cycle counts of instruction memory: "
+			"per function,\n");
+	printf("    per block and for LOOP instructions, plus the worst "
+			"path from <from> to\n");
+	printf("    <to> (instruction addresses or symbols).  Every "
+			"instruction costs one cycle;\n");
+	printf("    the annotation file adds \"loop <address> <count>\" "
+			"bounds and\n");
+	printf("    \"mem <address> <length> <cycles>\" load/store "
+			"latencies per data region\n\n");
+
 	printf("WR <address> value1 [value2 [value3 ...]]\n");
 	printf("    Write a byte value to a raw (offset from beginning of full "
 			"PRU memory\n");
@@ -174,6 +345,11 @@ void printhelp()
 			"from beginning of\n");
 	printf("    PRU instruction memory)\n\n");
 
+	printf("WRF <address> file_name\n");
+	printf("    Write the contents of a binary file to data or shared RAM "
+			"(PRU-local\n");
+	printf("    address, see COPY) with word-sized stores\n\n");
+
 	printf("A brief version of help is available with the command hb\n");
 
 	printf("\n");
@@ -182,25 +358,41 @@ void printhelp()
 void printhelpbrief()
 {
 	printf("Command help\n\n");
-	printf("    BR [breakpoint_number [address [s]]] - View or set an instruction breakpoint, \"s\" makes it a software breakpoint\n");
+	printf("    BA [CLEAR] [address ...] - List, set or clear any number of software breakpoints\n");
+	printf("    BENCH [length] - Time byte, word and burst reads of PRU data memory\n");
+	printf("    BR [breakpoint_number [address [s] [IF condition]]] - View or set an instruction breakpoint, \"s\" makes it a software breakpoint\n");
+	printf("    CFG [dot | json] [filename] - Control-flow and call graph of instruction memory\n");
+	printf("    COPY <src> <dst> <length> - Copy within data and shared RAM (PRU-local addresses)\n");
 	printf("    D <address> [length] - Raw dump of PRU data memory (byte offset from beginning of full PRU memory block - all PRUs)\n");
 	printf("    DD <address> [length] - Dump data memory (byte offset from beginning of PRU data memory)\n");
 	printf("    DI <address> [length] - Dump instruction memory (byte offset from beginning of PRU instruction memory)\n");
 	printf("    DIS <32bit-address> [length] - Disassemble instruction memory (32-bit word offset from beginning of PRU instruction memory)\n");
+	printf("    FILL <address> <length> <value> [size] - Fill data or shared RAM with a 1, 2 or 4 byte value\n");
 	printf("    G - Start processor execution of instructions (at current IP)\n");
 	printf("    GSS - Start processor execution using automatic single stepping - this allows running a program with breakpoints\n");
+	printf("    SYM <elf_file | address> - Load symbols and line table, or look up an address\n");
 	printf("    TRACE [<stop_on_halt> [<filename>]] - Start processor execution while sampling its program counter]\n");
+	printf("    TRACE STREAM <filename> [HALT] [CPU <n>] [FIFO] - Stream program counter changes to a binary file\n");
 	printf("    HALT - Halt the processor\n");
-	printf("    L <32bit-address> file_name - Load program file into instruction memory\n");
+	printf("    IRAM [sync | check] - Show, reload or verify the host copy of instruction memory\n");
+	printf("    L [<32bit-address>] file_name - Load program file or ELF executable into PRU memory\n");
+	printf("    LINT - Flag stall-prone code in instruction memory with estimated cycle costs\n");
+	printf("    LOADSTATE file_name - Restore all PRUs from a SAVESTATE checkpoint\n");
 	printf("    PRU pru_number - Set the active PRU where pru_number ranges from 0 to %u\n", NUM_OF_PRU - 1);
+	printf("    PROF [<seconds>] [RATE <hz>] | DIS | FUNC | FOLDED [<file>] - Statistical profile of the running PRU\n");
 	printf("    Q - Quit the debugger and return to shell prompt.\n");
 	printf("    R - Display the current PRU registers.\n");
+	printf("    REC [<file> | OFF] - Record PC and register changes of every GSS step to a file\n");
 	printf("    RESET - Reset the current PRU\n");
+	printf("    SAVESTATE file_name [zstd] - Checkpoint memories and registers of all PRUs\n");
 	printf("    SS - Single step the current instruction.\n");
+	printf("    STACK [elf_file] - Worst stack depth per function and entry point, and data memory use\n");
 	printf("    WA [watch_num [address [ (len | : value0 [value1 ...]) ]]] - Clear or set a watch point\n");
+	printf("    WCET [<from> <to>] [annotation_file] - Static worst-case cycle counts and worst path\n");
 	printf("    WR <address> value1 [value2 [value3 ...]] - Write a byte value to a raw (offset from beginning of full PRU memory block)\n");
 	printf("    WRD <address> value1 [value2 [value3 ...]] - Write a byte value to PRU data memory for current PRU\n");
 	printf("    WRI <address> value1 [value2 [value3 ...]] - Write a byte value to PRU instruction memory for current PRU\n");
+	printf("    WRF <address> file_name - Write a binary file to data or shared RAM (PRU-local address)\n");
 
 	printf("\n");
 }
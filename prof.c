@@ -0,0 +1,422 @@
+/*
+ *
+ *  PRU Debug Program - statistical profiler
+ *
+ *  PROF reads the program counter of a running PRU from its status
+ *  register at a fixed rate and counts the samples per instruction
+ *  address.  A status register read is a plain bus read that the PRU
+ *  never sees: the PRU is not halted, stepped or patched, so the profile
+ *  is that of the firmware running at full speed.  The histogram covers
+ *  the whole IRAM and is kept until the next PROF run, so the reports
+ *  (annotated listing, per-function totals, folded stacks) can be asked
+ *  for one after the other.
+ *
+ *  The PRU has no call stack the host can read while it runs, so folded
+ *  stacks are built from the static call graph (cfg.c): a function's
+ *  caller is prepended as long as it is the only one.  A stack that
+ *  reaches a function with several callers starts with a "?" frame.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "prudbg.h"
+#include "backend.h"
+#include "da.h"
+#include "cfg.h"
+#include "sym.h"
+
+#define PROF_CHECKS		100		// run state and time checks per second
+#define PROF_FAST_CHECK		65536		// samples between checks at RATE 0
+#define PROF_MAX_DEPTH		32		// frames in a folded stack
+
+struct prof {
+	uint64_t		*hist;		// samples per IRAM word address
+	unsigned int		len;
+	unsigned int		pru;
+	uint64_t		samples;
+	uint64_t		outside;	// PC beyond the IRAM
+	uint64_t		late;		// samples taken behind schedule
+	uint64_t		duration_ns;
+	unsigned long		rate;
+};
+
+static struct prof		prof;
+
+static inline uint64_t ns_since(const struct timespec *t0)
+{
+	struct timespec		t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec - t0->tv_sec) * 1000000000ull + t.tv_nsec - t0->tv_nsec;
+}
+
+static inline void ts_add(struct timespec *t, uint64_t ns)
+{
+	t->tv_nsec += ns % 1000000000ull;
+	t->tv_sec += ns / 1000000000ull + t->tv_nsec / 1000000000;
+	t->tv_nsec %= 1000000000;
+}
+
+static inline double pct(uint64_t n)
+{
+	return prof.samples ? 100.0 * n / prof.samples : 0;
+}
+
+// Sample the PC of the running active PRU rate times a second (as fast as
+// possible for 0) for seconds (until *interrupted for 0) or until it halts.
+void prof_run(double seconds, unsigned long rate, volatile int *interrupted)
+{
+	struct timespec		t0, next, now;
+	uint64_t		period = rate ? 1000000000ull / rate : 0;
+	uint64_t		limit = seconds * 1e9, check, n = 0;
+	unsigned int		pc;
+	double			s;
+	int			halted = 0;
+
+	if (!(pru_ctrl_read(pru_num, PRU_CTRL_REG) & PRU_REG_PROC_EN)) {
+		printf("ERROR: PRU%u is not running, start it with G first\n", pru_num);
+		return;
+	}
+	free(prof.hist);
+	memset(&prof, 0, sizeof(prof));
+	prof.hist = calloc(pru_iram_len, sizeof(prof.hist[0]));
+	if (!prof.hist) {
+		printf("ERROR: out of memory\n");
+		return;
+	}
+	prof.len = pru_iram_len;
+	prof.pru = pru_num;
+	prof.rate = rate;
+	check = rate ? (rate + PROF_CHECKS - 1) / PROF_CHECKS : PROF_FAST_CHECK;
+
+	if (rate)
+		printf("Profiling PRU%u at %lu samples/s ... press ctrl-C to stop\n", pru_num, rate);
+	else
+		printf("Profiling PRU%u as fast as possible ... press ctrl-C to stop\n", pru_num);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	next = t0;
+	while (!*interrupted) {
+		pc = pru_ctrl_read(pru_num, PRU_STATUS_REG) & 0xFFFF;
+		if (pc < prof.len)
+			prof.hist[pc]++;
+		else
+			prof.outside++;
+		if (++n % check == 0) {
+			if (!(pru_ctrl_read(pru_num, PRU_CTRL_REG) & PRU_REG_PROC_EN)) {
+				halted = 1;
+				break;
+			}
+			if (limit && ns_since(&t0) >= limit)
+				break;
+		}
+		if (period) {
+			ts_add(&next, period);
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec && now.tv_nsec >= next.tv_nsec)) {
+				// behind: take the next sample now and don't try to catch up
+				prof.late++;
+				next = now;
+			} else {
+				while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !*interrupted)
+					;
+			}
+		}
+	}
+	prof.samples = n;
+	prof.duration_ns = ns_since(&t0);
+
+	if (halted)
+		printf("PRU%u halted, profiling stopped.\n", pru_num);
+	s = prof.duration_ns / 1e9;
+	printf("%llu samples in %.3f s", (unsigned long long)n, s);
+	if (s > 0)
+		printf(", %.0f samples/s", n / s);
+	if (prof.late)
+		printf(", %llu late", (unsigned long long)prof.late);
+	if (prof.outside)
+		printf(", %llu outside IRAM", (unsigned long long)prof.outside);
+	printf("\n\n");
+}
+
+// 0 if there is a profile of the active PRU to report
+static int prof_check()
+{
+	if (!prof.samples) {
+		printf("ERROR: no profile, run PROF first\n");
+		return -1;
+	}
+	if (prof.pru != pru_num) {
+		printf("ERROR: the profile is of PRU%u\n", prof.pru);
+		return -1;
+	}
+	return 0;
+}
+
+// DIS listing of [addr, addr+len) with the share of samples of each
+// instruction; the range of sampled addresses if len is 0
+void prof_dis(const struct sym_index *syms, unsigned int addr, unsigned int len)
+{
+	struct sym_loc		loc, last = {0};
+	struct pru_insn		insn;
+	char			inst_str[50], share[16];
+	unsigned int		i, lo = prof.len, hi = 0;
+
+	if (prof_check())
+		return;
+	if (!len) {
+		for (i = 0; i < prof.len; i++) {
+			if (prof.hist[i]) {
+				if (lo == prof.len)
+					lo = i;
+				hi = i + 1;
+			}
+		}
+		addr = lo;
+		len = hi > lo ? hi - lo : 0;
+	}
+	if (addr >= prof.len)
+		len = 0;
+	else if (addr + len > prof.len)
+		len = prof.len - addr;
+	for (i = addr; i < addr + len; i++) {
+		pru_decode(iram_read(i), &insn);
+		pru_format(inst_str, sizeof(inst_str), &insn);
+		if (prof.hist[i])
+			snprintf(share, sizeof(share), "%6.2f%%", pct(prof.hist[i]));
+		else
+			strcpy(share, "       ");
+		if (!syms) {
+			printf("[0x%04x] 0x%08x %s %s\n", i, insn.inst, share, inst_str);
+			continue;
+		}
+		sym_lookup(syms, i, &loc);
+		if (loc.func && loc.offset == 0)
+			printf("%s:\n", loc.func);
+		printf("[0x%04x] 0x%08x %s %-32s", i, insn.inst, share, inst_str);
+		if (loc.file && (loc.file != last.file || loc.line != last.line))
+			printf(" ; %s:%u", loc.file, loc.line);
+		printf("\n");
+		last = loc;
+	}
+	printf("\n");
+}
+
+struct prof_func {
+	uint32_t		start;
+	const char		*name;
+	uint64_t		samples;
+};
+
+static int cmp_samples(const void *a, const void *b)
+{
+	const struct prof_func	*x = a, *y = b;
+
+	if (x->samples != y->samples)
+		return x->samples < y->samples ? 1 : -1;
+	return x->start < y->start ? -1 : x->start > y->start;
+}
+
+static void build_image(struct cfg *g, uint32_t **image)
+{
+	unsigned int		len;
+
+	*image = malloc(prof.len * sizeof(uint32_t));
+	if (!*image) {
+		printf("ERROR: out of memory\n");
+		return;
+	}
+	len = iram_read_block(0, *image, prof.len);
+	if (cfg_build(g, *image, len, 0)) {
+		free(*image);
+		*image = NULL;
+	}
+}
+
+// samples per function, by symbol when symbols are loaded and by the
+// functions of the control-flow graph otherwise
+void prof_funcs(const struct sym_index *syms)
+{
+	struct prof_func	*f;
+	struct cfg		g;
+	uint32_t		*image = NULL;
+	uint64_t		other;
+	unsigned int		i, k, n;
+	char			(*names)[16] = NULL;
+
+	if (prof_check())
+		return;
+	if (syms) {
+		n = syms->hdr->nfuncs;
+	} else {
+		build_image(&g, &image);
+		if (!image)
+			return;
+		n = g.nfuncs;
+	}
+	f = calloc(n + 1, sizeof(*f));
+	if (!syms)
+		names = calloc(n + 1, sizeof(*names));
+	if (!f || (!syms && !names)) {
+		printf("ERROR: out of memory\n");
+		goto cleanup;
+	}
+	other = prof.samples - prof.outside;
+	for (k = 0; k < n; k++) {
+		if (syms) {
+			f[k].start = syms->funcs[k].start;
+			f[k].name = syms->strs + syms->funcs[k].name;
+			for (i = f[k].start; i < syms->funcs[k].end && i < prof.len; i++)
+				f[k].samples += prof.hist[i];
+		} else {
+			f[k].start = g.funcs[k].entry;
+			snprintf(names[k], sizeof(names[k]), "func_0x%04x", f[k].start);
+			f[k].name = names[k];
+		}
+	}
+	if (!syms) {
+		for (i = 0; i < prof.len; i++) {
+			k = cfg_func_at(&g, i);
+			if (k != CFG_NONE)
+				f[k].samples += prof.hist[i];
+		}
+	}
+	for (k = 0; k < n; k++)
+		other -= f[k].samples;
+	qsort(f, n, sizeof(*f), cmp_samples);
+	printf("  Share    Samples  Function\n");
+	for (k = 0; k < n && f[k].samples; k++)
+		printf("%6.2f%% %10llu  %s [0x%04x]\n", pct(f[k].samples),
+		       (unsigned long long)f[k].samples, f[k].name, f[k].start);
+	if (other)
+		printf("%6.2f%% %10llu  (no function)\n", pct(other), (unsigned long long)other);
+	if (prof.outside)
+		printf("%6.2f%% %10llu  (outside IRAM)\n", pct(prof.outside), (unsigned long long)prof.outside);
+	printf("\n");
+cleanup:
+	free(names);
+	free(f);
+	if (image) {
+		cfg_free(&g);
+		free(image);
+	}
+}
+
+// name of cfg function k for a stack frame
+static const char *frame_name(const struct sym_index *syms, const struct cfg *g, uint32_t k,
+			      char *buf, unsigned int len)
+{
+	struct sym_loc		loc;
+
+	if (syms) {
+		sym_lookup(syms, g->funcs[k].entry, &loc);
+		if (loc.func && loc.offset == 0)
+			return loc.func;
+	}
+	snprintf(buf, len, "func_0x%04x", g->funcs[k].entry);
+	return buf;
+}
+
+// the only caller of function k, CFG_NONE if there is none, and
+// CFG_NONE - 1 if there are several
+static uint32_t only_caller(const struct cfg *g, uint32_t k)
+{
+	uint32_t		i, caller = CFG_NONE;
+
+	for (i = 0; i < g->ncalls; i++) {
+		if (g->calls[i].callee != k || g->calls[i].caller == k)
+			continue;
+		if (caller != CFG_NONE && caller != g->calls[i].caller)
+			return CFG_NONE - 1;
+		caller = g->calls[i].caller;
+	}
+	return caller;
+}
+
+// one "frame;frame;... samples" line per sampled function, for
+// flamegraph.pl and compatible tools; to stdout if fn is NULL
+void prof_folded(const struct sym_index *syms, const char *fn)
+{
+	struct cfg		g;
+	uint32_t		*image, frames[PROF_MAX_DEPTH], k, c;
+	uint64_t		*per_func, none = 0;
+	unsigned int		i, d, lines = 0;
+	char			buf[16];
+	FILE			*stream = stdout;
+	int			ambiguous;
+
+	if (prof_check())
+		return;
+	build_image(&g, &image);
+	if (!image)
+		return;
+	per_func = calloc(g.nfuncs + 1, sizeof(*per_func));
+	if (!per_func) {
+		printf("ERROR: out of memory\n");
+		goto cleanup;
+	}
+	for (i = 0; i < prof.len; i++) {
+		k = cfg_func_at(&g, i);
+		if (k != CFG_NONE)
+			per_func[k] += prof.hist[i];
+		else
+			none += prof.hist[i];
+	}
+	if (fn) {
+		stream = fopen(fn, "w");
+		if (!stream) {
+			printf("ERROR: could not create %s: %s\n", fn, strerror(errno));
+			goto cleanup;
+		}
+	}
+	for (k = 0; k < g.nfuncs; k++) {
+		if (!per_func[k])
+			continue;
+		// leaf first, callers up the static call graph while unique
+		frames[0] = k;
+		ambiguous = 0;
+		for (d = 1; d < PROF_MAX_DEPTH; d++) {
+			c = only_caller(&g, frames[d - 1]);
+			if (c == CFG_NONE)
+				break;
+			if (c == CFG_NONE - 1) {
+				ambiguous = 1;
+				break;
+			}
+			for (i = 0; i < d && frames[i] != c; i++)
+				;
+			if (i < d)
+				break;		// recursion
+			frames[d] = c;
+		}
+		if (ambiguous || d == PROF_MAX_DEPTH)
+			fprintf(stream, "?;");
+		while (d--)
+			fprintf(stream, "%s%s", frame_name(syms, &g, frames[d], buf, sizeof(buf)), d ? ";" : "");
+		fprintf(stream, " %llu\n", (unsigned long long)per_func[k]);
+		lines++;
+	}
+	if (none + prof.outside)
+		fprintf(stream, "[unknown] %llu\n", (unsigned long long)(none + prof.outside));
+	if (fn) {
+		if (fclose(stream))
+			printf("ERROR: writing %s: %s\n", fn, strerror(errno));
+		else
+			printf("%u stacks written to %s\n", lines, fn);
+	}
+	printf("\n");
+cleanup:
+	free(per_func);
+	cfg_free(&g);
+	free(image);
+}
+
+void prof_free()
+{
+	free(prof.hist);
+	memset(&prof, 0, sizeof(prof));
+}
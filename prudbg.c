@@ -10,7 +10,6 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <errno.h>
@@ -19,16 +18,19 @@
 #include <ctype.h>
 
 #include "prudbg.h"
-#include "uio.h"
 #include "privs.h"
+#include "backend.h"
+#include "uio.h"
 
 
 // global variable definitions
-volatile unsigned int		*pru;
 unsigned int			pru_inst_base[MAX_NUM_OF_PRUS];
 unsigned int			pru_ctrl_base[MAX_NUM_OF_PRUS];
 unsigned int			pru_data_base[MAX_NUM_OF_PRUS];
 unsigned int			pru_num;
+unsigned int			pru_iram_len;
+unsigned int			pru_dram_len, pru_shared_base, pru_shared_len;
+struct pru_layout		pruss_layout;
 unsigned int			last_offset, last_addr, last_len, last_cmd;
 unsigned int			last_n_single_step;
 struct breakpoints		bp[MAX_NUM_OF_PRUS][MAX_BREAKPOINTS];
@@ -46,6 +48,10 @@ struct pdb_tag {
 	char			short_name[MAX_PROC_NAME];
 	unsigned int		pruss_address;
 	unsigned int		pruss_len;
+	unsigned int		iram_len;
+	unsigned int		dram_len;
+	unsigned int		shared_base;
+	unsigned int		shared_len;
 	unsigned int		num_of_pruss;
 	const offsets_t		offsets[MAX_NUM_OF_PRUS];
 } pdb[] = {
@@ -57,7 +63,10 @@ struct pdb_tag {
 // select a processor at the command prompt (should be short and no spaces),
 // "pruss_address" is the byte address of the beginning of the PRUSS memory
 // space on the ARM, "pruss_len" is the memory allocated starting at the
-// pruss_address address, "num_of_pruss" is the number of PRUs in the ARM
+// pruss_address address, "iram_len" is the size of each PRU's instruction
+// RAM in 32-bit words, "dram_len" the size of each PRU's data RAM in bytes,
+// "shared_base" and "shared_len" the 32-bit word offset and byte size of the
+// shared data RAM (0 if there is none), "num_of_pruss" is the number of PRUs in the ARM
 // processor (currently 2 is the only valid value), and "offsets" is an
 // array of 32-bit word address/index values used to locate the instruction,
 // data, and control memory locations for a specific PRU.  This offsets
@@ -73,6 +82,10 @@ struct pdb_tag {
 		.short_name 	= "AM1707",
 		.pruss_address 	= 0x01C30000,
 		.pruss_len 	= 0x20000,
+		.iram_len 	= 0x400,
+		.dram_len 	= 0x200,
+		.shared_base	= 0,
+		.shared_len	= 0,
 		.num_of_pruss	= 2,
 		.offsets	= {
 			{
@@ -92,6 +105,10 @@ struct pdb_tag {
 		.short_name 	= "AM335X",
 		.pruss_address 	= 0x4A300000,
 		.pruss_len 	= 0x40000,
+		.iram_len 	= 0x800,
+		.dram_len 	= 0x2000,
+		.shared_base	= 0x4000,
+		.shared_len	= 0x3000,
 		.num_of_pruss	= 2,
 		.offsets	= {
 			{
@@ -111,6 +128,10 @@ struct pdb_tag {
 		.short_name 	= "AM57X1",
 		.pruss_address 	= 0x4b200000,
 		.pruss_len 	= 0x80000,
+		.iram_len 	= 0xC00,
+		.dram_len 	= 0x2000,
+		.shared_base	= 0x4000,
+		.shared_len	= 0x8000,
 		.num_of_pruss	= 2,
 		.offsets	= {
 			{
@@ -130,6 +151,10 @@ struct pdb_tag {
 		.short_name 	= "AM57X2",
 		.pruss_address 	= 0x4b280000,
 		.pruss_len 	= 0x80000,
+		.iram_len 	= 0xC00,
+		.dram_len 	= 0x2000,
+		.shared_base	= 0x4000,
+		.shared_len	= 0x8000,
 		.num_of_pruss	= 2,
 		.offsets	= {
 			{
@@ -149,6 +174,10 @@ struct pdb_tag {
 		.short_name     = "XJ721E",
 		.pruss_address  = 0xb000000,
 		.pruss_len      = 0x80000,
+		.iram_len       = 0xC00,
+		.dram_len       = 0x2000,
+		.shared_base    = 0x4000,
+		.shared_len     = 0x10000,
 		.num_of_pruss   = 2,
 		.offsets        = {
 		{
@@ -168,6 +197,10 @@ struct pdb_tag {
 		.short_name 	= "AM62xx",
 		.pruss_address 	= 0x30040000,
 		.pruss_len 	= 0x80000,
+		.iram_len 	= 0x1000,
+		.dram_len 	= 0x2000,
+		.shared_base	= 0x4000,
+		.shared_len	= 0x8000,
 		.num_of_pruss	= 2,
 		.offsets	= {
 			{
@@ -225,6 +258,21 @@ static long parse_long(const char * str) {
 	return strtoll(str, NULL, 0);
 }
 
+/* Instruction address: a number, or symbol[+offset] from the firmware
+ * loaded on the active PRU.  Returns -1 for an unknown symbol. */
+static long parse_iaddr(const char * str) {
+	unsigned int addr;
+
+	if (isalpha((unsigned char)str[0]) || str[0] == '_') {
+		if (parse_symbol(str, &addr)) {
+			printf("ERROR: unknown symbol %s\n", str);
+			return -1;
+		}
+		return addr;
+	}
+	return parse_long(str);
+}
+
 static size_t parse_addr(const char * str, const regex_t * reg_regex) {
 	size_t addr;
 
@@ -251,7 +299,6 @@ static size_t parse_addr(const char * str, const regex_t * reg_regex) {
 // main entry point for program
 int main(int argc, char *argv[])
 {
-	int			fd;
 	char			prompt_str[20];
 	char			cmd[MAX_CMD_LEN], cmdargs[MAX_CMDARGS_LEN];
 	unsigned int		argptrs[MAX_ARGS], numargs;
@@ -259,8 +306,11 @@ int main(int argc, char *argv[])
 	unsigned int		addr, len, bpnum, offset, wanum;
 	int			opt;
 	unsigned long		opt_pruss_addr;
-	int			pru_access_mode, pi, pitemp;
-	char			uio_dev_file[50];
+	int			pi, pitemp;
+	char			*opt_backend = NULL, *backend_arg, backend_buf[32];
+	int			opt_instance = -1;
+	const struct pruss_instance *inst;
+	unsigned int		num_inst;
 	regex_t reg_regex;
 	regex_t rc_regex;
 	regcomp(&reg_regex, "[:space:]*r[0-9]\\+\\>", REG_ICASE);
@@ -274,21 +324,36 @@ int main(int argc, char *argv[])
 
 	// get command line options
 	opt_pruss_addr = 0;
-	pru_access_mode = ACCESS_GUESS;
 	pi = DEFAULT_PROCESSOR_INDEX;
 	unsigned int requested_pru = 0;
-	while ((opt = getopt(argc, argv, "?a:p:umn:r:")) != -1) {
+	while ((opt = getopt(argc, argv, "?a:b:i:lp:umsn:r:")) != -1) {
 		switch (opt) {
 			case 'a':
 				opt_pruss_addr = parse_long(optarg);
 				break;
 				
+			case 'b':
+				opt_backend = optarg;
+				break;
+
+			case 'i':
+				opt_instance = parse_long(optarg);
+				break;
+
+			case 'l':
+				pruss_list();
+				return 0;
+
 			case 'u':
-				pru_access_mode = ACCESS_UIO;
+				opt_backend = "uio";
 				break;
 				
 			case 'm':
-				pru_access_mode = ACCESS_MEM;
+				opt_backend = "mem";
+				break;
+
+			case 's':
+				opt_backend = "sim";
 				break;
 				
 			case 'n':
@@ -312,11 +377,15 @@ int main(int argc, char *argv[])
 				
 			case '?':
 			default: /* '?' */
-				printf("Usage: prudebug [-a pruss-address] [-u] [-m] [-p processor] [-n pru_num] [-r filename]\n");
+				printf("Usage: prudebug [-a pruss-address] [-b backend] [-i instance] [-l] [-u] [-m] [-s] [-p processor] [-n pru_num] [-r filename]\n");
 				printf("    -a - pruss-address is the memory address of the PRU in ARM memory space\n");
+				printf("    -b - access the PRUs through backend: %s\n", pru_backend_names());
+				printf("    -i - use PRUSS instance number <instance> (through UIO if it has a UIO device, /dev/mem otherwise)\n");
+				printf("    -l - list the PRUSS instances found in sysfs and exit\n");
 				printf("    -u - force the use of UIO to map PRU memory space\n");
 				printf("    -m - force the use of /dev/mem to map PRU memory space\n");
-				printf("    if neither the -u or -m options are used then it will try the UIO first\n");
+				printf("    -s - simulate the PRUs instead of using hardware (same as -b sim)\n");
+				printf("    if none of -b, -u, -m or -s is used then it will try the UIO first\n");
 				
 				printf("    -n - select PRU number to use\n");
 				printf("    -r filename - load filename containing register numbers<->names mapping in the form \"<number> <name>\"\n");
@@ -332,6 +401,10 @@ int main(int argc, char *argv[])
 	select_pru(&pdb[pi], requested_pru);
 	
 	// setup PRU memory offsets
+	pru_iram_len = pdb[pi].iram_len;
+	pru_dram_len = pdb[pi].dram_len;
+	pru_shared_base = pdb[pi].shared_base;
+	pru_shared_len = pdb[pi].shared_len;
 	for (i=0; i<pdb[pi].num_of_pruss ;i++) {
 		pru_inst_base[i] = pdb[pi].offsets[i].pruss_inst;
 		pru_data_base[i] = pdb[pi].offsets[i].pruss_data;
@@ -341,62 +414,50 @@ int main(int argc, char *argv[])
 	// if user hasn't requested a different PRU base address on the CLI, then use the PRU DB address
 	if (opt_pruss_addr == 0) opt_pruss_addr = pdb[pi].pruss_address;
 
-	// determine how to obtain the PRU base memory pointer (/dev/mem or a UIO PRUSS driver file - /dev/uio*)
-	if (pru_access_mode == ACCESS_GUESS || pru_access_mode == ACCESS_UIO) {
-		// get the UIO info (a UIO device file for the PRUSS)
-		uio_getprussfile(uio_dev_file, sizeof(uio_dev_file));
-		if (uio_dev_file[0] != 0) {
-			// there is a valid UIO/PRUSS file so open it and use the pointer
-			fd = open (uio_dev_file, O_RDWR | O_SYNC);
-			if (fd == -1) {
-				printf ("ERROR: could not open /dev/mem.\n\n");
-				return 1;
-			}
-			pru = mmap (0, pdb[pi].pruss_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-			if (pru == MAP_FAILED) {
-				printf ("ERROR: could not map memory.\n\n");
-				return 1;
-			}
-			close(fd);
-			printf ("Using UIO PRUSS device.\n");
-		} else if (pru_access_mode == ACCESS_UIO) {
-			// user wanted only UIO device and none found - generate an error and exit
-			printf ("ERROR:  UIO PRUSS device requested and none found.\n\n");
-			return (1);
-		} else {
-			// no valid UIO device file and user wants a guess so open /dev/mem
-			fd = open ("/dev/mem", O_RDWR | O_SYNC);
-			if (fd == -1) {
-				printf ("ERROR: could not open /dev/mem.\n\n");
-				return 1;
-			}
-			pru = mmap (0, pdb[pi].pruss_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, opt_pruss_addr);
-			if (pru == MAP_FAILED) {
-				printf ("ERROR: could not map memory.\n\n");
-			return 1;
-			}
-			close(fd);
-			printf ("Using /dev/mem device.\n");
+	// open the backend: a UIO PRUSS device file (/dev/uio*) if there is
+	// one and nothing else was asked for, /dev/mem otherwise
+	pruss_layout.name = pdb[pi].short_name;
+	pruss_layout.address = opt_pruss_addr;
+	pruss_layout.num_of_pruss = pdb[pi].num_of_pruss;
+	pruss_layout.pruss_len = pdb[pi].pruss_len;
+	pruss_layout.iram_len = pru_iram_len;
+	pruss_layout.dram_len = pru_dram_len;
+	pruss_layout.shared_base = pru_shared_base;
+	pruss_layout.shared_len = pru_shared_len;
+	for (i=0; i<pdb[pi].num_of_pruss; i++) {
+		pruss_layout.inst_base[i] = pru_inst_base[i];
+		pruss_layout.data_base[i] = pru_data_base[i];
+		pruss_layout.ctrl_base[i] = pru_ctrl_base[i];
+	}
+	if (opt_instance >= 0) {
+		inst = pruss_instances(&num_inst);
+		if (!opt_backend)
+			opt_backend = (unsigned int)opt_instance < num_inst && inst[opt_instance].uio_file[0] ?
+				      "uio" : "mem";
+		if (!strchr(opt_backend, ':')) {
+			snprintf(backend_buf, sizeof(backend_buf), "%s:%d", opt_backend, opt_instance);
+			opt_backend = backend_buf;
 		}
-	} else {
-		// user requested the use of /dev/mem
-		fd = open ("/dev/mem", O_RDWR | O_SYNC);
-		if (fd == -1) {
-			printf ("ERROR: could not open /dev/mem.\n\n");
-			return 1;
-		}
-		pru = mmap (0, pdb[pi].pruss_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, opt_pruss_addr);
-		if (pru == MAP_FAILED) {
-			printf ("ERROR: could not map memory.\n\n");
-			return 1;
-		}
-		close(fd);
-		printf ("Using /dev/mem device.\n");
 	}
+	if (!opt_backend) {
+		pru_be = pru_backend_open("uio", &pruss_layout, NULL);
+		if (!pru_be)
+			opt_backend = "mem";
+	}
+	if (opt_backend) {
+		backend_arg = strchr(opt_backend, ':');
+		if (backend_arg)
+			*backend_arg++ = 0;
+		pru_be = pru_backend_open(opt_backend, &pruss_layout, backend_arg);
+	}
+	if (!pru_be) {
+		if (opt_backend && !strcmp(opt_backend, "uio") && !backend_arg)
+			printf ("ERROR:  UIO PRUSS device requested and none found.\n\n");
+		return 1;
+	}
+	printf ("Using the %s backend.\n", pru_be->ops->name);
 	drop_root_privileges();
 
-	// get memory pointer for PRU from /dev/mem
-
 	// clear breakpoints
 	for (i=0; i<MAX_BREAKPOINTS; i++) {
 		bp[pru_num][i].state = BP_UNUSED;
@@ -448,18 +509,168 @@ int main(int argc, char *argv[])
 				} else {
 					printf("ERROR: breakpoint number must be equal to or between 0 and %u\n", MAX_BREAKPOINTS-1);
 				}
-			} else if (numargs == 2 || (numargs == 3 && !strcasecmp("S", &cmdargs[argptrs[2]]))) {
+			} else {
+				// BR bpnum address [S] [IF condition]
+				unsigned int k = 2, hw = 1;
+				struct cond *cond = NULL;
+				char condtext[MAX_CMDARGS_LEN] = "";
+
+				if (numargs > k && !strcasecmp("S", &cmdargs[argptrs[k]])) {
+					hw = 0; // "s" as an extra argument makes it a sw breakpoint
+					k++;
+				}
+				if (numargs > k + 1 && !strcasecmp("IF", &cmdargs[argptrs[k]])) {
+					for (i = k + 1; i < numargs; i++) {
+						if (i > k + 1)
+							strcat(condtext, " ");
+						strcat(condtext, &cmdargs[argptrs[i]]);
+					}
+					k = numargs;
+				}
 				bpnum = parse_long(&cmdargs[argptrs[0]]);
-				addr = parse_long(&cmdargs[argptrs[1]]);
-				unsigned int hw = numargs == 3 ? 0 : 1; // "s" as an extra argument makes it a sw breakpoint
-				if (bpnum < MAX_BREAKPOINTS) {
-					cmd_set_breakpoint (bpnum, addr, hw);
-				} else {
+				long iaddr = parse_iaddr(&cmdargs[argptrs[1]]);
+				if (k != numargs) {
+					printf("ERROR: invalid breakpoint command\n");
+				} else if (iaddr < 0) {
+					// unknown symbol, already reported
+				} else if (bpnum >= MAX_BREAKPOINTS) {
 					printf("ERROR: breakpoint number must be equal to or between 0 and %u\n", MAX_BREAKPOINTS-1);
+				} else if (condtext[0] && !(cond = cond_compile(condtext))) {
+					// syntax error, already reported
+				} else {
+					addr = iaddr;
+					cmd_set_breakpoint (bpnum, addr, hw, cond);
 				}
+			}
+		}
+
+		else if (!strcmp(cmd, "BA")) {					// BA - breakpoints without a number
+			last_cmd = LAST_CMD_NONE;
+			i = 0;
+			if (numargs == 0) {
+				step_break_list();
+			} else if (!strcasecmp(&cmdargs[argptrs[0]], "CLEAR")) {
+				if (numargs == 1)
+					step_break_clear_all();
+				i = 1;
+			}
+			for (; i < numargs; i++) {
+				long iaddr = parse_iaddr(&cmdargs[argptrs[i]]);
+
+				if (iaddr >= 0)
+					step_break(iaddr, strcasecmp(&cmdargs[argptrs[0]], "CLEAR"));
+			}
+		}
+
+		else if (!strcmp(cmd, "CFG")) {					// CFG - control-flow graph of IRAM
+			last_cmd = LAST_CMD_NONE;
+			if (numargs > 2) {
+				printf("ERROR: too many arguments\n");
+			} else {
+				cmd_cfg(numargs > 0 ? &cmdargs[argptrs[0]] : NULL,
+					numargs > 1 ? &cmdargs[argptrs[1]] : NULL);
+			}
+		}
+
+		else if (!strcmp(cmd, "WCET")) {				// WCET - static worst-case cycle counts
+			last_cmd = LAST_CMD_NONE;
+			if (numargs == 0 || numargs == 1) {
+				cmd_wcet(-1, -1, numargs ? &cmdargs[argptrs[0]] : NULL);
+			} else if (numargs <= 3) {
+				long from = parse_iaddr(&cmdargs[argptrs[0]]);
+				long to = parse_iaddr(&cmdargs[argptrs[1]]);
+				if (from >= 0 && to >= 0)
+					cmd_wcet(from, to, numargs == 3 ? &cmdargs[argptrs[2]] : NULL);
+			} else {
+				printf("ERROR: too many arguments\n");
+			}
+		}
+
+		else if (!strcmp(cmd, "LINT")) {				// LINT - stall-prone code patterns
+			last_cmd = LAST_CMD_NONE;
+			if (numargs == 0)
+				cmd_lint();
+			else
+				printf("ERROR: too many arguments\n");
+		}
+
+		else if (!strcmp(cmd, "STACK")) {				// STACK - stack depth and data footprint
+			last_cmd = LAST_CMD_NONE;
+			if (numargs <= 1)
+				cmd_stack(numargs ? &cmdargs[argptrs[0]] : NULL);
+			else
+				printf("ERROR: too many arguments\n");
+		}
+
+		else if (!strcmp(cmd, "PROF")) {				// PROF - statistical PC profile and its reports
+			last_cmd = LAST_CMD_NONE;
+			if (numargs > 0 && (!strcasecmp(&cmdargs[argptrs[0]], "DIS"))) {
+				long addr = numargs > 1 ? parse_iaddr(&cmdargs[argptrs[1]]) : 0;
+				unsigned int len = numargs > 2 ? parse_long(&cmdargs[argptrs[2]]) : 0;
+				if (numargs > 3)
+					printf("ERROR: too many arguments\n");
+				else if (addr >= 0)
+					cmd_prof_report("DIS", addr, numargs > 1 && !len ? 16 : len, NULL);
+			} else if (numargs > 0 && !strcasecmp(&cmdargs[argptrs[0]], "FUNC")) {
+				if (numargs == 1)
+					cmd_prof_report("FUNC", 0, 0, NULL);
+				else
+					printf("ERROR: too many arguments\n");
+			} else if (numargs > 0 && !strcasecmp(&cmdargs[argptrs[0]], "FOLDED")) {
+				if (numargs <= 2)
+					cmd_prof_report("FOLDED", 0, 0, numargs == 2 ? &cmdargs[argptrs[1]] : NULL);
+				else
+					printf("ERROR: too many arguments\n");
 			} else {
-				printf("ERROR: invalid breakpoint command\n");
+				// PROF [<seconds>] [RATE <hz>]
+				double seconds = 0;
+				unsigned long rate = PROF_DEFAULT_RATE;
+
+				for (i = 0; i < numargs; i++) {
+					if (!strcasecmp(&cmdargs[argptrs[i]], "RATE") && i + 1 < numargs)
+						rate = parse_long(&cmdargs[argptrs[++i]]);
+					else if (i == 0 && isdigit((unsigned char)cmdargs[argptrs[i]]))
+						seconds = strtod(&cmdargs[argptrs[i]], NULL);
+					else
+						break;
+				}
+				if (i < numargs)
+					printf("ERROR: usage: PROF [<seconds>] [RATE <hz>] | PROF DIS [<address> [<length>]] | PROF FUNC | PROF FOLDED [<file>]\n");
+				else
+					cmd_prof(seconds, rate);
+			}
+		}
+
+		else if (!strcmp(cmd, "REC")) {					// REC - record GSS runs step by step
+			last_cmd = LAST_CMD_NONE;
+			if (numargs == 0)
+				rec_status();
+			else if (numargs > 1)
+				printf("ERROR: too many arguments\n");
+			else if (!strcasecmp(&cmdargs[argptrs[0]], "OFF")) {
+				rec_stop();
+				printf("Not recording.\n\n");
 			}
+			else
+				rec_start(&cmdargs[argptrs[0]]);
+		}
+
+		else if (!strcmp(cmd, "SAVESTATE")) {				// SAVESTATE - checkpoint all PRUs to a file
+			last_cmd = LAST_CMD_NONE;
+			if (numargs == 1)
+				cmd_savestate(&cmdargs[argptrs[0]], 0);
+			else if (numargs == 2 && !strcasecmp(&cmdargs[argptrs[1]], "ZSTD"))
+				cmd_savestate(&cmdargs[argptrs[0]], 1);
+			else
+				printf("ERROR: incorrect arguments\n");
+		}
+
+		else if (!strcmp(cmd, "LOADSTATE")) {				// LOADSTATE - restore a checkpoint
+			last_cmd = LAST_CMD_NONE;
+			if (numargs == 1)
+				cmd_loadstate(&cmdargs[argptrs[0]]);
+			else
+				printf("ERROR: incorrect number of arguments\n");
 		}
 
 		else if (!strcmp(cmd, "CYCLE")) {				// CYCLE - Print/clear/[en|dis]able CYCLE counter
@@ -522,21 +733,32 @@ int main(int argc, char *argv[])
 			}
 		}
 
+		else if (!strcmp(cmd, "BENCH")) {					// BENCH - time memory reads
+			last_cmd = LAST_CMD_NONE;
+			if (numargs > 1)
+				printf("ERROR: too many arguments\n");
+			else
+				cmd_bench(numargs ? parse_long(&cmdargs[argptrs[0]]) : 0x10000);
+		}
+
 		else if (!strcmp(cmd, "DIS")) {						// DIS - disassemble command
 			if (numargs > 2) {
 				printf("ERROR: too many arguments\n");
 			} else {
+				long iaddr = 0;
 				if (numargs == 2) {
-					addr = parse_long(&cmdargs[argptrs[0]]);
+					iaddr = parse_iaddr(&cmdargs[argptrs[0]]);
 					len = parse_long(&cmdargs[argptrs[1]]);
 				} else if (numargs == 0) {
-					addr = 0;
 					len = 16;
 				} else {
-					addr = parse_long(&cmdargs[argptrs[0]]);
+					iaddr = parse_iaddr(&cmdargs[argptrs[0]]);
 					len = 16;
 				}
-				if ((addr > MAX_PRU_MEM - 1) || (addr+len > MAX_PRU_MEM)) {
+				addr = iaddr;
+				if (iaddr < 0) {
+					// unknown symbol, already reported
+				} else if ((addr > MAX_PRU_MEM - 1) || (addr+len > MAX_PRU_MEM)) {
 					printf("ERROR: arguments out of range.\n");
 				} else if (numargs > 2) {
 					printf("ERROR: Incorrect format.  Please use help command to get command details.\n");
@@ -596,7 +818,10 @@ int main(int argc, char *argv[])
 
 		else if (!strcmp(cmd, "L")) {					// L - Load PRU program
 			last_cmd = LAST_CMD_NONE;
-			if (numargs != 2) {
+			if (numargs == 1) {
+				// ELF files carry their own addresses
+				cmd_loadprog(0, &cmdargs[argptrs[0]]);
+			} else if (numargs != 2) {
 				printf("ERROR: incorrect number of arguments\n");
 			} else {
 				addr = parse_long(&cmdargs[argptrs[0]]);
@@ -612,6 +837,15 @@ int main(int argc, char *argv[])
 				select_pru(&pdb[pi], parse_long(&cmdargs[argptrs[0]]));
 			}
 		}
+		else if (!strcmp(cmd, "IRAM")) {				// IRAM - IRAM shadow status/resync/check
+			last_cmd = LAST_CMD_NONE;
+			if (numargs > 1) {
+				printf("ERROR: too many arguments\n");
+			} else {
+				cmd_iram(numargs ? &cmdargs[argptrs[0]] : NULL);
+			}
+		}
+
 		else if (!strcmp(cmd, "J")) {					// J  - Jump to instruction address
 			last_cmd = LAST_CMD_NONE;
 			if (numargs != 1) {
@@ -619,7 +853,11 @@ int main(int argc, char *argv[])
 			} else {
 				char* str = &cmdargs[argptrs[0]];
 				int address = (unsigned int)strtol(str, NULL, 0);
-				if(address < 0 || '+' == str[0]) {
+				if (isalpha((unsigned char)str[0]) || '_' == str[0]) {
+					long iaddr = parse_iaddr(str);
+					if (iaddr >= 0)
+						cmd_jump(iaddr);
+				} else if(address < 0 || '+' == str[0]) {
 					cmd_jump_relative(address);
 				} else {
 					cmd_jump(address);
@@ -714,7 +952,7 @@ int main(int argc, char *argv[])
 				} else {
 					printf("ERROR: breakpoint number must be equal to or between 0 and %u\n", MAX_WATCH-1);
 				}
-			} else if (numargs-4 > MAX_WATCH_LEN) {
+			} else if (numargs-3 > MAX_WATCH_LEN) {
 				printf("ERROR: too many watch values\n");
 			} else if (numargs >= 5) {
 				unsigned char vlist[MAX_WATCH_LEN];
@@ -728,7 +966,7 @@ int main(int argc, char *argv[])
 				}
 
 				if (wanum < MAX_WATCH) {
-					cmd_set_watch (wanum, addr, numargs - 4, vlist);
+					cmd_set_watch (wanum, addr, numargs - 3, vlist);
 				} else {
 					printf("ERROR: breakpoint number must be equal to or between 0 and %u\n", MAX_WATCH-1);
 				}
@@ -749,7 +987,7 @@ int main(int argc, char *argv[])
 				    (addr+numargs-1 > ((1+MAX_PRU_MEM)*4))) {
 					printf("ERROR: arguments out of range.\n");
 				} else {
-					unsigned char *pru_u8 = (unsigned char*)pru;
+					unsigned char byte;
 
 					/* The memory is examined byte per byte,
 					 * so multiply addresses by 4 */
@@ -761,25 +999,90 @@ int main(int argc, char *argv[])
 						offset = 0;
 					}
 					printf("Write to absolute address 0x%04x\n", offset+addr);
-					for (i=1; i<numargs; ++i)
-						pru_u8[offset+addr+i-1] =
-							(unsigned char)(parse_long(&cmdargs[argptrs[i]]) & 0xFF);
+					for (i=1; i<numargs; ++i) {
+						byte = parse_long(&cmdargs[argptrs[i]]) & 0xFF;
+						pru_write_block(offset+addr+i-1, &byte, 1);
+					}
+					iram_written(offset+addr, numargs-1);
 				}
 			}
 		}
 
+		else if (!strcmp(cmd, "WRF")) {					// WRF - write a file to data memory
+			last_cmd = LAST_CMD_NONE;
+			if (numargs != 2)
+				printf("ERROR: incorrect number of arguments\n");
+			else
+				cmd_wrf(parse_long(&cmdargs[argptrs[0]]), &cmdargs[argptrs[1]]);
+		}
+
+		else if (!strcmp(cmd, "FILL")) {				// FILL - fill data memory with a pattern
+			last_cmd = LAST_CMD_NONE;
+			if (numargs < 3 || numargs > 4)
+				printf("ERROR: incorrect number of arguments\n");
+			else
+				cmd_fill(parse_long(&cmdargs[argptrs[0]]), parse_long(&cmdargs[argptrs[1]]),
+					 parse_long(&cmdargs[argptrs[2]]),
+					 numargs == 4 ? parse_long(&cmdargs[argptrs[3]]) : 4);
+		}
+
+		else if (!strcmp(cmd, "COPY")) {				// COPY - copy within data memory
+			last_cmd = LAST_CMD_NONE;
+			if (numargs != 3)
+				printf("ERROR: incorrect number of arguments\n");
+			else
+				cmd_copy(parse_long(&cmdargs[argptrs[0]]), parse_long(&cmdargs[argptrs[1]]),
+					 parse_long(&cmdargs[argptrs[2]]));
+		}
+
+		else if (!strcmp(cmd, "SYM")) {					// SYM - load symbols or look up an address
+			last_cmd = LAST_CMD_NONE;
+			if (numargs != 1) {
+				printf("ERROR: incorrect number of arguments\n");
+			} else if (isdigit((unsigned char)cmdargs[argptrs[0]])) {
+				cmd_print_symbol(parse_long(&cmdargs[argptrs[0]]));
+			} else {
+				cmd_load_symbols(&cmdargs[argptrs[0]]);
+			}
+		}
+
 		else if (!strcmp(cmd, "TRACE")) {
 			last_cmd = LAST_CMD_NONE;
 			unsigned int k_elements = 1;
 			unsigned int on_halt = 1;
-			char const* filename = NULL;
-			if (numargs > 0)
-				k_elements = parse_long(&cmdargs[argptrs[0]]);
-			if (numargs > 1)
-				on_halt = parse_long(&cmdargs[argptrs[1]]);
-			if (numargs > 2)
-				filename = &cmdargs[argptrs[2]];
-			cmd_trace(k_elements, on_halt, filename);
+			if (numargs > 0 && !strcasecmp(&cmdargs[argptrs[0]], "STREAM")) {
+				// TRACE STREAM <file> [HALT] [CPU <n>] [FIFO]
+				struct trace_opts opts = { .on_halt = 0, .cpu = -1, .fifo = 0 };
+
+				for (i = 2; i < numargs; i++) {
+					if (!strcasecmp(&cmdargs[argptrs[i]], "HALT"))
+						opts.on_halt = 1;
+					else if (!strcasecmp(&cmdargs[argptrs[i]], "FIFO"))
+						opts.fifo = 1;
+					else if (!strcasecmp(&cmdargs[argptrs[i]], "CPU") && i + 1 < numargs)
+						opts.cpu = parse_long(&cmdargs[argptrs[++i]]);
+					else
+						break;
+				}
+				if (numargs < 2 || i < numargs)
+					printf("ERROR: usage: TRACE STREAM <file> [HALT] [CPU <n>] [FIFO]\n");
+				else
+					cmd_trace_stream(&cmdargs[argptrs[1]], &opts);
+			} else {
+				if (numargs > 0)
+					k_elements = parse_long(&cmdargs[argptrs[0]]);
+				if (numargs > 1)
+					on_halt = parse_long(&cmdargs[argptrs[1]]);
+				if (numargs > 2) {
+					// binary trace file (trace.h), prudis --trace converts it to text
+					struct trace_opts opts = { .on_halt = on_halt, .cpu = -1, .fifo = 0,
+								   .max_samples = k_elements * 1000ul };
+
+					cmd_trace_stream(&cmdargs[argptrs[2]], &opts);
+				} else {
+					cmd_trace(k_elements, on_halt);
+				}
+			}
 		}
 
 		else if (!strcmp(cmd, "Q")) {					// dummy so it's a valid command
@@ -813,6 +1116,7 @@ int main(int argc, char *argv[])
 	regfree(&reg_regex);
 	regfree(&rc_regex);
 	cmd_free();
+	pru_backend_close(pru_be);
 
 	return 0;
 }
@@ -27,15 +27,16 @@
 #define MAX_CMD_LEN		25
 #define MAX_CMDARGS_LEN		200
 #define MAX_COMMAND_LINE	(MAX_CMD_LEN + MAX_CMDARGS_LEN + 1)
-#define MAX_ARGS		10
+#define MAX_ARGS		32
 #define MAX_PRU_MEM		0xFFFF
 #define NUM_OF_PRU		2
 #define MAX_NUM_OF_PRUS		16					// maximum number of PRUs to expect in any processor
 #define MAX_BREAKPOINTS		10
-#define MAX_WATCH		10
-#define MAX_WATCH_LEN		32
+#define MAX_WATCH		256
+#define MAX_WATCH_LEN		4096					// bytes covered by one watch
 #define MAX_PROC_NAME		20
 #define NUM_REGS		32
+#define IRAM_MAX_LEN		0x1000					// largest instruction RAM of any processor, in 32-bit words
 
 // register offsets [4-byte word address offsets]
 #define PRU_CTRL_REG		0x0000
@@ -45,6 +46,11 @@
 #define PRU_INTGPR_REG		0x0100 // GPREG0
 #define PRU_INTCT_REG		0x0120 // CT_REG0
 
+// data memory windows as seen by the PRU itself [byte addresses]
+#define PRU_LOCAL_DRAM		0x00000	// own data RAM
+#define PRU_LOCAL_DRAM_OTHER	0x02000	// the other PRU's data RAM
+#define PRU_LOCAL_SHARED	0x10000	// shared data RAM
+
 // PRU control register bit flags
 #define PRU_REG_PCRESET_MASK	0x0000FFFF
 #define PRU_REG_RUNSTATE	0x00008000
@@ -56,11 +62,6 @@
 
 #define INST_HALT 0x2a000000
 
-// defines for PRU memory mapping method requeste by user
-#define ACCESS_GUESS		0
-#define ACCESS_UIO		1
-#define ACCESS_MEM		2
-
 // defines for command repeats
 #define LAST_CMD_NONE		0
 #define LAST_CMD_D		1
@@ -82,51 +83,85 @@
 
 
 // global structures
+
+// the PRUSS of the selected processor, as the backends lay it out
+struct pru_layout {
+	const char		*name;		// processor short name
+	unsigned long		address;	// physical address of the PRUSS
+	unsigned int		num_of_pruss;
+	unsigned int		pruss_len;	// bytes
+	unsigned int		iram_len;	// 32-bit words
+	unsigned int		dram_len;	// bytes
+	unsigned int		shared_base;	// 32-bit word offset
+	unsigned int		shared_len;	// bytes
+	unsigned int		inst_base[MAX_NUM_OF_PRUS];
+	unsigned int		data_base[MAX_NUM_OF_PRUS];
+	unsigned int		ctrl_base[MAX_NUM_OF_PRUS];
+};
+
+struct cond;
+
 struct breakpoints {
 	unsigned char		state;
 	unsigned char		hw;
 	unsigned int		address;
 	uint32_t		instruction;
+	struct cond		*cond;					// stop only if true, NULL for always
+	unsigned long		hits;					// times reached while running
 };
 
 struct watchvariable {
 	unsigned char		state;
 	unsigned int		address;
 	unsigned int		len;
-	unsigned char		value[MAX_WATCH_LEN];
-	unsigned char		old_value[MAX_WATCH_LEN];
+	unsigned char		*value;					// len bytes each, allocated when set
+	unsigned char		*old_value;
 };
 
 
 // global variables
-extern volatile unsigned int	*pru;
 extern unsigned int		pru_inst_base[], pru_ctrl_base[], pru_data_base[];
 extern unsigned int		pru_num;
+extern unsigned int		pru_iram_len;
+extern unsigned int		pru_dram_len, pru_shared_base, pru_shared_len;
+extern struct pru_layout	pruss_layout;
 extern struct breakpoints	bp[MAX_NUM_OF_PRUS][MAX_BREAKPOINTS];
 extern struct watchvariable	wa[MAX_NUM_OF_PRUS][MAX_WATCH];
 
 
 // function prototypes
 void cmd_print_breakpoints();
-void cmd_set_breakpoint (unsigned int bpnum, unsigned int addr, unsigned int hw);
+void cmd_set_breakpoint (unsigned int bpnum, unsigned int addr, unsigned int hw, struct cond *cond);
 void cmd_clear_breakpoint (unsigned int bpnum);
 int cmd_input(char *prompt, char *cmd, char *cmdargs, unsigned int *argptrs,
 	      unsigned int *numargs);
 void printhelp();
 void cmd_d (int offset, int addr, int len);
 void cmd_d_rows (int offset, int addr, int len);
+void cmd_bench(unsigned int len);
 void cmd_dx_rows (const char * prefix, unsigned char * data, int offset,
 		 int addr, int len);
 int cmd_loadprog(unsigned int addr, char *fn);
+int cmd_loadelf(char *fn);
+void cmd_wrf(unsigned int addr, const char *fn);
+void cmd_fill(unsigned int addr, unsigned int len, uint32_t value, unsigned int size);
+void cmd_copy(unsigned int src, unsigned int dst, unsigned int len);
+void cmd_load_symbols(const char *fn);
+void cmd_print_symbol(unsigned int addr);
+int parse_symbol(const char *str, unsigned int *addr);
 void cmd_run();
 void cmd_runss(long count);
 void cmd_single_step(unsigned int N);
-void cmd_trace(unsigned int k_elements, unsigned int on_halt, const char* filename);
+void cmd_trace(unsigned int k_elements, unsigned int on_halt);
 void cmd_halt();
 void cmd_jump(unsigned int addr);
 void cmd_jump_relative(int jump);
 void cmd_soft_reset();
 void cmd_dis (int offset, int addr, int len);
+void cmd_cfg(const char *format, const char *filename);
+void cmd_wcet(long from, long to, const char *filename);
+void cmd_lint();
+void cmd_stack(const char *elf_file);
 void disassemble(char *str, unsigned int len, unsigned int inst);
 
 void cmd_print_watch();
@@ -154,5 +189,70 @@ void cmd_free();
 void printhelp();
 void printhelpbrief();
 
+// IRAM shadow (iram.c)
+void iram_sync(unsigned int p);
+uint32_t iram_read(unsigned int addr);
+unsigned int iram_read_block(unsigned int addr, uint32_t *buf, unsigned int len);
+int iram_is_halt(unsigned int addr);
+void iram_write(unsigned int addr, const uint32_t *inst, unsigned int len);
+void iram_written(unsigned int addr, unsigned int len);
+uint32_t iram_patch(unsigned int addr, uint32_t inst);
+void iram_unpatch(unsigned int addr);
+unsigned int iram_check(unsigned int p);
+void cmd_iram(const char *op);
+
+// breakpoint conditions (cond.c)
+struct cond *cond_compile(const char *text);
+void cond_free(struct cond *c);
+const char *cond_text(const struct cond *c);
+int cond_eval(const struct cond *c, unsigned long hits);
+
+// streaming PC trace (trace.c)
+struct trace_opts {
+	int			on_halt;	// stop at a HALT instruction
+	int			cpu;		// core to pin the sampler to, -1 for any
+	int			fifo;		// run the sampler under SCHED_FIFO
+	unsigned long		max_samples;	// stop after this many, 0 for no limit
+};
+void trace_stream(const char *fn, const struct trace_opts *opts, volatile int *interrupted);
+void cmd_trace_stream(const char *fn, const struct trace_opts *opts);
+
+// statistical profiler (prof.c)
+#define PROF_DEFAULT_RATE	10000		// samples per second
+struct sym_index;
+void prof_run(double seconds, unsigned long rate, volatile int *interrupted);
+void prof_dis(const struct sym_index *syms, unsigned int addr, unsigned int len);
+void prof_funcs(const struct sym_index *syms);
+void prof_folded(const struct sym_index *syms, const char *fn);
+void prof_free();
+void cmd_prof(double seconds, unsigned long rate);
+void cmd_prof_report(const char *what, unsigned int addr, unsigned int len, const char *fn);
+
+// execution recording (record.c)
+int rec_active();
+void rec_start(const char *fn);
+void rec_stop();
+void rec_status();
+void rec_begin();
+int rec_step(unsigned int pc);
+void rec_end();
+
+// watch engine (watch.c)
+unsigned int watch_plan();
+int watch_step(unsigned int addr, unsigned long t);
+void watch_done();
+
+// software single-stepping (step.c)
+void step_break(unsigned int addr, int on);
+void step_break_clear_all();
+unsigned int step_break_count();
+void step_break_list();
+void step_run(long count, volatile int *interrupted);
+void step_run_stores(volatile int *interrupted);
+
+// PRU state checkpoints (state.c)
+void cmd_savestate(const char *fn, int compress);
+void cmd_loadstate(const char *fn);
+
 #endif // PRUDBG_H
 
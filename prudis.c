@@ -1,29 +1,1020 @@
-#include "prudbg.h"
+/*
+ *
+ *  PRU Debug Program - stand-alone disassembler
+ *
+ *  Disassembles a raw PRU instruction image.  Regular files are mmap()ed,
+ *  anything else (pipes, stdin) is streamed in large blocks, and the text is
+ *  collected in a large output buffer so that multi-megabyte captures cost a
+ *  handful of syscalls.  With -j the images are cut into chunks that are
+ *  disassembled on worker threads and written out in order.  With --trace
+ *  it converts binary PC traces (trace.h) to the text TRACE printed, and
+ *  with --rec it prints execution records (record.h) one step per line.
+ *
+ */
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <limits.h>
 
-int main(int argc, char *argv[])
+#include "prudbg.h"
+#include "cfg.h"
+#include "wcet.h"
+#include "lint.h"
+#include "stack.h"
+#include "pruelf.h"
+#include "trace.h"
+#include "record.h"
+
+#define PRUDIS_OUTBUF_LEN	(1 << 20)	// flushed with write() when full
+#define PRUDIS_INBUF_LEN	(1 << 16)	// block size when streaming
+#define PRUDIS_MAX_LINE		96		// worst case length of one output line
+#define PRUDIS_CHUNK_INSTS	16384		// instructions per worker chunk
+#define PRUDIS_MAX_JOBS		256
+
+struct outbuf {
+	int			fd;
+	size_t			pos;
+	size_t			size;
+	char			*buf;
+};
+
+// an input image, mapped or read into memory
+struct input {
+	const char		*name;
+	unsigned char		*data;
+	size_t			size;
+	int			mapped;
+};
+
+// a slice of an input handed to a worker; header is printed before it
+struct chunk {
+	const unsigned char	*data;
+	size_t			n;
+	unsigned long		addr;
+	const char		*header;
+};
+
+// output slot, chunk i is formatted into slot i % window
+struct slot {
+	struct outbuf		out;
+	int			done;
+};
+
+struct pool {
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+	struct chunk		*chunks;
+	size_t			nchunks;
+	size_t			next;		// next chunk to hand to a worker
+	size_t			emitted;	// chunks already written
+	size_t			window;
+	struct slot		*slots;
+	const struct prudis_opts *opts;
+};
+
+struct prudis_opts;
+
+// whole-image analysis run instead of the listing; base is the word
+// address of image[0]
+typedef int (*analysis_fn)(const uint32_t *image, uint32_t len, uint32_t base,
+			   const struct prudis_opts *opts);
+
+struct prudis_opts {
+	int			addr;		// print the word address column
+	int			hex;		// print the raw instruction column
+	unsigned long long	offset;		// first byte of the file to disassemble
+	unsigned long long	length;		// number of bytes, 0 for all
+	unsigned int		jobs;		// worker threads
+	analysis_fn		analysis;	// NULL for a plain listing
+	const char		*format;	// output format of the analysis
+	const char		*bounds;	// WCET annotation file
+	int			trace;		// files are PC traces, offset/length count samples
+	int			rec;		// files are execution records
+	unsigned long long	since;		// with trace: first sample at or after this ns
+	int			since_set;
+};
+
+static int out_flush(struct outbuf *o)
+{
+	size_t			done = 0;
+	ssize_t			r;
+
+	while (done < o->pos) {
+		r = write(o->fd, o->buf + done, o->pos - done);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("prudis: write");
+			return -1;
+		}
+		done += r;
+	}
+	o->pos = 0;
+	return 0;
+}
+
+static void out_str(struct outbuf *o, const char *s)
+{
+	size_t			len = strlen(s);
+
+	if (o->pos + len > o->size && out_flush(o))
+		return;
+	memcpy(o->buf + o->pos, s, len);
+	o->pos += len;
+}
+
+static char *put_hex(char *p, unsigned int v, int digits)
+{
+	static const char	hex[] = "0123456789abcdef";
+	int			i;
+
+	for (i = digits - 1; i >= 0; i--)
+		p[i] = hex[v & 0xF], v >>= 4;
+	return p + digits;
+}
+
+// disassemble n instructions from data, the first one at word address addr
+static int dis_block(struct outbuf *o, const unsigned char *data, size_t n,
+		     unsigned long addr, const struct prudis_opts *opts)
+{
+	unsigned int		inst;
+	char			*p;
+	size_t			i;
+
+	for (i = 0; i < n; i++, addr++) {
+		if (o->pos + PRUDIS_MAX_LINE > o->size && out_flush(o))
+			return -1;
+		memcpy(&inst, data + i * 4, 4);
+		p = o->buf + o->pos;
+		if (opts->addr) {
+			*p++ = '[';
+			*p++ = '0';
+			*p++ = 'x';
+			p = put_hex(p, addr, addr > 0xFFFF ? 8 : 4);
+			*p++ = ']';
+			*p++ = ' ';
+		}
+		if (opts->hex) {
+			*p++ = '0';
+			*p++ = 'x';
+			p = put_hex(p, inst, 8);
+			*p++ = ' ';
+		}
+		disassemble(p, PRUDIS_MAX_LINE - 32, inst);
+		p += strlen(p);
+		*p++ = '\n';
+		o->pos = p - o->buf;
+	}
+	return 0;
+}
+
+// clip the [offset, offset+length) slice of an input to whole instructions
+static size_t input_slice(const struct input *in, const struct prudis_opts *opts,
+			  const unsigned char **data)
+{
+	unsigned long long	len;
+
+	*data = in->data;
+	if (in->size <= opts->offset)
+		return 0;
+	len = in->size - opts->offset;
+	if (opts->length && opts->length < len)
+		len = opts->length;
+	*data = in->data + opts->offset;
+	return len / 4;
+}
+
+// map a regular file; returns 1 if it has to be streamed instead
+static int input_map(struct input *in, int fd)
+{
+	struct stat		st;
+
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+		return 1;
+	in->size = st.st_size;
+	in->data = NULL;
+	in->mapped = 1;
+	if (in->size == 0)
+		return 0;
+	in->data = mmap(NULL, in->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (in->data == MAP_FAILED)
+		return 1;
+	madvise(in->data, in->size, MADV_SEQUENTIAL);
+	return 0;
+}
+
+// read all of a descriptor that can't be mapped into memory
+static int input_slurp(struct input *in, int fd)
+{
+	size_t			cap = PRUDIS_INBUF_LEN;
+	unsigned char		*p;
+	ssize_t			r;
+
+	in->mapped = 0;
+	in->size = 0;
+	in->data = malloc(cap);
+	while (in->data) {
+		if (in->size == cap) {
+			cap *= 2;
+			p = realloc(in->data, cap);
+			if (!p) {
+				free(in->data);
+				in->data = NULL;
+				break;
+			}
+			in->data = p;
+		}
+		r = read(fd, in->data + in->size, cap - in->size);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0) {
+			perror("prudis: read");
+			free(in->data);
+			in->data = NULL;
+			return -1;
+		}
+		if (r == 0)
+			return 0;
+		in->size += r;
+	}
+	fprintf(stderr, "prudis: couldn't allocate memory\n");
+	return -1;
+}
+
+static void input_close(struct input *in)
 {
-	if(argc <= 1)
-	{
-		fprintf(stderr, "No file specified\n");
+	if (in->mapped && in->size)
+		munmap(in->data, in->size);
+	else if (!in->mapped)
+		free(in->data);
+}
+
+// disassemble from a descriptor that can't be mapped, one block at a time
+static int dis_stream(struct outbuf *o, int fd, const struct prudis_opts *opts)
+{
+	unsigned char		*buf;
+	unsigned long long	skip = opts->offset;
+	unsigned long long	left = opts->length ? opts->length : ~0ULL;
+	unsigned long		addr = opts->offset / 4;
+	size_t			have = 0, n;
+	ssize_t			r;
+	int			ret = 0;
+
+	buf = malloc(PRUDIS_INBUF_LEN);
+	if (!buf) {
+		fprintf(stderr, "prudis: couldn't allocate memory\n");
 		return -1;
 	}
-	char* file = argv[1];
-	int fd = open(file, O_RDONLY);
-	if(fd < 0)
-	{
+	while (left >= 4) {
+		r = read(fd, buf + have, PRUDIS_INBUF_LEN - have);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("prudis: read");
+			ret = -1;
+			break;
+		}
+		if (r == 0)
+			break;
+		have += r;
+		if (skip) {
+			n = skip < have ? skip : have;
+			memmove(buf, buf + n, have - n);
+			have -= n;
+			skip -= n;
+		}
+		n = have & ~(size_t)3;
+		if (n > left)
+			n = left & ~3ULL;
+		if (dis_block(o, buf, n / 4, addr, opts)) {
+			ret = -1;
+			break;
+		}
+		addr += n / 4;
+		left -= n;
+		memmove(buf, buf + n, have - n);
+		have -= n;
+	}
+	free(buf);
+	return ret;
+}
+
+static void *pool_worker(void *arg)
+{
+	struct pool		*p = arg;
+	struct chunk		*c;
+	struct slot		*sl;
+	size_t			i;
+
+	pthread_mutex_lock(&p->lock);
+	for (;;) {
+		while (p->next < p->nchunks && p->next >= p->emitted + p->window)
+			pthread_cond_wait(&p->cond, &p->lock);
+		if (p->next >= p->nchunks)
+			break;
+		i = p->next++;
+		pthread_mutex_unlock(&p->lock);
+
+		c = &p->chunks[i];
+		sl = &p->slots[i % p->window];
+		sl->out.pos = 0;
+		if (c->header)
+			out_str(&sl->out, c->header);
+		dis_block(&sl->out, c->data, c->n, c->addr, p->opts);
+
+		pthread_mutex_lock(&p->lock);
+		sl->done = 1;
+		pthread_cond_broadcast(&p->cond);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+// disassemble all chunks on opts->jobs threads, writing them out in order
+static int pool_run(struct chunk *chunks, size_t nchunks, const struct prudis_opts *opts)
+{
+	pthread_t		threads[PRUDIS_MAX_JOBS];
+	struct pool		p;
+	size_t			i, slot_len, max_n = 0, max_header = 0;
+	unsigned int		t, nthreads = 0;
+	int			r = 0;
+
+	memset(&p, 0, sizeof(p));
+	pthread_mutex_init(&p.lock, NULL);
+	pthread_cond_init(&p.cond, NULL);
+	p.chunks = chunks;
+	p.nchunks = nchunks;
+	p.window = 2 * opts->jobs < nchunks ? 2 * opts->jobs : nchunks;
+	p.opts = opts;
+	p.slots = calloc(p.window, sizeof(*p.slots));
+	// room for the longest header plus the largest chunk, so workers never flush
+	for (i = 0; i < nchunks; i++) {
+		if (chunks[i].n > max_n)
+			max_n = chunks[i].n;
+		if (chunks[i].header && strlen(chunks[i].header) > max_header)
+			max_header = strlen(chunks[i].header);
+	}
+	slot_len = (max_n + 2) * PRUDIS_MAX_LINE + max_header;
+	for (i = 0; p.slots && i < p.window; i++) {
+		p.slots[i].out.fd = -1;
+		p.slots[i].out.size = slot_len;
+		p.slots[i].out.buf = malloc(slot_len);
+		if (!p.slots[i].out.buf)
+			r = -1;
+	}
+	if (!p.slots || r) {
+		fprintf(stderr, "prudis: couldn't allocate memory\n");
+		r = -1;
+		goto cleanup;
+	}
+
+	for (t = 0; t < opts->jobs; t++) {
+		if (pthread_create(&threads[t], NULL, pool_worker, &p))
+			break;
+		nthreads++;
+	}
+	if (nthreads == 0) {
+		fprintf(stderr, "prudis: couldn't start worker threads\n");
+		r = -1;
+		goto cleanup;
+	}
+
+	for (i = 0; i < nchunks; i++) {
+		struct slot *sl = &p.slots[i % p.window];
+
+		pthread_mutex_lock(&p.lock);
+		while (!sl->done)
+			pthread_cond_wait(&p.cond, &p.lock);
+		pthread_mutex_unlock(&p.lock);
+
+		sl->out.fd = STDOUT_FILENO;
+		if (r == 0)
+			r = out_flush(&sl->out);
+		sl->out.fd = -1;
+
+		pthread_mutex_lock(&p.lock);
+		sl->done = 0;
+		p.emitted++;
+		pthread_cond_broadcast(&p.cond);
+		pthread_mutex_unlock(&p.lock);
+	}
+	for (t = 0; t < nthreads; t++)
+		pthread_join(threads[t], NULL);
+
+cleanup:
+	for (i = 0; p.slots && i < p.window; i++)
+		free(p.slots[i].out.buf);
+	free(p.slots);
+	pthread_cond_destroy(&p.cond);
+	pthread_mutex_destroy(&p.lock);
+	return r;
+}
+
+static int open_input(const char *file)
+{
+	int			fd;
+
+	if (!strcmp(file, "-"))
+		return STDIN_FILENO;
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
 		fprintf(stderr, "Couldn't open %s\n", file);
+	return fd;
+}
+
+// format the "name:" line printed before each file when there are several
+static char *file_header(const char *file, int first)
+{
+	char			*h = malloc(strlen(file) + 4);
+
+	if (h)
+		sprintf(h, "%s%s:\n", first ? "" : "\n", file);
+	return h;
+}
+
+// disassemble the files one after the other on the calling thread
+static int dis_files_serial(char **files, int nfiles, const struct prudis_opts *opts)
+{
+	struct outbuf		out;
+	struct input		in;
+	const unsigned char	*data;
+	char			*h;
+	size_t			n;
+	int			i, fd, r = 0;
+
+	out.fd = STDOUT_FILENO;
+	out.pos = 0;
+	out.size = PRUDIS_OUTBUF_LEN;
+	out.buf = malloc(PRUDIS_OUTBUF_LEN);
+	if (!out.buf) {
+		fprintf(stderr, "prudis: couldn't allocate memory\n");
+		return -1;
+	}
+
+	for (i = 0; i < nfiles && r == 0; i++) {
+		fd = open_input(files[i]);
+		if (fd < 0) {
+			r = -1;
+			break;
+		}
+		if (nfiles > 1 && (h = file_header(files[i], i == 0))) {
+			out_str(&out, h);
+			free(h);
+		}
+		if (input_map(&in, fd) == 0) {
+			n = input_slice(&in, opts, &data);
+			r = dis_block(&out, data, n, opts->offset / 4, opts);
+			input_close(&in);
+		} else {
+			// not a regular file or mmap() failed: stream it
+			r = dis_stream(&out, fd, opts);
+		}
+		if (fd != STDIN_FILENO)
+			close(fd);
+	}
+	if (r == 0)
+		r = out_flush(&out);
+
+	free(out.buf);
+	return r;
+}
+
+// load every file, cut them into chunks and hand those to the worker pool
+static int dis_files_parallel(char **files, int nfiles, const struct prudis_opts *opts)
+{
+	struct input		*in;
+	struct chunk		*chunks = NULL, *c;
+	char			**headers;
+	const unsigned char	*data;
+	size_t			nchunks = 0, cap = 0, n, k;
+	int			i, fd, r = 0, loaded = 0;
+
+	in = calloc(nfiles, sizeof(*in));
+	headers = calloc(nfiles, sizeof(*headers));
+	if (!in || !headers) {
+		fprintf(stderr, "prudis: couldn't allocate memory\n");
+		r = -1;
+		goto cleanup;
+	}
+
+	for (i = 0; i < nfiles && r == 0; i++) {
+		fd = open_input(files[i]);
+		if (fd < 0) {
+			r = -1;
+			break;
+		}
+		in[i].name = files[i];
+		if (input_map(&in[i], fd))
+			r = input_slurp(&in[i], fd);
+		if (fd != STDIN_FILENO)
+			close(fd);
+		if (r)
+			break;
+		loaded++;
+
+		if (nfiles > 1)
+			headers[i] = file_header(files[i], i == 0);
+		n = input_slice(&in[i], opts, &data);
+		k = 0;
+		do {
+			if (nchunks == cap) {
+				cap = cap ? 2 * cap : 64;
+				c = realloc(chunks, cap * sizeof(*chunks));
+				if (!c) {
+					fprintf(stderr, "prudis: couldn't allocate memory\n");
+					r = -1;
+					break;
+				}
+				chunks = c;
+			}
+			c = &chunks[nchunks++];
+			c->data = data + k * 4;
+			c->n = n - k < PRUDIS_CHUNK_INSTS ? n - k : PRUDIS_CHUNK_INSTS;
+			c->addr = opts->offset / 4 + k;
+			c->header = k == 0 ? headers[i] : NULL;
+			k += c->n;
+		} while (k < n);
+	}
+
+	if (r == 0)
+		r = pool_run(chunks, nchunks, opts);
+
+cleanup:
+	for (i = 0; i < loaded; i++)
+		input_close(&in[i]);
+	for (i = 0; headers && i < nfiles; i++)
+		free(headers[i]);
+	free(headers);
+	free(chunks);
+	free(in);
+	return r;
+}
+
+static int analysis_cfg(const uint32_t *image, uint32_t len, uint32_t base,
+			const struct prudis_opts *opts)
+{
+	struct cfg		g;
+
+	if (cfg_build(&g, image, len, base))
+		return -1;
+	if (!strcasecmp(opts->format, "json"))
+		cfg_write_json(stdout, &g);
+	else
+		cfg_write_dot(stdout, &g);
+	cfg_free(&g);
+	return 0;
+}
+
+// format is "all" or "from:to" in instruction word addresses
+static int analysis_wcet(const uint32_t *image, uint32_t len, uint32_t base,
+			 const struct prudis_opts *opts)
+{
+	struct wcet_opts	o = {0};
+	struct cfg		g;
+	unsigned long		from = CFG_NONE, to = 0;
+	char			*end;
+	int			r = -1;
+
+	if (strcasecmp(opts->format, "all")) {
+		from = strtoul(opts->format, &end, 0);
+		if (*end != ':' || (to = strtoul(end + 1, &end, 0), *end)) {
+			fprintf(stderr, "prudis: --wcet expects all or <from>:<to>\n");
+			return -1;
+		}
+	}
+	if (opts->bounds && wcet_load(&o, opts->bounds))
+		goto cleanup;
+	if (cfg_build(&g, image, len, base))
+		goto cleanup;
+	r = wcet_report(stdout, &g, &o, from, to);
+	cfg_free(&g);
+cleanup:
+	wcet_free(&o);
+	return r;
+}
+
+// lint the image; returns 1 if there is anything to report so that a
+// build can fail on it
+static int analysis_lint(const uint32_t *image, uint32_t len, uint32_t base,
+			 const struct prudis_opts *opts)
+{
+	struct cfg		g;
+	int			r;
+
+	if (cfg_build(&g, image, len, base))
+		return -1;
+	r = lint_report(stdout, &g);
+	cfg_free(&g);
+	return r > 0 ? 1 : r;
+}
+
+static int analysis_stack(const uint32_t *image, uint32_t len, uint32_t base,
+			  const struct prudis_opts *opts)
+{
+	struct cfg		g;
+	uint32_t		depth;
+	int			r;
+
+	if (cfg_build(&g, image, len, base))
+		return -1;
+	r = stack_report(stdout, &g, &depth);
+	cfg_free(&g);
+	return r;
+}
+
+// the code segments of a PRU ELF executable as one image, gaps zeroed;
+// returns the number of instructions, -1 on errors
+static long elf_image(const char *file, uint32_t **image, uint32_t *base)
+{
+	struct pru_elf		e;
+	const Elf32_Phdr	*ph;
+	uint32_t		lo = CFG_NONE, hi = 0, addr;
+	unsigned int		i;
+
+	if (pru_elf_open(&e, file))
+		return -1;
+	for (i = 0; i < e.eh->e_phnum; i++) {
+		ph = &e.ph[i];
+		if (ph->p_type != PT_LOAD || !pru_elf_is_code(ph) || !ph->p_filesz)
+			continue;
+		addr = pru_elf_addr(ph);
+		if ((addr & 3) || (ph->p_filesz & 3) || ph->p_offset + (size_t)ph->p_filesz > e.size) {
+			fprintf(stderr, "prudis: %s: bad code segment %u\n", file, i);
+			pru_elf_close(&e);
+			return -1;
+		}
+		if (addr / 4 < lo)
+			lo = addr / 4;
+		if ((addr + ph->p_filesz) / 4 > hi)
+			hi = (addr + ph->p_filesz) / 4;
+	}
+	if (lo >= hi) {
+		fprintf(stderr, "prudis: %s has no code\n", file);
+		pru_elf_close(&e);
+		return -1;
+	}
+	*image = calloc(hi - lo + 1, sizeof(uint32_t));
+	if (!*image) {
+		fprintf(stderr, "prudis: couldn't allocate memory\n");
+		pru_elf_close(&e);
+		return -1;
+	}
+	for (i = 0; i < e.eh->e_phnum; i++) {
+		ph = &e.ph[i];
+		if (ph->p_type == PT_LOAD && pru_elf_is_code(ph) && ph->p_filesz)
+			memcpy(*image + pru_elf_addr(ph) / 4 - lo, e.data + ph->p_offset, ph->p_filesz);
+	}
+	pru_elf_close(&e);
+	*base = lo;
+	return hi - lo;
+}
+
+// load each file whole and run opts->analysis over its slice, or over the
+// code of an ELF file; stops at the first error and otherwise returns the
+// largest result
+static int analyze_files(char **files, int nfiles, const struct prudis_opts *opts)
+{
+	struct input		in;
+	const unsigned char	*data;
+	uint32_t		*image, base;
+	size_t			n;
+	long			elf_n;
+	int			i, fd, r = 0, worst = 0;
+
+	for (i = 0; i < nfiles && r >= 0; i++) {
+		r = 0;
+		if (strcmp(files[i], "-") && pru_elf_is_elf(files[i])) {
+			elf_n = elf_image(files[i], &image, &base);
+			if (elf_n < 0)
+				return -1;
+			if (nfiles > 1)
+				printf("%s%s:\n", i ? "\n" : "", files[i]);
+			r = opts->analysis(image, elf_n, base, opts);
+			free(image);
+			if (r > worst)
+				worst = r;
+			continue;
+		}
+		fd = open_input(files[i]);
+		if (fd < 0)
+			return -1;
+		if (input_map(&in, fd))
+			r = input_slurp(&in, fd);
+		if (fd != STDIN_FILENO)
+			close(fd);
+		if (r)
+			break;
+		n = input_slice(&in, opts, &data);
+		// the slice may start at any byte, so copy it out aligned
+		image = malloc(n * 4 + 4);
+		if (!image) {
+			fprintf(stderr, "prudis: couldn't allocate memory\n");
+			r = -1;
+		} else {
+			memcpy(image, data, n * 4);
+			if (nfiles > 1)
+				printf("%s%s:\n", i ? "\n" : "", files[i]);
+			r = opts->analysis(image, n, opts->offset / 4, opts);
+			free(image);
+		}
+		input_close(&in);
+		if (r > worst)
+			worst = r;
+	}
+	fflush(stdout);
+	return r < 0 ? r : worst;
+}
+
+// print each trace as one "0x%04x" PC per line, seeking through its index
+static int trace_files(char **files, int nfiles, const struct prudis_opts *opts)
+{
+	struct tracefile_reader	tr;
+	struct pru_trace_record	rec;
+	struct outbuf		out;
+	unsigned long long	left;
+	char			line[8], *h;
+	int			i, k, r = 0;
+
+	out.fd = STDOUT_FILENO;
+	out.pos = 0;
+	out.size = PRUDIS_OUTBUF_LEN;
+	out.buf = malloc(PRUDIS_OUTBUF_LEN);
+	if (!out.buf) {
+		fprintf(stderr, "prudis: couldn't allocate memory\n");
+		return -1;
+	}
+	line[0] = '0';
+	line[1] = 'x';
+	line[6] = '\n';
+	line[7] = 0;
+	for (i = 0; i < nfiles && r == 0; i++) {
+		if (tracefile_open(&tr, files[i])) {
+			fprintf(stderr, "prudis: %s: not a PC trace: %s\n", files[i], strerror(errno));
+			r = -1;
+			break;
+		}
+		if (nfiles > 1 && (h = file_header(files[i], i == 0))) {
+			out_str(&out, h);
+			free(h);
+		}
+		// nothing to print if the seek runs past the end
+		left = opts->length ? opts->length : ~0ULL;
+		if ((opts->since_set && tracefile_seek_time(&tr, opts->since)) ||
+		    (!opts->since_set && opts->offset && tracefile_seek_sample(&tr, opts->offset)))
+			left = 0;
+		k = 0;
+		while (left-- && (k = tracefile_next(&tr, &rec)) == 1) {
+			put_hex(line + 2, rec.pc, 4);
+			if (out.pos + sizeof(line) > out.size && out_flush(&out)) {
+				r = -1;
+				break;
+			}
+			memcpy(out.buf + out.pos, line, 7);
+			out.pos += 7;
+		}
+		if (k < 0) {
+			fprintf(stderr, "prudis: %s: trace is damaged\n", files[i]);
+			r = -1;
+		}
+		tracefile_close(&tr);
+	}
+	if (out_flush(&out))
+		r = -1;
+	free(out.buf);
+	return r;
+}
+
+// print an execution record: the state before the first step, then the
+// PC and changed registers of each step, "=" lines for changes between runs
+static int rec_print(const struct input *in, const char *name)
+{
+	struct pru_rec_header	h;
+	const unsigned char	*p, *end;
+	uint32_t		regs[32], mask, d;
+	unsigned int		pc, tag, n, i, k, shift;
+	uint64_t		step = 0;
+
+	if (in->size < sizeof(h)) {
+		fprintf(stderr, "prudis: %s: not an execution record\n", name);
+		return -1;
+	}
+	memcpy(&h, in->data, sizeof(h));
+	if (memcmp(h.magic, PRU_REC_MAGIC, sizeof(h.magic)) || h.version != PRU_REC_VERSION ||
+	    h.header_len > in->size || h.data_len > in->size - h.header_len) {
+		fprintf(stderr, "prudis: %s: not an execution record\n", name);
 		return -1;
 	}
-	unsigned int instruction;
-	char str[50];
-	while(sizeof(instruction) == read(fd, &instruction, sizeof(instruction)))
-	{
-		disassemble(str, sizeof(str), instruction);
-		printf("%s\n", str);
+	memcpy(regs, h.regs, sizeof(regs));
+	pc = h.pc;
+	printf("PRU%u %s, %llu steps\n", h.pru, h.processor, (unsigned long long)h.steps);
+	printf("start 0x%04x", pc);
+	for (i = 0; i < 32; i++)
+		printf(" R%u=0x%08x", i, regs[i]);
+	printf("\n");
+	p = in->data + h.header_len;
+	end = p + h.data_len;
+	while (p < end) {
+		tag = *p++;
+		n = tag & PRU_REC_COUNT;
+		if (tag & PRU_REC_PC) {
+			if (end - p < 2)
+				goto damaged;
+			pc = p[0] | p[1] << 8;
+			p += 2;
+		} else {
+			pc = (pc + 1) & 0xFFFF;
+		}
+		mask = 0;
+		if (n <= PRU_REC_MAX_INDEX) {
+			for (i = 0; i < n; i++) {
+				if (p == end || *p > 31)
+					goto damaged;
+				mask |= 1u << *p++;
+			}
+		} else {
+			if (end - p < 4)
+				goto damaged;
+			mask = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+			p += 4;
+		}
+		if (tag & PRU_REC_SYNC)
+			printf("= 0x%04x", pc);
+		else
+			printf("%llu 0x%04x", (unsigned long long)++step, pc);
+		for (i = 0; i < 32; i++) {
+			if (!(mask & (1u << i)))
+				continue;
+			for (d = 0, shift = 0, k = 0x80; k & 0x80; shift += 7) {
+				if (p == end || shift > 28)
+					goto damaged;
+				k = *p++;
+				d |= (uint32_t)(k & 0x7F) << shift;
+			}
+			regs[i] += (d >> 1) ^ -(d & 1);
+			printf(" R%u=0x%08x", i, regs[i]);
+		}
+		printf("\n");
 	}
 	return 0;
+damaged:
+	printf("\n");
+	fprintf(stderr, "prudis: %s: record is damaged after %llu steps\n", name, (unsigned long long)step);
+	return -1;
+}
+
+static int rec_files(char **files, int nfiles)
+{
+	struct input		in;
+	int			i, fd, r = 0;
+
+	for (i = 0; i < nfiles && r == 0; i++) {
+		fd = open_input(files[i]);
+		if (fd < 0)
+			return -1;
+		if (input_map(&in, fd))
+			r = input_slurp(&in, fd);
+		if (fd != STDIN_FILENO)
+			close(fd);
+		if (r)
+			break;
+		if (nfiles > 1)
+			printf("%s%s:\n", i ? "\n" : "", files[i]);
+		r = rec_print(&in, files[i]);
+		input_close(&in);
+	}
+	fflush(stdout);
+	return r;
 }
 
+static void usage()
+{
+	fprintf(stderr, "Usage: prudis [-j jobs] [--addr] [--hex] [--offset bytes] [--length bytes]\n");
+	fprintf(stderr, "              [--cfg dot|json] [--wcet all|from:to [--bounds file]] [--lint] [--stack]\n");
+	fprintf(stderr, "              [file ...]\n");
+	fprintf(stderr, "       prudis --trace [--offset samples] [--length samples] [--since ns] [file ...]\n");
+	fprintf(stderr, "       prudis --rec [file ...]\n");
+	fprintf(stderr, "    -a, --addr   - prefix each instruction with its 32-bit word address\n");
+	fprintf(stderr, "    -x, --hex    - prefix each instruction with its raw encoding\n");
+	fprintf(stderr, "    -s, --offset - byte offset of the first instruction in each file\n");
+	fprintf(stderr, "    -l, --length - number of bytes to disassemble (default: to the end)\n");
+	fprintf(stderr, "    -j, --jobs   - number of worker threads (default: 1, 0 = one per CPU, at most one per CPU)\n");
+	fprintf(stderr, "    --cfg        - print the control-flow and call graph instead of a listing\n");
+	fprintf(stderr, "    --wcet       - print worst-case cycle counts, and the worst path from:to\n");
+	fprintf(stderr, "    --bounds     - WCET annotations: \"loop <addr> <count>\", \"mem <addr> <len> <cycles>\"\n");
+	fprintf(stderr, "    --lint       - flag stall-prone code with estimated cycle costs, exit 1 if any\n");
+	fprintf(stderr, "    --stack      - print the worst R2 stack depth per function and entry point\n");
+	fprintf(stderr, "    --trace      - print binary PC traces written by TRACE as one PC per line\n");
+	fprintf(stderr, "    --since      - with --trace, start at the first sample at or after ns\n");
+	fprintf(stderr, "    --rec        - print execution records written by REC, one step per line\n");
+	fprintf(stderr, "    analyses also take PRU ELF executables, the listing takes raw images only\n");
+	fprintf(stderr, "    if no file is given or file is \"-\" the image is read from stdin\n");
+	fprintf(stderr, "    with several files each listing is preceded by a \"file:\" line\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_opts[] = {
+		{"addr",	no_argument,		NULL, 'a'},
+		{"hex",		no_argument,		NULL, 'x'},
+		{"offset",	required_argument,	NULL, 's'},
+		{"length",	required_argument,	NULL, 'l'},
+		{"jobs",	required_argument,	NULL, 'j'},
+		{"cfg",		required_argument,	NULL, 'G'},
+		{"wcet",	required_argument,	NULL, 'W'},
+		{"bounds",	required_argument,	NULL, 'B'},
+		{"lint",	no_argument,		NULL, 'L'},
+		{"stack",	no_argument,		NULL, 'S'},
+		{"trace",	no_argument,		NULL, 'T'},
+		{"since",	required_argument,	NULL, 't'},
+		{"rec",		no_argument,		NULL, 'R'},
+		{"help",	no_argument,		NULL, 'h'},
+		{NULL,		0,			NULL, 0}
+	};
+	struct prudis_opts	opts = {0};
+	char			*stdin_file[] = {"-"};
+	char			**files = stdin_file;
+	int			nfiles = 1;
+	int			opt;
+	long			ncpu;
+
+	opts.jobs = 1;
+	while ((opt = getopt_long(argc, argv, "axs:l:j:h", long_opts, NULL)) != -1) {
+		switch (opt) {
+			case 'a':
+				opts.addr = 1;
+				break;
+			case 'x':
+				opts.hex = 1;
+				break;
+			case 's':
+				opts.offset = strtoull(optarg, NULL, 0);
+				break;
+			case 'l':
+				opts.length = strtoull(optarg, NULL, 0);
+				break;
+			case 'j':
+				opts.jobs = strtoul(optarg, NULL, 0);
+				// more threads than CPUs only costs output slots
+				ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+				if (opts.jobs == 0 || (ncpu > 0 && opts.jobs > ncpu))
+					opts.jobs = ncpu > 0 ? ncpu : 1;
+				if (opts.jobs > PRUDIS_MAX_JOBS)
+					opts.jobs = PRUDIS_MAX_JOBS;
+				break;
+			case 'G':
+				opts.analysis = analysis_cfg;
+				opts.format = optarg;
+				break;
+			case 'W':
+				opts.analysis = analysis_wcet;
+				opts.format = optarg;
+				break;
+			case 'B':
+				opts.bounds = optarg;
+				break;
+			case 'L':
+				opts.analysis = analysis_lint;
+				break;
+			case 'S':
+				opts.analysis = analysis_stack;
+				break;
+			case 'T':
+				opts.trace = 1;
+				break;
+			case 'R':
+				opts.rec = 1;
+				break;
+			case 't':
+				opts.since = strtoull(optarg, NULL, 0);
+				opts.since_set = 1;
+				break;
+			case 'h':
+			default:
+				usage();
+				return -1;
+		}
+	}
+	if (optind < argc) {
+		files = &argv[optind];
+		nfiles = argc - optind;
+	}
+
+	if (opts.trace)
+		return trace_files(files, nfiles, &opts);
+	if (opts.rec)
+		return rec_files(files, nfiles);
+	if (opts.analysis)
+		return analyze_files(files, nfiles, &opts);
+	if (opts.jobs > 1)
+		return dis_files_parallel(files, nfiles, &opts);
+	return dis_files_serial(files, nfiles, &opts);
+}
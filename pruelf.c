@@ -0,0 +1,122 @@
+/*
+ *
+ *  PRU Debug Program - PRU ELF file access
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pruelf.h"
+
+// true if fn starts with the ELF magic
+int pru_elf_is_elf(const char *fn)
+{
+	unsigned char		magic[SELFMAG];
+	int			f, r;
+
+	f = open(fn, O_RDONLY);
+	if (f == -1)
+		return 0;
+	r = read(f, magic, SELFMAG) == SELFMAG && !memcmp(magic, ELFMAG, SELFMAG);
+	close(f);
+	return r;
+}
+
+static int check_headers(struct pru_elf *e)
+{
+	const Elf32_Ehdr	*eh = e->eh;
+
+	if (e->size < sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG)) {
+		printf("ERROR: not an ELF file\n");
+		return -1;
+	}
+	if (eh->e_ident[EI_CLASS] != ELFCLASS32 || eh->e_ident[EI_DATA] != ELFDATA2LSB) {
+		printf("ERROR: not a 32-bit little-endian ELF file\n");
+		return -1;
+	}
+	if (eh->e_machine != EM_TI_PRU) {
+		printf("ERROR: ELF file is not for the PRU (machine %u)\n", eh->e_machine);
+		return -1;
+	}
+	if (eh->e_phnum && (eh->e_phentsize != sizeof(Elf32_Phdr) ||
+			    eh->e_phoff + (size_t)eh->e_phnum * sizeof(Elf32_Phdr) > e->size)) {
+		printf("ERROR: bad ELF program headers\n");
+		return -1;
+	}
+	if (eh->e_shnum && (eh->e_shentsize != sizeof(Elf32_Shdr) ||
+			    eh->e_shoff + (size_t)eh->e_shnum * sizeof(Elf32_Shdr) > e->size ||
+			    eh->e_shstrndx >= eh->e_shnum)) {
+		printf("ERROR: bad ELF section headers\n");
+		return -1;
+	}
+	return 0;
+}
+
+// map fn and validate it as a PRU executable
+int pru_elf_open(struct pru_elf *e, const char *fn)
+{
+	struct stat		st;
+	const Elf32_Shdr	*strtab;
+	void			*p;
+	int			f;
+
+	memset(e, 0, sizeof(*e));
+	f = open(fn, O_RDONLY);
+	if (f == -1 || fstat(f, &st)) {
+		printf("ERROR: could not open file\n");
+		if (f != -1)
+			close(f);
+		return -1;
+	}
+	p = st.st_size ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, f, 0) : MAP_FAILED;
+	close(f);
+	if (p == MAP_FAILED) {
+		printf("ERROR: could not map file\n");
+		return -1;
+	}
+	e->data = p;
+	e->size = st.st_size;
+	e->eh = p;
+	if (check_headers(e)) {
+		pru_elf_close(e);
+		return -1;
+	}
+	e->ph = (const Elf32_Phdr *)(e->data + e->eh->e_phoff);
+	if (e->eh->e_shnum) {
+		e->sh = (const Elf32_Shdr *)(e->data + e->eh->e_shoff);
+		strtab = &e->sh[e->eh->e_shstrndx];
+		if (strtab->sh_offset + strtab->sh_size <= e->size)
+			e->shstr = (const char *)e->data + strtab->sh_offset;
+	}
+	return 0;
+}
+
+void pru_elf_close(struct pru_elf *e)
+{
+	if (e->data)
+		munmap((void *)e->data, e->size);
+	memset(e, 0, sizeof(*e));
+}
+
+// section header by name, NULL if absent or out of the file
+const Elf32_Shdr *pru_elf_section(const struct pru_elf *e, const char *name)
+{
+	unsigned int		i;
+
+	if (!e->sh || !e->shstr)
+		return NULL;
+	for (i = 0; i < e->eh->e_shnum; i++) {
+		if (strcmp(e->shstr + e->sh[i].sh_name, name))
+			continue;
+		if (e->sh[i].sh_type != SHT_NOBITS &&
+		    e->sh[i].sh_offset + (size_t)e->sh[i].sh_size > e->size)
+			return NULL;
+		return &e->sh[i];
+	}
+	return NULL;
+}
@@ -0,0 +1,55 @@
+/*
+ *
+ *  PRU Debug Program - PRU ELF file access header file
+ *
+ *  Firmware built with clpru or pru-gcc is mapped read-only and its
+ *  headers are used in place.  Code lives in its own address space: clpru
+ *  marks it with PF_X, pru-gcc additionally puts it at PRU_ELF_IMEM.
+ *
+ */
+
+#ifndef PRUELF_H
+#define PRUELF_H
+#include <stddef.h>
+#include <stdint.h>
+#include <elf.h>
+
+#ifndef EM_TI_PRU
+#define EM_TI_PRU		144
+#endif
+
+#define PRU_ELF_IMEM		0x20000000	// pru-gcc instruction memory origin
+
+struct pru_elf {
+	const unsigned char	*data;
+	size_t			size;
+	const Elf32_Ehdr	*eh;
+	const Elf32_Phdr	*ph;		// e_phnum entries
+	const Elf32_Shdr	*sh;		// e_shnum entries, may be NULL
+	const char		*shstr;		// section name strings
+};
+
+int pru_elf_is_elf(const char *fn);
+int pru_elf_open(struct pru_elf *e, const char *fn);
+void pru_elf_close(struct pru_elf *e);
+const Elf32_Shdr *pru_elf_section(const struct pru_elf *e, const char *name);
+
+// segment goes to instruction memory
+static inline int pru_elf_is_code(const Elf32_Phdr *ph)
+{
+	return (ph->p_flags & PF_X) || ph->p_paddr >= PRU_ELF_IMEM;
+}
+
+// byte address within the segment's own memory
+static inline uint32_t pru_elf_addr(const Elf32_Phdr *ph)
+{
+	return ph->p_paddr & ~PRU_ELF_IMEM;
+}
+
+// entry point as an instruction word address
+static inline uint32_t pru_elf_entry(const struct pru_elf *e)
+{
+	return (e->eh->e_entry & ~PRU_ELF_IMEM) / 4;
+}
+
+#endif // PRUELF_H
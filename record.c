@@ -0,0 +1,215 @@
+/*
+ *
+ *  PRU Debug Program - execution recording
+ *
+ *  With REC on, every step of a GSS run reads R0-R31 of the halted PRU in
+ *  one block read, compares them with the registers after the previous
+ *  step and appends only the changes to an arena in the format of
+ *  record.h.  The arena doubles when it fills, so a million-step run
+ *  needs a few megabytes.  The whole record is written to the file at the
+ *  end of each run, so it always holds the history up to the last stop.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "prudbg.h"
+#include "backend.h"
+#include "record.h"
+
+#define REC_ARENA_START		(1u << 20)
+#define REC_MAX_ENTRY		(3 + 4 + 32 * 5)	// tag, PC, mask, values
+
+struct rec {
+	char			*fn;
+	struct pru_rec_header	h;
+	unsigned char		*arena;
+	size_t			len, alloc;
+	uint32_t		regs[32];	// after the last entry
+	uint32_t		pc;
+	int			started;
+};
+
+static struct rec		rec;
+
+int rec_active()
+{
+	return rec.fn != NULL;
+}
+
+static void read_regs(uint32_t *regs)
+{
+	pru_read_block((pru_ctrl_base[pru_num] + PRU_INTGPR_REG) * 4, regs, 32 * sizeof(uint32_t));
+}
+
+static inline unsigned char *put_varint(unsigned char *p, uint32_t v)
+{
+	while (v >= 0x80) {
+		*p++ = v | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+// append the entry taking the record from its state to (pc, regs); 0 if
+// the arena could not grow
+static int rec_entry(unsigned int pc, const uint32_t *regs, int sync)
+{
+	unsigned char		*p, *a;
+	uint32_t		mask = 0, d;
+	unsigned int		i, n;
+
+	if (rec.len + REC_MAX_ENTRY > rec.alloc) {
+		a = realloc(rec.arena, rec.alloc * 2);
+		if (!a)
+			return 0;
+		rec.arena = a;
+		rec.alloc *= 2;
+	}
+	for (i = 0; i < 32; i++) {
+		if (regs[i] != rec.regs[i])
+			mask |= 1u << i;
+	}
+	n = __builtin_popcount(mask);
+	if (sync && !mask && pc == rec.pc)
+		return 1;
+	p = rec.arena + rec.len;
+	*p++ = n | (pc != rec.pc + 1 || sync ? PRU_REC_PC : 0) | (sync ? PRU_REC_SYNC : 0);
+	if (p[-1] & PRU_REC_PC) {
+		*p++ = pc;
+		*p++ = pc >> 8;
+	}
+	if (n <= PRU_REC_MAX_INDEX) {
+		for (i = 0; i < 32; i++) {
+			if (mask & (1u << i))
+				*p++ = i;
+		}
+	} else {
+		for (i = 0; i < 4; i++)
+			*p++ = mask >> (8 * i);
+	}
+	for (i = 0; i < 32; i++) {
+		if (!(mask & (1u << i)))
+			continue;
+		d = regs[i] - rec.regs[i];
+		p = put_varint(p, (d << 1) ^ -(d >> 31));
+		rec.regs[i] = regs[i];
+	}
+	rec.pc = pc;
+	rec.len = p - rec.arena;
+	if (!sync)
+		rec.h.steps++;
+	return 1;
+}
+
+// REC <file>: record the GSS runs that follow into fn
+void rec_start(const char *fn)
+{
+	rec_stop();
+	rec.arena = malloc(REC_ARENA_START);
+	rec.fn = strdup(fn);
+	if (!rec.arena || !rec.fn) {
+		printf("ERROR: out of memory\n");
+		rec_stop();
+		return;
+	}
+	rec.alloc = REC_ARENA_START;
+	printf("Recording GSS runs of PRU%u to %s\n\n", pru_num, fn);
+}
+
+// REC OFF
+void rec_stop()
+{
+	free(rec.arena);
+	free(rec.fn);
+	memset(&rec, 0, sizeof(rec));
+}
+
+// a stepping run of the halted active PRU begins
+void rec_begin()
+{
+	uint32_t		regs[32];
+	unsigned int		pc = pru_ctrl_read(pru_num, PRU_STATUS_REG) & 0xFFFF;
+
+	read_regs(regs);
+	if (!rec.started) {
+		memset(&rec.h, 0, sizeof(rec.h));
+		memcpy(rec.h.magic, PRU_REC_MAGIC, sizeof(rec.h.magic));
+		rec.h.version = PRU_REC_VERSION;
+		rec.h.header_len = sizeof(rec.h);
+		rec.h.pru = pru_num;
+		rec.h.pc = pc;
+		rec.h.time = time(NULL);
+		memcpy(rec.h.regs, regs, sizeof(regs));
+		snprintf(rec.h.processor, sizeof(rec.h.processor), "%s", pruss_layout.name);
+		memcpy(rec.regs, regs, sizeof(regs));
+		rec.pc = pc;
+		rec.started = 1;
+	} else if (rec.h.pru != pru_num) {
+		printf("WARNING: recording PRU%u, this run of PRU%u is not recorded\n", rec.h.pru, pru_num);
+	} else if (!rec_entry(pc, regs, 1)) {
+		printf("ERROR: out of memory, recording stopped\n");
+		rec_stop();
+	}
+}
+
+// the step just made left the PC at pc; 0 if recording had to stop
+int rec_step(unsigned int pc)
+{
+	uint32_t		regs[32];
+
+	if (rec.h.pru != pru_num)
+		return 1;
+	read_regs(regs);
+	if (rec_entry(pc, regs, 0))
+		return 1;
+	printf("\nERROR: out of memory after %llu steps, the run stops here\n",
+	       (unsigned long long)rec.h.steps);
+	return 0;
+}
+
+// a stepping run ended: write everything recorded so far
+void rec_end()
+{
+	FILE			*f;
+
+	if (!rec.started || rec.h.pru != pru_num)
+		return;
+	rec.h.data_len = rec.len;
+	f = fopen(rec.fn, "w");
+	if (!f) {
+		printf("ERROR: could not create %s: %s\n", rec.fn, strerror(errno));
+		return;
+	}
+	if (fwrite(&rec.h, sizeof(rec.h), 1, f) != 1 || (rec.len && fwrite(rec.arena, rec.len, 1, f) != 1)) {
+		printf("ERROR: writing %s: %s\n", rec.fn, strerror(errno));
+		fclose(f);
+		return;
+	}
+	if (fclose(f)) {
+		printf("ERROR: writing %s: %s\n", rec.fn, strerror(errno));
+		return;
+	}
+	printf("%llu steps recorded to %s, %zu bytes", (unsigned long long)rec.h.steps, rec.fn,
+	       sizeof(rec.h) + rec.len);
+	if (rec.h.steps)
+		printf(", %.1f bytes/step", (double)rec.len / rec.h.steps);
+	printf("\n");
+}
+
+// REC without arguments
+void rec_status()
+{
+	if (!rec.fn)
+		printf("Not recording.\n\n");
+	else if (!rec.started)
+		printf("Recording the next GSS run of PRU%u to %s\n\n", pru_num, rec.fn);
+	else
+		printf("Recording PRU%u to %s: %llu steps, %zu bytes in memory\n\n", rec.h.pru, rec.fn,
+		       (unsigned long long)rec.h.steps, rec.len);
+}
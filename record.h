@@ -0,0 +1,50 @@
+/*
+ *
+ *  PRU Debug Program - execution record file format
+ *
+ *  An execution record holds the PC and R0-R31 after every step of GSS
+ *  runs made while REC was on.  The file starts with a struct
+ *  pru_rec_header holding the PC and registers before the first step,
+ *  followed by data_len bytes of entries, one per step.  Each entry
+ *  updates the state of the one before it:
+ *
+ *    tag	PRU_REC_PC: a little-endian 16-bit PC follows, else the PC
+ *		is the previous one + 1
+ *		PRU_REC_SYNC: no step, the state was changed between two
+ *		runs (R, J, ...)
+ *		low bits: n, the number of changed registers
+ *    which	n <= PRU_REC_MAX_INDEX: n register numbers, one byte each,
+ *		else a little-endian 32-bit mask of the changed registers
+ *    values	for each changed register from R0 up, new - old as a
+ *		zigzag LEB128 varint of the 32-bit difference
+ *
+ *  A step that changes one register by a small amount costs 3 bytes.
+ *
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+#include <stdint.h>
+
+#define PRU_REC_MAGIC		"PRUEXREC"
+#define PRU_REC_VERSION		1
+
+#define PRU_REC_PC		0x80
+#define PRU_REC_SYNC		0x40
+#define PRU_REC_COUNT		0x3F
+#define PRU_REC_MAX_INDEX	3
+
+struct pru_rec_header {
+	char			magic[8];
+	uint32_t		version;
+	uint32_t		header_len;	// bytes, the entries start here
+	uint32_t		pru;
+	uint32_t		pc;		// before the first step
+	uint64_t		time;		// seconds since the epoch at the start
+	uint64_t		steps;
+	uint64_t		data_len;	// bytes of entries
+	uint32_t		regs[32];	// R0-R31 before the first step
+	char			processor[24];	// short name, e.g. "AM335X"
+};
+
+#endif // RECORD_H
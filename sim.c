@@ -0,0 +1,697 @@
+/*
+ *
+ *  PRU Debug Program - instruction set simulator
+ *
+ *  Every IRAM word has a predecoded entry with its operands already turned
+ *  into byte offsets and masks within the register file.  An entry carries
+ *  the raw word it was built from and is rebuilt whenever IRAM no longer
+ *  holds that word, so breakpoint patches and program loads need no
+ *  notification.  Dispatch is threaded: each handler ends in its own
+ *  indirect jump to the next handler.
+ *
+ *  The register file is R0..R31 immediately followed by C0..C31, as in the
+ *  control block, which lets LBCO/SBCO read their base like a register.
+ *  Register fields are accessed with unaligned 32-bit loads and stores, so
+ *  the host must be little-endian.
+ *
+ *  A free-running PRU is executed by a worker thread in batches of
+ *  SIM_BATCH instructions; the status register (PC) and the cycle counter
+ *  are written back after every batch.  Single steps are executed
+ *  synchronously from sim_ctrl().
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "prudbg.h"
+#include "da.h"
+#include "sim.h"
+
+#define SIM_BATCH		0x10000
+#define SIM_NO_LOOP		0x10000		// never matches a 16-bit PC
+#define SIM_RF_LEN		(NUM_REGS * 4)	// bytes of R0..R31
+#define SIM_NUM_WIN		5
+
+struct sim_op {
+	uint32_t		inst;		// word this entry was decoded from
+	uint8_t			op;		// enum pru_op, PRU_INVALID if unsupported
+	uint8_t			rd, rs1, rs2;	// byte offsets into the register file
+	uint32_t		rd_mask, rs1_mask, rs2_mask;
+	uint32_t		imm;		// immediate operand, 0 if rs2 is used
+	int32_t			arg;		// branch offset, target, device, MVI modes
+	uint8_t			len;		// burst bytes, QB test bits, MVI width
+	uint8_t			r0b;		// R0 byte holding the burst length if len is 0
+};
+
+// a window of the PRU's local data address space
+struct sim_win {
+	uint32_t		addr, len;
+	uint8_t			*host;
+};
+
+struct sim_pru {
+	unsigned int		pc;
+	unsigned int		carry;
+	unsigned int		lp_start, lp_end, lp_count;
+	volatile uint32_t	*ctrl;
+	uint8_t			*rf;		// R0..R31, C0..C31
+	const uint32_t		*iram;
+	unsigned int		iram_len;
+	struct sim_win		win[SIM_NUM_WIN];
+	struct sim_op		cache[IRAM_MAX_LEN];
+};
+
+struct sim {
+	uint8_t			*mem;
+	size_t			len;
+	uint8_t			*ext;
+	unsigned int		npru;
+	struct sim_pru		*pru[MAX_NUM_OF_PRUS];
+	uint8_t			spad[3][SIM_RF_LEN];	// XIN/XOUT banks 10..12
+	pthread_t		thread;
+	pthread_mutex_t		lock;
+	pthread_cond_t		wake;
+	unsigned int		running;	// mask of free-running PRUs
+	int			waiters;	// sim_ctrl() callers waiting for the lock
+	int			quit;
+	int			halt_fd;	// eventfd, counts PRUs that stopped running
+};
+
+static inline uint32_t ld32(const uint8_t *p)
+{
+	uint32_t		v;
+
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline void st32(uint8_t *p, uint32_t v)
+{
+	memcpy(p, &v, 4);
+}
+
+static inline uint32_t sel_mask(unsigned int sel)
+{
+	return sel < 4 ? 0xFF : sel < 7 ? 0xFFFF : 0xFFFFFFFF;
+}
+
+static inline unsigned int sel_off(unsigned int reg, unsigned int sel)
+{
+	return reg * 4 + pru_sel_shift(sel) / 8;
+}
+
+static void sim_predecode(struct sim_op *op, uint32_t inst)
+{
+	struct pru_insn		in;
+
+	pru_decode(inst, &in);
+	memset(op, 0, sizeof(*op));
+	op->inst = inst;
+	op->op = in.flags & PRU_INSN_INVALID ? PRU_INVALID : in.op;
+	op->rd = sel_off(in.rd, in.rd_sel);
+	op->rd_mask = sel_mask(in.rd_sel);
+	op->rs1 = sel_off(in.rs1, in.rs1_sel);
+	op->rs1_mask = sel_mask(in.rs1_sel);
+	if (in.io) {
+		op->imm = in.imm;
+	} else {
+		op->rs2 = sel_off(in.rs2, in.rs2_sel);
+		op->rs2_mask = sel_mask(in.rs2_sel);
+	}
+
+	switch (in.op) {
+		case PRU_MVI:
+			op->arg = (inst >> 21) & 0xF;
+			op->len = 1 << in.byte;
+			break;
+
+		case PRU_XIN:
+		case PRU_XOUT:
+		case PRU_XCHG:
+			op->rd = in.rd * 4 + in.byte;
+			op->arg = in.imm;
+			op->len = pru_burst_len(&in);
+			op->r0b = in.burst - PRU_BURST_R0;
+			break;
+
+		case PRU_LOOP:
+		case PRU_ILOOP:
+			// an immediate count is encoded minus one
+			op->arg = in.broff;
+			if (in.io)
+				op->imm = in.imm + 1;
+			break;
+
+		case PRU_QBGT ... PRU_QBBS:
+			op->arg = in.broff;
+			// bit 2: op2 > rs1, bit 1: op2 == rs1, bit 0: op2 < rs1
+			op->len = (inst >> 27) & 7;
+			break;
+
+		case PRU_SBBO ... PRU_LBCO:
+			op->rd = in.rd * 4 + in.byte;
+			if (in.op == PRU_SBCO || in.op == PRU_LBCO)
+				op->rs1 = SIM_RF_LEN + in.rs1 * 4;
+			else
+				op->rs1 = in.rs1 * 4;
+			op->rs1_mask = 0xFFFFFFFF;
+			op->len = pru_burst_len(&in);
+			op->r0b = in.burst - PRU_BURST_R0;
+			break;
+
+		case PRU_SCAN:
+		case PRU_QBXX:
+			op->op = PRU_INVALID;
+			break;
+
+		default:
+			break;
+	}
+}
+
+// host address of len bytes at PRU data address addr, NULL if unmapped
+static inline uint8_t *sim_addr(struct sim_pru *pr, uint32_t addr, uint32_t len)
+{
+	const struct sim_win	*w;
+
+	for (w = pr->win; w < pr->win + SIM_NUM_WIN; w++)
+		if (addr - w->addr < w->len)
+			return len <= w->len - (addr - w->addr) ? w->host + (addr - w->addr) : NULL;
+	return NULL;
+}
+
+// burst length, clipped to the end of the register file
+static inline unsigned int sim_burst(const struct sim_op *op, const uint8_t *rf)
+{
+	unsigned int		n = op->len ? op->len : rf[op->r0b];
+
+	return op->rd + n > SIM_RF_LEN ? SIM_RF_LEN - op->rd : n;
+}
+
+static inline void rset(uint8_t *rf, unsigned int off, uint32_t mask, uint32_t v)
+{
+	st32(rf + off, (ld32(rf + off) & ~mask) | (v & mask));
+}
+
+// execute up to n instructions of one PRU, returns how many were executed
+static unsigned long sim_exec(struct sim *s, struct sim_pru *pr, unsigned long n, int *stop)
+{
+	static const void * const dispatch[PRU_NUM_OPS] = {
+		[PRU_ADD] = &&op_add, [PRU_ADC] = &&op_adc,
+		[PRU_SUB] = &&op_sub, [PRU_SUC] = &&op_suc,
+		[PRU_LSL] = &&op_lsl, [PRU_LSR] = &&op_lsr,
+		[PRU_RSB] = &&op_rsb, [PRU_RSC] = &&op_rsc,
+		[PRU_AND] = &&op_and, [PRU_OR] = &&op_or,
+		[PRU_XOR] = &&op_xor, [PRU_NOT] = &&op_not,
+		[PRU_MIN] = &&op_min, [PRU_MAX] = &&op_max,
+		[PRU_CLR] = &&op_clr, [PRU_SET] = &&op_set,
+		[PRU_JMP] = &&op_jmp, [PRU_JAL] = &&op_jal,
+		[PRU_LDI] = &&op_ldi, [PRU_LMBD] = &&op_lmbd,
+		[PRU_SCAN] = &&op_bad, [PRU_HALT] = &&op_halt,
+		[PRU_MVI] = &&op_mvi, [PRU_XIN] = &&op_xin,
+		[PRU_XOUT] = &&op_xout, [PRU_XCHG] = &&op_xchg,
+		[PRU_LOOP] = &&op_loop, [PRU_ILOOP] = &&op_loop,
+		[PRU_SLP] = &&op_slp,
+		[PRU_QBGT ... PRU_QBA] = &&op_qb,
+		[PRU_QBBC] = &&op_qbbc, [PRU_QBBS] = &&op_qbbs,
+		[PRU_QBXX] = &&op_bad,
+		[PRU_SBBO] = &&op_st, [PRU_LBBO] = &&op_ld,
+		[PRU_SBCO] = &&op_st, [PRU_LBCO] = &&op_ld,
+		[PRU_INVALID] = &&op_bad,
+	};
+	uint8_t			*rf = pr->rf;
+	const uint32_t		*iram = pr->iram;
+	struct sim_op		*op;
+	unsigned int		pc = pr->pc, carry = pr->carry;
+	unsigned int		lp_end = pr->lp_end;
+	unsigned long		budget = n;
+	uint32_t		a, b, v;
+	uint64_t		r;
+	unsigned int		len;
+	uint8_t			*p;
+
+	*stop = SIM_RUN;
+
+// fetch the next instruction and jump to its handler
+#define NEXT() do {								\
+		if (pc == lp_end) {						\
+			if (--pr->lp_count)					\
+				pc = pr->lp_start;				\
+			else							\
+				lp_end = SIM_NO_LOOP;				\
+		}								\
+		if (!budget)							\
+			goto out;						\
+		budget--;							\
+		if (pc >= pr->iram_len) {					\
+			*stop = SIM_FAULT;					\
+			goto out_undo;						\
+		}								\
+		op = &pr->cache[pc];						\
+		if (op->inst != iram[pc])					\
+			sim_predecode(op, iram[pc]);				\
+		goto *dispatch[op->op];						\
+	} while (0)
+
+#define RS1()		(ld32(rf + op->rs1) & op->rs1_mask)
+#define OP2()		((ld32(rf + op->rs2) & op->rs2_mask) | op->imm)
+#define RD(x)		rset(rf, op->rd, op->rd_mask, (x))
+#define ALU(expr)	do { a = RS1(); b = OP2(); RD(expr); pc++; NEXT(); } while (0)
+
+	NEXT();
+
+op_add:
+	a = RS1(); b = OP2();
+	r = (uint64_t)a + b;
+	carry = r > op->rd_mask;
+	RD(r); pc++; NEXT();
+op_adc:
+	a = RS1(); b = OP2();
+	r = (uint64_t)a + b + carry;
+	carry = r > op->rd_mask;
+	RD(r); pc++; NEXT();
+op_sub:
+	a = RS1(); b = OP2();
+	carry = b > a;
+	RD(a - b); pc++; NEXT();
+op_suc:
+	a = RS1(); b = OP2();
+	r = (uint64_t)b + carry;
+	carry = r > a;
+	RD(a - r); pc++; NEXT();
+op_rsb:
+	a = RS1(); b = OP2();
+	carry = a > b;
+	RD(b - a); pc++; NEXT();
+op_rsc:
+	a = RS1(); b = OP2();
+	r = (uint64_t)a + carry;
+	carry = r > b;
+	RD(b - r); pc++; NEXT();
+op_lsl:	ALU(a << (b & 31));
+op_lsr:	ALU(a >> (b & 31));
+op_and:	ALU(a & b);
+op_or:	ALU(a | b);
+op_xor:	ALU(a ^ b);
+op_not:	ALU(~a);
+op_min:	ALU(a < b ? a : b);
+op_max:	ALU(a > b ? a : b);
+op_clr:	ALU(a & ~(1u << (b & 31)));
+op_set:	ALU(a | (1u << (b & 31)));
+
+op_jmp:
+	pc = OP2() & 0xFFFF;
+	NEXT();
+op_jal:
+	b = OP2() & 0xFFFF;
+	RD(pc + 1);
+	pc = b;
+	NEXT();
+op_ldi:
+	RD(op->imm);
+	pc++; NEXT();
+op_lmbd:
+	a = RS1();
+	if (!(OP2() & 1))
+		a = ~a & op->rs1_mask;
+	RD(a ? 31 - __builtin_clz(a) : 32);
+	pc++; NEXT();
+
+op_mvi:
+	// pointers are byte offsets into R0..R31: 1 plain, 2 post-increment,
+	// 3 pre-decrement
+	a = RS1();
+	b = ld32(rf + op->rd) & op->rd_mask;
+	if ((op->arg & 3) == 3)
+		a -= op->len;
+	if ((op->arg >> 2) == 3)
+		b -= op->len;
+	if ((a & 0x7F) + op->len > SIM_RF_LEN || (b & 0x7F) + op->len > SIM_RF_LEN) {
+		*stop = SIM_FAULT;
+		goto out_undo;
+	}
+	v = 0;
+	memcpy(&v, rf + (a & 0x7F), op->len);
+	memcpy(rf + (b & 0x7F), &v, op->len);
+	if ((op->arg & 3) == 2)
+		a += op->len;
+	if ((op->arg >> 2) == 2)
+		b += op->len;
+	if ((op->arg & 3) >= 2)
+		rset(rf, op->rs1, op->rs1_mask, a);
+	if ((op->arg >> 2) >= 2)
+		RD(b);
+	pc++; NEXT();
+
+op_xin:
+	// only the scratch pad banks are modelled, other devices read nothing
+	if (op->arg >= 10 && op->arg <= 12)
+		memcpy(rf + op->rd, s->spad[op->arg - 10] + op->rd, sim_burst(op, rf));
+	pc++; NEXT();
+op_xout:
+	if (op->arg >= 10 && op->arg <= 12)
+		memcpy(s->spad[op->arg - 10] + op->rd, rf + op->rd, sim_burst(op, rf));
+	pc++; NEXT();
+op_xchg:
+	if (op->arg >= 10 && op->arg <= 12) {
+		uint8_t		tmp[SIM_RF_LEN];
+
+		len = sim_burst(op, rf);
+		memcpy(tmp, rf + op->rd, len);
+		memcpy(rf + op->rd, s->spad[op->arg - 10] + op->rd, len);
+		memcpy(s->spad[op->arg - 10] + op->rd, tmp, len);
+	}
+	pc++; NEXT();
+
+op_loop:
+	a = OP2();
+	if (!a) {
+		pc = (pc + op->arg) & 0xFFFF;
+	} else {
+		pr->lp_start = pc + 1;
+		pr->lp_count = a;
+		lp_end = (pc + op->arg) & 0xFFFF;
+		pc++;
+	}
+	NEXT();
+
+op_qb:
+	a = RS1(); b = OP2();
+	if (op->len & ((b > a) << 2 | (b == a) << 1 | (b < a)))
+		pc = (pc + op->arg) & 0xFFFF;
+	else
+		pc++;
+	NEXT();
+op_qbbc:
+	if (!(RS1() & (1u << (OP2() & 31))))
+		pc = (pc + op->arg) & 0xFFFF;
+	else
+		pc++;
+	NEXT();
+op_qbbs:
+	if (RS1() & (1u << (OP2() & 31)))
+		pc = (pc + op->arg) & 0xFFFF;
+	else
+		pc++;
+	NEXT();
+
+op_ld:
+	len = sim_burst(op, rf);
+	p = sim_addr(pr, RS1() + OP2(), len);
+	if (!p) {
+		*stop = SIM_FAULT;
+		goto out_undo;
+	}
+	memcpy(rf + op->rd, p, len);
+	pc++; NEXT();
+op_st:
+	len = sim_burst(op, rf);
+	p = sim_addr(pr, RS1() + OP2(), len);
+	if (!p) {
+		*stop = SIM_FAULT;
+		goto out_undo;
+	}
+	memcpy(p, rf + op->rd, len);
+	pc++; NEXT();
+
+op_halt:
+	*stop = SIM_HALT;
+	goto out_undo;
+op_slp:
+	*stop = SIM_SLEEP;
+	pc++;
+	goto out;
+op_bad:
+	*stop = SIM_INVALID;
+	goto out_undo;
+
+#undef ALU
+#undef RD
+#undef OP2
+#undef RS1
+#undef NEXT
+
+out_undo:
+	// the stopping instruction was not executed
+	budget++;
+out:
+	pr->pc = pc;
+	pr->carry = carry;
+	pr->lp_end = lp_end;
+	return n - budget;
+}
+
+// write back PC and cycle counter after n instructions
+static void sim_account(struct sim_pru *pr, unsigned long n)
+{
+	uint32_t		cyc;
+
+	pr->ctrl[PRU_STATUS_REG] = pr->pc;
+	if (!(pr->ctrl[PRU_CTRL_REG] & PRU_REG_COUNT_EN))
+		return;
+	// the counter saturates and then stops counting
+	cyc = pr->ctrl[PRU_CYCLE_REG];
+	if (n >= 0xFFFFFFFF - cyc) {
+		pr->ctrl[PRU_CYCLE_REG] = 0xFFFFFFFF;
+		pr->ctrl[PRU_CTRL_REG] &= ~PRU_REG_COUNT_EN;
+	} else {
+		pr->ctrl[PRU_CYCLE_REG] = cyc + n;
+	}
+}
+
+// update the control register after a stop
+static void sim_stopped(struct sim_pru *pr, unsigned int p, int stop)
+{
+	if (stop == SIM_SLEEP) {
+		pr->ctrl[PRU_CTRL_REG] = (pr->ctrl[PRU_CTRL_REG] | PRU_REG_SLEEPING) & ~PRU_REG_RUNSTATE;
+		return;
+	}
+	pr->ctrl[PRU_CTRL_REG] &= ~(PRU_REG_PROC_EN | PRU_REG_RUNSTATE);
+	if (stop == SIM_FAULT)
+		fprintf(stderr, "sim: PRU%u bus or register fault at 0x%04x\n", p, pr->pc);
+	else if (stop == SIM_INVALID)
+		fprintf(stderr, "sim: PRU%u unsupported instruction 0x%08x at 0x%04x\n",
+			p, pr->pc < pr->iram_len ? pr->iram[pr->pc] : 0, pr->pc);
+}
+
+static void *sim_thread(void *arg)
+{
+	struct sim		*s = arg;
+	unsigned int		p;
+	unsigned long		n;
+	int			stop;
+
+	pthread_mutex_lock(&s->lock);
+	while (!s->quit) {
+		if (!s->running) {
+			pthread_cond_wait(&s->wake, &s->lock);
+			continue;
+		}
+		for (p = 0; p < s->npru; p++) {
+			if (!(s->running & (1u << p)))
+				continue;
+			n = sim_exec(s, s->pru[p], SIM_BATCH, &stop);
+			sim_account(s->pru[p], n);
+			if (stop != SIM_RUN) {
+				s->running &= ~(1u << p);
+				sim_stopped(s->pru[p], p, stop);
+				eventfd_write(s->halt_fd, 1);
+			}
+		}
+		// let a waiting control register write in between batches
+		if (__atomic_load_n(&s->waiters, __ATOMIC_ACQUIRE)) {
+			pthread_mutex_unlock(&s->lock);
+			sched_yield();
+			pthread_mutex_lock(&s->lock);
+		}
+	}
+	pthread_mutex_unlock(&s->lock);
+	return NULL;
+}
+
+static void sim_lock(struct sim *s)
+{
+	__atomic_add_fetch(&s->waiters, 1, __ATOMIC_ACQ_REL);
+	pthread_mutex_lock(&s->lock);
+	__atomic_sub_fetch(&s->waiters, 1, __ATOMIC_ACQ_REL);
+}
+
+static void sim_reset(struct sim_pru *pr)
+{
+	pr->pc = pr->ctrl[PRU_CTRL_REG] >> 16;
+	pr->carry = 0;
+	pr->lp_end = SIM_NO_LOOP;
+	pr->ctrl[PRU_STATUS_REG] = pr->pc;
+}
+
+// the control register of PRU p has been written
+void sim_ctrl(struct sim *s, unsigned int p)
+{
+	struct sim_pru		*pr;
+	uint32_t		ctrl;
+	unsigned long		n;
+	int			stop;
+
+	if (p >= s->npru)
+		return;
+	pr = s->pru[p];
+	sim_lock(s);
+	ctrl = pr->ctrl[PRU_CTRL_REG];
+	if (!(ctrl & PRU_REG_SOFT_RESET)) {
+		// reset is self-clearing, the bit reads back as 1
+		ctrl |= PRU_REG_SOFT_RESET;
+		pr->ctrl[PRU_CTRL_REG] = ctrl;
+		sim_reset(pr);
+	}
+	if (!(ctrl & PRU_REG_PROC_EN) || (ctrl & PRU_REG_SLEEPING)) {
+		s->running &= ~(1u << p);
+		pr->ctrl[PRU_CTRL_REG] = ctrl & ~PRU_REG_RUNSTATE;
+	} else if (ctrl & PRU_REG_SINGLE_STEP) {
+		// one instruction, then the enable bit clears itself
+		s->running &= ~(1u << p);
+		n = sim_exec(s, pr, 1, &stop);
+		sim_account(pr, n);
+		pr->ctrl[PRU_CTRL_REG] &= ~(PRU_REG_PROC_EN | PRU_REG_RUNSTATE);
+		if (stop != SIM_RUN && stop != SIM_HALT)
+			sim_stopped(pr, p, stop);
+	} else {
+		pr->ctrl[PRU_CTRL_REG] = ctrl | PRU_REG_RUNSTATE;
+		s->running |= 1u << p;
+		pthread_cond_signal(&s->wake);
+	}
+	pthread_mutex_unlock(&s->lock);
+}
+
+// run PRU p synchronously for up to n instructions, returns the number executed
+unsigned long sim_step(struct sim *s, unsigned int p, unsigned long n, int *stop)
+{
+	unsigned long		done = 0, k;
+
+	*stop = SIM_RUN;
+	if (p >= s->npru)
+		return 0;
+	sim_lock(s);
+	s->running &= ~(1u << p);
+	while (done < n && *stop == SIM_RUN) {
+		k = sim_exec(s, s->pru[p], n - done < SIM_BATCH ? n - done : SIM_BATCH, stop);
+		sim_account(s->pru[p], k);
+		done += k;
+	}
+	pthread_mutex_unlock(&s->lock);
+	return done;
+}
+
+int sim_halt_fd(struct sim *s)
+{
+	return s->halt_fd;
+}
+
+volatile unsigned int *sim_mem(struct sim *s)
+{
+	return (volatile unsigned int *)s->mem;
+}
+
+static void sim_win(struct sim_win *w, uint32_t addr, uint32_t len, uint8_t *host)
+{
+	w->addr = addr;
+	w->len = len;
+	w->host = host;
+}
+
+struct sim *sim_create(const struct pru_layout *l)
+{
+	struct sim		*s;
+	struct sim_pru		*pr;
+	unsigned int		p, i, other;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+	s->len = l->pruss_len;
+	s->halt_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (s->halt_fd == -1) {
+		free(s);
+		return NULL;
+	}
+	s->mem = mmap(NULL, s->len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	s->ext = mmap(NULL, SIM_EXT_LEN, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (s->mem == MAP_FAILED || s->ext == MAP_FAILED)
+		goto fail;
+	s->npru = l->num_of_pruss;
+	for (p = 0; p < s->npru; p++) {
+		pr = s->pru[p] = calloc(1, sizeof(*pr));
+		if (!pr)
+			goto fail;
+		pr->ctrl = (volatile uint32_t *)(s->mem + l->ctrl_base[p] * 4);
+		pr->rf = s->mem + (l->ctrl_base[p] + PRU_INTGPR_REG) * 4;
+		pr->iram = (const uint32_t *)(s->mem + l->inst_base[p] * 4);
+		pr->iram_len = l->iram_len;
+		for (i = 0; i < 32; i++)
+			((uint32_t *)s->mem)[l->ctrl_base[p] + PRU_INTCT_REG + i] = pru_ct_reset[i];
+		// IRAM starts out as zeros, which is what an empty entry decodes
+		for (i = 0; i < IRAM_MAX_LEN; i++)
+			sim_predecode(&pr->cache[i], 0);
+		pr->ctrl[PRU_CTRL_REG] = PRU_REG_SOFT_RESET;
+		sim_reset(pr);
+
+		// data windows in lookup order, the local view of the PRUSS last
+		other = p ^ 1;
+		sim_win(&pr->win[0], PRU_LOCAL_DRAM, l->dram_len, s->mem + l->data_base[p] * 4);
+		if (other < s->npru)
+			sim_win(&pr->win[1], PRU_LOCAL_DRAM_OTHER, l->dram_len,
+				s->mem + l->data_base[other] * 4);
+		if (l->shared_len)
+			sim_win(&pr->win[2], PRU_LOCAL_SHARED, l->shared_len,
+				s->mem + l->shared_base * 4);
+		sim_win(&pr->win[3], 0, s->len, s->mem);
+		sim_win(&pr->win[4], SIM_EXT_BASE, SIM_EXT_LEN, s->ext);
+	}
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->wake, NULL);
+	if (pthread_create(&s->thread, NULL, sim_thread, s)) {
+		pthread_cond_destroy(&s->wake);
+		pthread_mutex_destroy(&s->lock);
+		goto fail;
+	}
+	return s;
+
+fail:
+	for (p = 0; p < MAX_NUM_OF_PRUS; p++)
+		free(s->pru[p]);
+	if (s->ext && s->ext != MAP_FAILED)
+		munmap(s->ext, SIM_EXT_LEN);
+	if (s->mem && s->mem != MAP_FAILED)
+		munmap(s->mem, s->len);
+	close(s->halt_fd);
+	free(s);
+	return NULL;
+}
+
+void sim_free(struct sim *s)
+{
+	unsigned int		p;
+
+	if (!s)
+		return;
+	pthread_mutex_lock(&s->lock);
+	s->quit = 1;
+	pthread_cond_signal(&s->wake);
+	pthread_mutex_unlock(&s->lock);
+	pthread_join(s->thread, NULL);
+	pthread_cond_destroy(&s->wake);
+	pthread_mutex_destroy(&s->lock);
+	for (p = 0; p < s->npru; p++)
+		free(s->pru[p]);
+	munmap(s->ext, SIM_EXT_LEN);
+	munmap(s->mem, s->len);
+	close(s->halt_fd);
+	free(s);
+}
@@ -0,0 +1,42 @@
+/*
+ *
+ *  PRU Debug Program - instruction set simulator header file
+ *
+ *  The simulator owns a memory image laid out exactly like the PRUSS
+ *  mapping of the selected processor, so the debugger points `pru` at it
+ *  and every command works unchanged.  IRAM, DRAM and shared RAM are plain
+ *  memory in the image, R0..R31 and C0..C31 live at PRU_INTGPR_REG and
+ *  PRU_INTCT_REG of each control block, and the control, status and cycle
+ *  registers are kept up to date by the simulator.  The only extra hook is
+ *  sim_ctrl(), which the debugger calls after writing a control register.
+ *  sim_halt_fd() becomes readable whenever a free-running PRU stops.
+ *
+ */
+
+#ifndef SIM_H
+#define SIM_H
+#include <stdint.h>
+
+#include "prudbg.h"
+
+// external memory reachable through the OCP master, at the address of C31
+#define SIM_EXT_BASE		0x80000000
+#define SIM_EXT_LEN		0x01000000
+
+// why sim_step() stopped early
+#define SIM_RUN			0
+#define SIM_HALT		1	// HALT instruction, PC stays on it
+#define SIM_SLEEP		2	// SLP instruction
+#define SIM_FAULT		3	// access outside of any memory
+#define SIM_INVALID		4	// unsupported instruction
+
+struct sim;
+
+struct sim *sim_create(const struct pru_layout *l);
+void sim_free(struct sim *s);
+volatile unsigned int *sim_mem(struct sim *s);
+void sim_ctrl(struct sim *s, unsigned int p);
+int sim_halt_fd(struct sim *s);
+unsigned long sim_step(struct sim *s, unsigned int p, unsigned long n, int *stop);
+
+#endif // SIM_H
@@ -0,0 +1,358 @@
+/*
+ *
+ *  PRU Debug Program - stack depth and data footprint
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prudbg.h"
+#include "da.h"
+#include "cfg.h"
+#include "pruelf.h"
+#include "stack.h"
+
+#define FUNC_TODO		0
+#define FUNC_BUSY		1
+#define FUNC_DONE		2
+#define FUNC_FAILED		3
+
+struct stk {
+	const struct cfg	*g;
+	unsigned char		*state;		// FUNC_*, per function
+	uint32_t		*frame;		// largest R2 adjustment of a function
+	uint32_t		*depth;		// frame plus the deepest callee
+	uint32_t		*via;		// function of the deepest callee, CFG_NONE if none
+	const char		**why;		// why a function has no bound
+	uint32_t		*why_addr;
+
+	// scratch of one walk, per block
+	int32_t			*off;		// R2 below its value on function entry
+	uint32_t		*mark, stamp;
+};
+
+static int stk_fail(struct stk *s, uint32_t f, const char *why, uint32_t addr)
+{
+	s->state[f] = FUNC_FAILED;
+	s->why[f] = why;
+	s->why_addr[f] = addr;
+	return -1;
+}
+
+// the function entered by block to from a block of f, CFG_NONE if the edge
+// stays inside f
+static uint32_t tail_callee(const struct cfg *g, uint32_t f, uint32_t to)
+{
+	if (!(g->blocks[to].flags & CFG_BLOCK_ENTRY) || to == g->funcs[f].block)
+		return CFG_NONE;
+	return cfg_func_entry(g, g->blocks[to].start);
+}
+
+// blocks reachable from the entry of f without following calls
+static uint32_t reach(struct stk *s, uint32_t f, uint32_t *list)
+{
+	const struct cfg	*g = s->g;
+	const struct cfg_edge	*e;
+	uint32_t		n = 1, i, k, b;
+
+	s->stamp++;
+	list[0] = g->funcs[f].block;
+	s->mark[list[0]] = s->stamp;
+	for (i = 0; i < n; i++) {
+		b = list[i];
+		for (k = 0, e = &g->edges[g->blocks[b].edge]; k < g->blocks[b].nedges; k++, e++) {
+			if (e->to == CFG_NONE || s->mark[e->to] == s->stamp ||
+			    tail_callee(g, f, e->to) != CFG_NONE)
+				continue;
+			s->mark[e->to] = s->stamp;
+			list[n++] = e->to;
+		}
+	}
+	return n;
+}
+
+static void add_callee(struct stk *s, uint32_t f, uint32_t callee, int32_t off)
+{
+	uint64_t		d = (uint64_t)off + s->depth[callee];
+
+	if (d > s->depth[f]) {
+		s->depth[f] = d;
+		s->via[f] = callee;
+	}
+}
+
+static int func_depth(struct stk *s, uint32_t f);
+
+// the callees of f, before f itself
+static int callees_first(struct stk *s, uint32_t f, const uint32_t *list, uint32_t n)
+{
+	const struct cfg	*g = s->g;
+	const struct cfg_block	*blk;
+	const struct cfg_edge	*e;
+	struct pru_insn		in;
+	uint32_t		i, k, c;
+
+	for (i = 0; i < n; i++) {
+		blk = &g->blocks[list[i]];
+		if (blk->flags & CFG_BLOCK_CALL) {
+			pru_decode(g->image[blk->start + blk->len - 1 - g->base], &in);
+			if (!in.io)
+				return stk_fail(s, f, "indirect call", blk->start + blk->len - 1);
+			c = cfg_func_entry(g, in.imm);
+			if (c == CFG_NONE)
+				return stk_fail(s, f, "call outside the image", blk->start + blk->len - 1);
+			if (func_depth(s, c))
+				return stk_fail(s, f, s->state[c] == FUNC_BUSY ? "recursion" : "callee has no bound",
+						blk->start + blk->len - 1);
+		}
+		for (k = 0, e = &g->edges[blk->edge]; k < blk->nedges; k++, e++) {
+			if (e->to == CFG_NONE || (c = tail_callee(g, f, e->to)) == CFG_NONE)
+				continue;
+			if (func_depth(s, c))
+				return stk_fail(s, f, s->state[c] == FUNC_BUSY ? "recursion" : "callee has no bound",
+						blk->start + blk->len - 1);
+		}
+	}
+	return 0;
+}
+
+// R2 at every instruction of f, starting from 0 at its entry; every path
+// has to agree on it where paths meet
+static int walk(struct stk *s, uint32_t f, uint32_t *list)
+{
+	const struct cfg	*g = s->g;
+	const struct cfg_block	*blk;
+	const struct cfg_edge	*e;
+	struct pru_insn		in;
+	uint32_t		n = 1, i, k, b, c, pc, rd, wr;
+	int32_t			off;
+
+	s->stamp++;
+	list[0] = g->funcs[f].block;
+	s->mark[list[0]] = s->stamp;
+	s->off[list[0]] = 0;
+	for (i = 0; i < n; i++) {
+		b = list[i];
+		blk = &g->blocks[b];
+		off = s->off[b];
+		for (pc = blk->start; pc < blk->start + blk->len; pc++) {
+			pru_decode(g->image[pc - g->base], &in);
+			pru_insn_regs(&in, &rd, &wr);
+			if (wr & (1u << STACK_REG)) {
+				if ((in.op != PRU_ADD && in.op != PRU_SUB) || !in.io ||
+				    in.rd != STACK_REG || in.rd_sel != PRU_SEL_FULL ||
+				    in.rs1 != STACK_REG || in.rs1_sel != PRU_SEL_FULL)
+					return stk_fail(s, f, "R2 set other than by an immediate", pc);
+				off += in.op == PRU_SUB ? in.imm : -(int32_t)in.imm;
+				if (off < 0)
+					return stk_fail(s, f, "R2 above its value on entry", pc);
+				if ((uint32_t)off > s->frame[f])
+					s->frame[f] = off;
+			}
+			if (in.op == PRU_JAL)
+				add_callee(s, f, cfg_func_entry(g, in.imm), off);
+		}
+		if ((blk->flags & CFG_BLOCK_RETURN) && off)
+			return stk_fail(s, f, "R2 not restored on return", blk->start + blk->len - 1);
+		for (k = 0, e = &g->edges[blk->edge]; k < blk->nedges; k++, e++) {
+			if (e->to == CFG_NONE)
+				continue;
+			if ((c = tail_callee(g, f, e->to)) != CFG_NONE) {
+				add_callee(s, f, c, off);
+			} else if (s->mark[e->to] != s->stamp) {
+				s->mark[e->to] = s->stamp;
+				s->off[e->to] = off;
+				list[n++] = e->to;
+			} else if (s->off[e->to] != off) {
+				return stk_fail(s, f, "R2 differs between paths", g->blocks[e->to].start);
+			}
+		}
+	}
+	return 0;
+}
+
+static int func_depth(struct stk *s, uint32_t f)
+{
+	uint32_t		*list, n;
+	int			r = -1;
+
+	if (s->state[f] != FUNC_TODO)
+		return s->state[f] == FUNC_DONE ? 0 : -1;
+	s->state[f] = FUNC_BUSY;
+	list = malloc((s->g->nblocks + 1) * sizeof(uint32_t));
+	if (!list)
+		return stk_fail(s, f, "out of memory", s->g->funcs[f].entry);
+	n = reach(s, f, list);
+	if (callees_first(s, f, list, n) == 0 && walk(s, f, list) == 0) {
+		if (s->frame[f] > s->depth[f]) {
+			s->depth[f] = s->frame[f];
+			s->via[f] = CFG_NONE;
+		}
+		s->state[f] = FUNC_DONE;
+		r = 0;
+	}
+	free(list);
+	return r;
+}
+
+#define STK_ALLOC(p, n)		((p) = calloc((n) + 1, sizeof(*(p))), ok = ok && (p))
+
+// stack use of every function and of every entry point; max_depth gets the
+// deepest entry point, CFG_NONE if one of them has no bound
+int stack_report(FILE *f, const struct cfg *g, uint32_t *max_depth)
+{
+	struct stk		s = {0};
+	unsigned char		*called = NULL;
+	const struct cfg_edge	*e;
+	uint32_t		i, k, b, c, nf = g->nfuncs;
+	int			ok = 1, r = 0;
+
+	s.g = g;
+	STK_ALLOC(s.state, nf);
+	STK_ALLOC(s.frame, nf);
+	STK_ALLOC(s.depth, nf);
+	STK_ALLOC(s.via, nf);
+	STK_ALLOC(s.why, nf);
+	STK_ALLOC(s.why_addr, nf);
+	STK_ALLOC(s.off, g->nblocks);
+	STK_ALLOC(s.mark, g->nblocks);
+	STK_ALLOC(called, nf);
+	if (!ok) {
+		fprintf(stderr, "stack: couldn't allocate memory\n");
+		r = -1;
+		goto cleanup;
+	}
+
+	// entry points are the functions nothing calls or jumps into
+	for (i = 0; i < g->ncalls; i++)
+		if (g->calls[i].target != CFG_NONE && (c = cfg_func_entry(g, g->calls[i].target)) != CFG_NONE)
+			called[c] = 1;
+	for (b = 0; b < g->nblocks; b++) {
+		if (g->blocks[b].func == CFG_NONE)
+			continue;
+		for (k = 0, e = &g->edges[g->blocks[b].edge]; k < g->blocks[b].nedges; k++, e++)
+			if (e->to != CFG_NONE && (c = tail_callee(g, g->blocks[b].func, e->to)) != CFG_NONE)
+				called[c] = 1;
+	}
+	if (nf && g->funcs[0].entry == g->base)
+		called[0] = 0;
+
+	fprintf(f, "Stack use in bytes, R2 growing down\n");
+	fprintf(f, "\nFunctions:\n");
+	for (i = 0; i < nf; i++) {
+		func_depth(&s, i);
+		if (s.state[i] == FUNC_DONE)
+			fprintf(f, "  0x%04x  frame %u  depth %u\n", g->funcs[i].entry, s.frame[i], s.depth[i]);
+		else
+			fprintf(f, "  0x%04x  unbounded: %s at 0x%04x\n", g->funcs[i].entry,
+				s.why[i] ? s.why[i] : "unknown", s.why_addr[i]);
+	}
+
+	fprintf(f, "\nEntry points:\n");
+	*max_depth = 0;
+	for (i = 0; i < nf; i++) {
+		if (called[i])
+			continue;
+		if (s.state[i] != FUNC_DONE) {
+			fprintf(f, "  0x%04x  unbounded\n", g->funcs[i].entry);
+			*max_depth = CFG_NONE;
+			continue;
+		}
+		fprintf(f, "  0x%04x  %u bytes  0x%04x", g->funcs[i].entry, s.depth[i], g->funcs[i].entry);
+		for (c = s.via[i], k = 0; c != CFG_NONE && k < nf; c = s.via[c], k++)
+			fprintf(f, " -> 0x%04x", g->funcs[c].entry);
+		fprintf(f, "\n");
+		if (*max_depth != CFG_NONE && s.depth[i] > *max_depth)
+			*max_depth = s.depth[i];
+	}
+
+cleanup:
+	free(s.state);
+	free(s.frame);
+	free(s.depth);
+	free(s.via);
+	free(s.why);
+	free(s.why_addr);
+	free(s.off);
+	free(s.mark);
+	free(called);
+	return r;
+}
+
+// data footprint
+
+struct region {
+	const char		*name;
+	uint32_t		addr, len;
+	uint32_t		used;
+};
+
+// add up the data segments of an ELF file per data RAM, and check the
+// stack against the .stack section or else against the free DRAM
+int stack_footprint(FILE *f, const char *elf_file, uint32_t dram_len, uint32_t shared_len,
+		    uint32_t depth)
+{
+	struct region		rg[] = {
+		{"DRAM",	PRU_LOCAL_DRAM,		dram_len,	0},
+		{"DRAM1",	PRU_LOCAL_DRAM_OTHER,	dram_len,	0},
+		{"SHARED",	PRU_LOCAL_SHARED,	shared_len,	0},
+	};
+	struct pru_elf		e;
+	const Elf32_Phdr	*ph;
+	const Elf32_Shdr	*sh;
+	uint32_t		addr, room;
+	unsigned int		i, k;
+	int			r = 0;
+
+	if (pru_elf_open(&e, elf_file))
+		return -1;
+	for (i = 0; i < e.eh->e_phnum; i++) {
+		ph = &e.ph[i];
+		if (ph->p_type != PT_LOAD || !ph->p_memsz || pru_elf_is_code(ph))
+			continue;
+		addr = pru_elf_addr(ph);
+		for (k = 0; k < sizeof(rg) / sizeof(rg[0]); k++) {
+			if (addr >= rg[k].addr && addr + ph->p_memsz <= rg[k].addr + rg[k].len) {
+				rg[k].used += ph->p_memsz;
+				break;
+			}
+		}
+		if (k == sizeof(rg) / sizeof(rg[0])) {
+			fprintf(f, "ERROR: data segment %u at 0x%x (%u bytes) is not in a data RAM\n",
+				i, addr, ph->p_memsz);
+			r = -1;
+		}
+	}
+
+	fprintf(f, "\nData memory of %s:\n", elf_file);
+	for (k = 0; k < sizeof(rg) / sizeof(rg[0]); k++) {
+		if (k == 1 && !rg[k].used)
+			continue;
+		fprintf(f, "  %-6s  0x%05x  %6u bytes  %6u used  %6u free\n", rg[k].name, rg[k].addr,
+			rg[k].len, rg[k].used, rg[k].len - rg[k].used);
+	}
+
+	sh = pru_elf_section(&e, ".stack");
+	if (depth == CFG_NONE) {
+		fprintf(f, "Stack depth is not bounded, see above\n");
+	} else if (sh) {
+		fprintf(f, ".stack  0x%05x  %6u bytes, deepest call chain needs %u\n",
+			sh->sh_addr, sh->sh_size, depth);
+		if (depth > sh->sh_size) {
+			fprintf(f, "WARNING: the stack overruns .stack by %u bytes\n", depth - sh->sh_size);
+			r = 1;
+		}
+	} else {
+		room = rg[0].len - rg[0].used;
+		fprintf(f, "No .stack section, deepest call chain needs %u of %u free DRAM bytes\n",
+			depth, room);
+		if (depth > room) {
+			fprintf(f, "WARNING: the stack overruns the data by %u bytes\n", depth - room);
+			r = 1;
+		}
+	}
+	pru_elf_close(&e);
+	return r;
+}
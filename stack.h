@@ -0,0 +1,29 @@
+/*
+ *
+ *  PRU Debug Program - stack depth and data footprint header file
+ *
+ *  pru-gcc and clpru keep the stack pointer in R2 and grow the stack
+ *  down: a frame is opened with "SUB R2, R2, n" and closed with
+ *  "ADD R2, R2, n".  stack_report() follows those adjustments through
+ *  each function of a struct cfg, adds the deepest callee at every JAL
+ *  and at jumps to another function's entry, and prints the worst depth
+ *  per function and per entry point (functions that nothing calls).
+ *  stack_footprint() adds up the data segments of the ELF file per data
+ *  RAM and checks the stack against what is left.
+ *
+ */
+
+#ifndef STACK_H
+#define STACK_H
+#include <stdio.h>
+#include <stdint.h>
+
+#include "cfg.h"
+
+#define STACK_REG		2	// R2
+
+int stack_report(FILE *f, const struct cfg *g, uint32_t *max_depth);
+int stack_footprint(FILE *f, const char *elf_file, uint32_t dram_len, uint32_t shared_len,
+		    uint32_t depth);
+
+#endif // STACK_H
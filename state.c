@@ -0,0 +1,388 @@
+/*
+ *
+ *  PRU Debug Program - state checkpoint and restore
+ *
+ *  SAVESTATE reads every memory and register block of every PRU with bulk
+ *  aligned transfers and writes them as one checkpoint file (see state.h).
+ *  LOADSTATE checks a checkpoint against the selected processor and its
+ *  sums before touching the PRUs, then halts them, writes the memories and
+ *  registers back and leaves each PRU halted at the PC it was saved at.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "prudbg.h"
+#include "backend.h"
+#include "state.h"
+
+#define STATE_MAX_SECTIONS	(4 * MAX_NUM_OF_PRUS + 1)
+#define STATE_ZSTD_LEVEL	3
+
+// CRC-32 of data continuing from crc (0 to start), as zlib's crc32()
+static uint32_t state_crc32(uint32_t crc, const void *data, size_t len)
+{
+	static uint32_t		table[256];
+	const unsigned char	*d = data;
+	uint32_t		c;
+	unsigned int		i, k;
+
+	if (!table[1]) {
+		for (i = 0; i < 256; i++) {
+			for (c = i, k = 0; k < 8; k++)
+				c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+	}
+	for (c = crc ^ 0xFFFFFFFF; len; len--)
+		c = table[(c ^ *d++) & 0xFF] ^ (c >> 8);
+	return c ^ 0xFFFFFFFF;
+}
+
+static double elapsed_ms(const struct timespec *t0)
+{
+	struct timespec		t1;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) * 1e3 + (t1.tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+static int pru_halted(unsigned int p)
+{
+	return !(pru_ctrl_read(p, PRU_CTRL_REG) & PRU_REG_RUNSTATE);
+}
+
+// read one block of the PRUSS into sec[*n] and data[*n]
+static int add_section(struct pru_state_section *sec, void **data, unsigned int *n,
+		       unsigned int type, unsigned int p, unsigned int off, unsigned int len,
+		       int compress)
+{
+	struct pru_state_section *s = &sec[*n];
+	void			*raw;
+
+	raw = malloc(len);
+	if (!raw) {
+		printf("ERROR: out of memory\n");
+		return -1;
+	}
+	pru_read_block(off, raw, len);
+	memset(s, 0, sizeof(*s));
+	s->type = type;
+	s->pru = p;
+	s->sum = state_crc32(0, raw, len);
+	s->len = s->raw_len = len;
+	s->pruss_off = off;
+	data[*n] = raw;
+#ifdef HAVE_ZSTD
+	if (compress) {
+		size_t		cap = ZSTD_compressBound(len), clen;
+		void		*z = malloc(cap);
+
+		if (!z) {
+			printf("ERROR: out of memory\n");
+			free(raw);
+			return -1;
+		}
+		clen = ZSTD_compress(z, cap, raw, len, STATE_ZSTD_LEVEL);
+		if (ZSTD_isError(clen)) {
+			printf("ERROR: zstd: %s\n", ZSTD_getErrorName(clen));
+			free(z);
+			free(raw);
+			return -1;
+		}
+		free(raw);
+		data[*n] = z;
+		s->len = clen;
+		s->flags |= PRU_STATE_ZSTD;
+	}
+#endif
+	(*n)++;
+	return 0;
+}
+
+// write a checkpoint of all PRUs to fn, zstd compressed if compress is set
+void cmd_savestate(const char *fn, int compress)
+{
+	struct pru_state_header	h;
+	struct pru_state_section sec[STATE_MAX_SECTIONS];
+	void			*data[STATE_MAX_SECTIONS];
+	unsigned int		n = 0, p, i, running = 0;
+	unsigned int		base;
+	uint64_t		off, total = 0;
+	struct timespec		t0;
+	int			fd, err = 0;
+
+#ifndef HAVE_ZSTD
+	if (compress) {
+		printf("ERROR: prudebug was built without zstd support\n");
+		return;
+	}
+#endif
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (p = 0; p < pruss_layout.num_of_pruss && !err; p++) {
+		base = pru_ctrl_base[p] * 4;
+		err = add_section(sec, data, &n, PRU_STATE_IRAM, p, pru_inst_base[p] * 4,
+				  pru_iram_len * 4, compress) ||
+		      add_section(sec, data, &n, PRU_STATE_DRAM, p, pru_data_base[p] * 4,
+				  pru_dram_len, compress) ||
+		      add_section(sec, data, &n, PRU_STATE_CTRL, p, base,
+				  PRU_STATE_CTRL_WORDS * 4, compress);
+		// the register file can only be read while the PRU is halted
+		if (!err && pru_halted(p))
+			err = add_section(sec, data, &n, PRU_STATE_REGS, p, base + PRU_INTGPR_REG * 4,
+					  PRU_STATE_REGS_WORDS * 4, compress);
+		else if (!err)
+			running |= 1u << p;
+	}
+	if (!err && pru_shared_len)
+		err = add_section(sec, data, &n, PRU_STATE_SHARED, 0, pru_shared_base * 4,
+				  pru_shared_len, compress);
+	if (err)
+		goto out;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, PRU_STATE_MAGIC, sizeof(h.magic));
+	h.version = PRU_STATE_VERSION;
+	h.header_len = sizeof(h) + n * sizeof(sec[0]);
+	h.num_sections = n;
+	h.time = time(NULL);
+	h.pruss_len = pruss_layout.pruss_len;
+	h.num_of_pruss = pruss_layout.num_of_pruss;
+	snprintf(h.processor, sizeof(h.processor), "%s", pruss_layout.name);
+	off = h.header_len;
+	for (i = 0; i < n; i++) {
+		off = (off + PRU_STATE_ALIGN - 1) & ~(uint64_t)(PRU_STATE_ALIGN - 1);
+		sec[i].offset = off;
+		off += sec[i].len;
+	}
+	h.header_sum = state_crc32(state_crc32(0, &h, sizeof(h)), sec, n * sizeof(sec[0]));
+
+	fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		printf("ERROR: could not create %s\n", fn);
+		goto out;
+	}
+	if (pwrite(fd, &h, sizeof(h), 0) != sizeof(h) ||
+	    pwrite(fd, sec, n * sizeof(sec[0]), sizeof(h)) != (ssize_t)(n * sizeof(sec[0])))
+		err = 1;
+	for (i = 0; i < n && !err; i++) {
+		if (pwrite(fd, data[i], sec[i].len, sec[i].offset) != (ssize_t)sec[i].len)
+			err = 1;
+		total += sec[i].raw_len;
+	}
+	if (close(fd) || err) {
+		printf("ERROR: could not write %s\n", fn);
+		goto out;
+	}
+
+	printf("Saved %u sections, %llu bytes of PRU state, %llu bytes in %s, %.2f ms\n",
+	       n, (unsigned long long)total, (unsigned long long)off, fn, elapsed_ms(&t0));
+	for (p = 0; p < pruss_layout.num_of_pruss; p++) {
+		if (running & (1u << p))
+			printf("PRU%u was running, its registers were not saved.\n", p);
+	}
+	printf("\n");
+out:
+	while (n)
+		free(data[--n]);
+}
+
+// the data of section s, uncompressed into *buf if needed; NULL on errors
+static const void *section_data(const unsigned char *map, const struct pru_state_section *s,
+				void **buf)
+{
+#ifdef HAVE_ZSTD
+	size_t			len;
+#endif
+
+	*buf = NULL;
+	if (!(s->flags & PRU_STATE_ZSTD))
+		return map + s->offset;
+#ifdef HAVE_ZSTD
+	*buf = malloc(s->raw_len);
+	if (!*buf)
+		return NULL;
+	len = ZSTD_decompress(*buf, s->raw_len, map + s->offset, s->len);
+	if (ZSTD_isError(len) || len != s->raw_len) {
+		free(*buf);
+		*buf = NULL;
+		return NULL;
+	}
+	return *buf;
+#else
+	return NULL;
+#endif
+}
+
+// the PRUSS block a section of type t for PRU p is restored to
+static int section_target(unsigned int t, unsigned int p, unsigned int *off, unsigned int *len)
+{
+	switch (t) {
+	case PRU_STATE_IRAM:
+		*off = pru_inst_base[p] * 4;
+		*len = pru_iram_len * 4;
+		return 0;
+	case PRU_STATE_DRAM:
+		*off = pru_data_base[p] * 4;
+		*len = pru_dram_len;
+		return 0;
+	case PRU_STATE_SHARED:
+		*off = pru_shared_base * 4;
+		*len = pru_shared_len;
+		return p != 0 || !pru_shared_len;
+	case PRU_STATE_CTRL:
+		*off = pru_ctrl_base[p] * 4;
+		*len = PRU_STATE_CTRL_WORDS * 4;
+		return 0;
+	case PRU_STATE_REGS:
+		*off = (pru_ctrl_base[p] + PRU_INTGPR_REG) * 4;
+		*len = PRU_STATE_REGS_WORDS * 4;
+		return 0;
+	}
+	return -1;
+}
+
+// restore a checkpoint written by cmd_savestate
+void cmd_loadstate(const char *fn)
+{
+	const struct pru_state_header *h;
+	const struct pru_state_section *sec;
+	struct pru_state_header	hc;
+	const void		*data[STATE_MAX_SECTIONS];
+	void			*buf[STATE_MAX_SECTIONS];
+	const uint32_t		*ctrl[MAX_NUM_OF_PRUS] = {NULL};
+	const unsigned char	*map;
+	unsigned int		n = 0, i, p, off, len, loaded = 0;
+	uint32_t		sum;
+	struct timespec		t0;
+	struct stat		st;
+	int			fd;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	fd = open(fn, O_RDONLY);
+	if (fd == -1 || fstat(fd, &st)) {
+		printf("ERROR: could not open %s\n", fn);
+		if (fd != -1)
+			close(fd);
+		return;
+	}
+	if ((size_t)st.st_size < sizeof(*h)) {
+		printf("ERROR: %s is not a PRU state file\n", fn);
+		close(fd);
+		return;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		printf("ERROR: could not map %s\n", fn);
+		return;
+	}
+
+	h = (const struct pru_state_header *)map;
+	sec = (const struct pru_state_section *)(h + 1);
+	if (memcmp(h->magic, PRU_STATE_MAGIC, sizeof(h->magic)) || h->version != PRU_STATE_VERSION ||
+	    h->num_sections > STATE_MAX_SECTIONS ||
+	    h->header_len != sizeof(*h) + h->num_sections * sizeof(*sec) ||
+	    h->header_len > (size_t)st.st_size) {
+		printf("ERROR: %s is not a PRU state file\n", fn);
+		goto out;
+	}
+	hc = *h;
+	hc.header_sum = 0;
+	sum = state_crc32(state_crc32(0, &hc, sizeof(hc)), sec, h->num_sections * sizeof(*sec));
+	if (sum != h->header_sum) {
+		printf("ERROR: %s: header checksum mismatch\n", fn);
+		goto out;
+	}
+	if (strncmp(h->processor, pruss_layout.name, sizeof(h->processor)) ||
+	    h->num_of_pruss != pruss_layout.num_of_pruss || h->pruss_len != pruss_layout.pruss_len) {
+		printf("ERROR: %s was saved on processor %.*s, not %s\n",
+		       fn, (int)sizeof(h->processor), h->processor, pruss_layout.name);
+		goto out;
+	}
+
+	// check every section before anything is written to the PRUs
+	for (n = 0; n < h->num_sections; n++) {
+		const struct pru_state_section *s = &sec[n];
+
+		buf[n] = NULL;
+		if (s->pru >= pruss_layout.num_of_pruss || section_target(s->type, s->pru, &off, &len) ||
+		    s->pruss_off != off || s->raw_len != len ||
+		    s->offset > (uint64_t)st.st_size || s->len > (uint64_t)st.st_size - s->offset) {
+			printf("ERROR: %s: section %u is damaged or does not fit this processor\n", fn, n);
+			goto out;
+		}
+		data[n] = section_data(map, s, &buf[n]);
+		if (!data[n]) {
+#ifndef HAVE_ZSTD
+			printf("ERROR: %s is compressed, prudebug was built without zstd support\n", fn);
+#else
+			printf("ERROR: %s: section %u could not be uncompressed\n", fn, n);
+#endif
+			goto out;
+		}
+		if (state_crc32(0, data[n], s->raw_len) != s->sum) {
+			printf("ERROR: %s: section %u checksum mismatch\n", fn, n);
+			n++;
+			goto out;
+		}
+		if (s->type == PRU_STATE_CTRL)
+			ctrl[s->pru] = data[n];
+	}
+
+	// halt the PRUs and reset them to the saved PC
+	for (p = 0; p < pruss_layout.num_of_pruss; p++) {
+		if (ctrl[p])
+			pru_ctrl_write(p, PRU_CTRL_REG, (ctrl[p][PRU_STATUS_REG] & 0xFFFF) << 16);
+	}
+	for (i = 0; i < n; i++) {
+		const struct pru_state_section *s = &sec[i];
+
+		switch (s->type) {
+		case PRU_STATE_REGS:
+			// only R0-R31, the constant table is read-only
+			pru_write_block(s->pruss_off, data[i], NUM_REGS * 4);
+			break;
+		case PRU_STATE_CTRL:
+			break;
+		default:
+			pru_write_block(s->pruss_off, data[i], s->raw_len);
+			if (s->type == PRU_STATE_IRAM)
+				iram_written(s->pruss_off, s->raw_len);
+			break;
+		}
+		loaded++;
+	}
+	// then the rest of the control registers, the control register itself last
+	for (p = 0; p < pruss_layout.num_of_pruss; p++) {
+		if (!ctrl[p])
+			continue;
+		for (i = PRU_STATUS_REG + 1; i < PRU_STATE_CTRL_WORDS; i++)
+			pru_ctrl_write(p, i, ctrl[p][i]);
+		pru_ctrl_write(p, PRU_CTRL_REG, (ctrl[p][PRU_CTRL_REG] & ~(PRU_REG_PROC_EN |
+			       PRU_REG_RUNSTATE | PRU_REG_SLEEPING)) | PRU_REG_SOFT_RESET);
+	}
+
+	printf("Loaded %u sections from %s in %.2f ms\n", loaded, fn, elapsed_ms(&t0));
+	for (p = 0; p < pruss_layout.num_of_pruss; p++) {
+		if (ctrl[p])
+			printf("PRU%u halted at 0x%04x%s\n", p, ctrl[p][PRU_STATUS_REG] & 0xFFFF,
+			       ctrl[p][PRU_CTRL_REG] & PRU_REG_RUNSTATE ?
+			       " (running when saved, registers not restored)" : "");
+	}
+	printf("\n");
+out:
+	while (n)
+		free(buf[--n]);
+	munmap((void *)map, st.st_size);
+}
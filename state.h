@@ -0,0 +1,63 @@
+/*
+ *
+ *  PRU Debug Program - state checkpoint file format
+ *
+ *  A checkpoint holds the memories and registers of every PRU of a PRUSS.
+ *  It starts with a struct pru_state_header followed by num_sections
+ *  struct pru_state_section entries; the data of each section starts at a
+ *  PRU_STATE_ALIGN aligned file offset.  Sections that are not compressed
+ *  hold the words exactly as they sit in the PRUSS, so a tool can mmap the
+ *  file and use the data in place.  All fields are little-endian, sums are
+ *  CRC-32 (the zlib polynomial); sum covers the uncompressed data and
+ *  header_sum the header and section table with header_sum set to 0.
+ *
+ */
+
+#ifndef STATE_H
+#define STATE_H
+#include <stdint.h>
+
+#define PRU_STATE_MAGIC		"PRUSTATE"
+#define PRU_STATE_VERSION	1
+#define PRU_STATE_ALIGN		4096
+
+// section types
+#define PRU_STATE_IRAM		1	// instruction RAM
+#define PRU_STATE_DRAM		2	// data RAM
+#define PRU_STATE_SHARED	3	// shared data RAM, pru is 0
+#define PRU_STATE_CTRL		4	// control registers CTRL..CTPPR1
+#define PRU_STATE_REGS		5	// R0-R31 then C0-C31, only from halted PRUs
+
+// section flags
+#define PRU_STATE_ZSTD		0x0001	// data is one zstd frame
+
+#define PRU_STATE_CTRL_WORDS	12
+#define PRU_STATE_REGS_WORDS	64
+
+struct pru_state_header {
+	char			magic[8];
+	uint32_t		version;
+	uint32_t		header_len;	// bytes, header and section table
+	uint32_t		num_sections;
+	uint32_t		flags;
+	uint64_t		time;		// seconds since the epoch
+	uint32_t		pruss_len;	// bytes
+	uint32_t		num_of_pruss;
+	uint32_t		header_sum;
+	uint32_t		reserved;
+	char			processor[24];	// short name, e.g. "AM335X"
+};
+
+struct pru_state_section {
+	uint32_t		type;
+	uint32_t		pru;
+	uint32_t		flags;
+	uint32_t		sum;
+	uint64_t		offset;		// in the file
+	uint64_t		len;		// bytes in the file
+	uint64_t		raw_len;	// bytes once uncompressed
+	uint32_t		pruss_off;	// byte offset in the PRUSS
+	uint32_t		reserved;
+};
+
+#endif // STATE_H
@@ -0,0 +1,329 @@
+/*
+ *
+ *  PRU Debug Program - software single-stepping engine
+ *
+ *  GSS without hardware breakpoints steps the PRU one instruction at a
+ *  time.  Everything that ends a run at a given address - BR and BA
+ *  breakpoints and HALT instructions - is folded into one IRAM-sized
+ *  bitmap before the run starts, so a step costs one control register
+ *  write, one status register read and a bit test, plus the span reads of
+ *  the watch engine (watch.c) when watches are set.  BA breakpoints only
+ *  exist in the bitmap, so there is no limit on their number.  A BR
+ *  breakpoint with a condition (cond.c) is evaluated only when its bit is
+ *  hit, so the other steps don't pay for it.  With REC on, each step also
+ *  appends the changed registers to the execution record (record.c).
+ *
+ *  An unbounded GSS with watches and only hw breakpoints runs in store
+ *  mode instead: watched memory can only change when the PRU executes a
+ *  store, so HALTs are patched over every SBBO, SBCO, XOUT and XCHG and
+ *  the PRU runs at full speed between them.  At each store the original
+ *  instruction is put back for one single step and the watches are
+ *  checked.  Writes by the other PRU or the host are not seen.  Register
+ *  watches are excluded: a watch outside the data and shared RAMs (the
+ *  register file, the cycle counter, control registers) changes without
+ *  a store, so with one set GSS steps every instruction.  The same loop,
+ *  without the stores, runs GSS with conditional hw breakpoints.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "prudbg.h"
+#include "backend.h"
+#include "da.h"
+
+#define STEP_MAP_WORDS		(IRAM_MAX_LEN / 32)
+#define STEP_SPINS		10000	// status polls before waiting yields, then sleeps
+
+static uint32_t			ba_map[MAX_NUM_OF_PRUS][STEP_MAP_WORDS];
+
+static inline int map_test(const uint32_t *map, unsigned int addr)
+{
+	return (map[addr / 32] >> (addr % 32)) & 1;
+}
+
+static inline void map_set(uint32_t *map, unsigned int addr)
+{
+	map[addr / 32] |= 1u << (addr % 32);
+}
+
+// set or clear a BA breakpoint of the active PRU
+void step_break(unsigned int addr, int on)
+{
+	if (addr >= pru_iram_len) {
+		printf("ERROR: 0x%04x is outside instruction memory\n", addr);
+		return;
+	}
+	if (on)
+		ba_map[pru_num][addr / 32] |= 1u << (addr % 32);
+	else
+		ba_map[pru_num][addr / 32] &= ~(1u << (addr % 32));
+}
+
+void step_break_clear_all()
+{
+	memset(ba_map[pru_num], 0, sizeof(ba_map[pru_num]));
+}
+
+unsigned int step_break_count()
+{
+	unsigned int		i, n = 0;
+
+	for (i = 0; i < STEP_MAP_WORDS; i++)
+		n += __builtin_popcount(ba_map[pru_num][i]);
+	return n;
+}
+
+void step_break_list()
+{
+	unsigned int		i, n = 0;
+
+	for (i = 0; i < pru_iram_len; i++) {
+		if (!map_test(ba_map[pru_num], i))
+			continue;
+		printf("%s0x%04x", n % 8 ? "  " : "", i);
+		if (++n % 8 == 0)
+			printf("\n");
+	}
+	if (n % 8)
+		printf("\n");
+	printf("%u BA breakpoint%s on PRU%u\n\n", n, n == 1 ? "" : "s", pru_num);
+}
+
+// Fill stop with everything that ends a run at an address and inst with
+// the instruction memory, returns its length in words.
+static unsigned int stop_map(uint32_t *stop, uint32_t *inst)
+{
+	unsigned int		i, len;
+
+	memcpy(stop, ba_map[pru_num], sizeof(ba_map[pru_num]));
+	for (i = 0; i < MAX_BREAKPOINTS; i++) {
+		if (bp[pru_num][i].state == BP_ACTIVE && bp[pru_num][i].address < pru_iram_len)
+			map_set(stop, bp[pru_num][i].address);
+	}
+	len = iram_read_block(0, inst, pru_iram_len);
+	for (i = 0; i < len; i++) {
+		if (inst[i] == INST_HALT)
+			map_set(stop, i);
+	}
+	return len;
+}
+
+// say why a run ended at addr, which is outside memory or in the stop map
+static void stop_report(unsigned int addr, unsigned int len)
+{
+	unsigned int		i;
+
+	if (addr >= len) {
+		printf("\nPC 0x%04x is outside instruction memory.\n", addr);
+		return;
+	}
+	for (i = 0; i < MAX_BREAKPOINTS; i++) {
+		if (bp[pru_num][i].state == BP_ACTIVE && bp[pru_num][i].address == addr)
+			break;
+	}
+	if (i < MAX_BREAKPOINTS)
+		printf("\nBreakpoint %u hit at %#x.\n", i, addr);
+	else if (map_test(ba_map[pru_num], addr))
+		printf("\nBA breakpoint hit at %#x.\n", addr);
+	else
+		printf("\nHALT instruction hit.\n");
+}
+
+// Whether a run should end at addr, which is in the stop map.  Counts a
+// hit on the BR breakpoint there and evaluates its condition.
+static int stop_here(unsigned int addr, const uint32_t *inst)
+{
+	struct breakpoints	*b;
+	unsigned int		i;
+
+	if (map_test(ba_map[pru_num], addr) || inst[addr] == INST_HALT)
+		return 1;
+	for (i = 0; i < MAX_BREAKPOINTS; i++) {
+		b = &bp[pru_num][i];
+		if (b->state == BP_ACTIVE && b->address == addr) {
+			b->hits++;
+			return !b->cond || cond_eval(b->cond, b->hits);
+		}
+	}
+	return 1;
+}
+
+static double ms_since(const struct timespec *t0)
+{
+	struct timespec		t1;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) * 1e3 + (t1.tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+// Single-step the active PRU count times (forever if count < 0) or until
+// something stops it or *interrupted is set.  The PRU is left halted in
+// single-step mode.
+void step_run(long count, volatile int *interrupted)
+{
+	uint32_t		stop[STEP_MAP_WORDS];
+	uint32_t		inst[IRAM_MAX_LEN];
+	unsigned int		addr = 0, len, nwatch;
+	unsigned long		n = 0;
+	uint32_t		step;
+	struct timespec		t0;
+	double			ms;
+	int			hit = 0, at_stop = 0, recording = rec_active();
+
+	len = stop_map(stop, inst);
+	nwatch = watch_plan();
+	if (recording) {
+		rec_begin();
+		recording = rec_active();
+	}
+
+	printf("Running with sw single-stepping (real-time performance not guaranteed)\n");
+	step = pru_ctrl_read(pru_num, PRU_CTRL_REG) | PRU_REG_PROC_EN | PRU_REG_SINGLE_STEP;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while (!*interrupted && count != 0) {
+		if (count > 0)
+			count--;
+		pru_ctrl_write(pru_num, PRU_CTRL_REG, step);
+		addr = pru_ctrl_read(pru_num, PRU_STATUS_REG) & 0xFFFF;
+		n++;
+		if (recording && !rec_step(addr))
+			break;
+		if (nwatch && watch_step(addr, n - 1))
+			hit = 1;
+		if (addr >= len || (map_test(stop, addr) && stop_here(addr, inst))) {
+			at_stop = 1;
+			break;
+		}
+		if (hit)
+			break;
+	}
+	ms = ms_since(&t0);
+	watch_done();
+
+	if (at_stop)
+		stop_report(addr, len);
+	printf("%lu steps in %.1f ms", n, ms);
+	if (ms > 0)
+		printf(", %.0f steps/s", n / ms * 1e3);
+	printf("\n");
+	if (recording)
+		rec_end();
+}
+
+// Wait for the free-running PRU to execute a HALT, returns 0 if
+// *interrupted was set first.  Polls flat out for a while since the next
+// store is usually close, then yields the CPU, then sleeps.
+static int wait_halt(volatile int *interrupted)
+{
+	unsigned int		spins = 0;
+	uint32_t		ctrl;
+
+	for (;;) {
+		ctrl = pru_ctrl_read(pru_num, PRU_CTRL_REG);
+		if (!(ctrl & (PRU_REG_RUNSTATE | PRU_REG_SLEEPING)))
+			return 1;
+		if (*interrupted)
+			return 0;
+		if (++spins > 2 * STEP_SPINS)
+			usleep(100);
+		else if (spins > STEP_SPINS)
+			sched_yield();
+	}
+}
+
+// Run the active PRU at full speed, stopping at each store to check the
+// watches and at each conditional breakpoint to evaluate it, until
+// something stops it or *interrupted is set.  The PRU is left halted.
+void step_run_stores(volatile int *interrupted)
+{
+	uint32_t		stop[STEP_MAP_WORDS], patch[STEP_MAP_WORDS];
+	uint32_t		site[STEP_MAP_WORDS];
+	uint32_t		inst[IRAM_MAX_LEN];
+	struct pru_insn		in;
+	unsigned int		i, addr, len, nwatch, nsites = 0;
+	unsigned long		stores = 0;
+	uint32_t		ctrl;
+	struct timespec		t0;
+	double			ms;
+	int			hit = 0, at_stop = 0, first = 1;
+
+	len = stop_map(stop, inst);
+	nwatch = watch_plan();
+	memset(site, 0, sizeof(site));
+	memset(patch, 0, sizeof(patch));
+	for (i = 0; i < len; i++) {
+		pru_decode(inst[i], &in);
+		if (nwatch && ((in.flags & PRU_INSN_STORE) || in.op == PRU_XOUT || in.op == PRU_XCHG)) {
+			map_set(site, i);
+			nsites++;
+		}
+		if ((map_test(site, i) || map_test(stop, i)) && inst[i] != INST_HALT)
+			map_set(patch, i);
+	}
+	for (i = 0; i < len; i++) {
+		if (map_test(patch, i))
+			iram_patch(i, INST_HALT);
+	}
+
+	if (nwatch)
+		printf("Running at full speed, stepping over %u store%s\n", nsites, nsites == 1 ? "" : "s");
+	else
+		printf("Running at full speed, evaluating breakpoint conditions\n");
+	ctrl = pru_ctrl_read(pru_num, PRU_CTRL_REG) & ~(PRU_REG_PROC_EN | PRU_REG_SINGLE_STEP);
+	addr = pru_ctrl_read(pru_num, PRU_STATUS_REG) & 0xFFFF;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (;;) {
+		if (!first && (addr >= len || (map_test(stop, addr) && stop_here(addr, inst)))) {
+			at_stop = 1;
+			break;
+		}
+		if (!first && !map_test(site, addr) && !map_test(stop, addr)) {
+			printf("\nPRU stopped at 0x%04x.\n", addr);
+			break;
+		}
+		first = 0;
+
+		// one step with the original instruction in place
+		if (addr < len && map_test(patch, addr))
+			iram_unpatch(addr);
+		pru_ctrl_write(pru_num, PRU_CTRL_REG, ctrl | PRU_REG_PROC_EN | PRU_REG_SINGLE_STEP);
+		if (addr < len && map_test(patch, addr))
+			iram_patch(addr, INST_HALT);
+		i = addr;
+		addr = pru_ctrl_read(pru_num, PRU_STATUS_REG) & 0xFFFF;
+		if (i < len && map_test(site, i) && watch_step(addr, stores++))
+			hit = 1;
+		if (hit || *interrupted)
+			break;
+
+		// the next instruction is a store or a stop itself
+		if (addr >= len || map_test(stop, addr) || map_test(site, addr))
+			continue;
+		pru_ctrl_write(pru_num, PRU_CTRL_REG, ctrl | PRU_REG_PROC_EN);
+		if (!wait_halt(interrupted)) {
+			pru_ctrl_write(pru_num, PRU_CTRL_REG, ctrl);
+			addr = pru_ctrl_read(pru_num, PRU_STATUS_REG) & 0xFFFF;
+			break;
+		}
+		addr = pru_ctrl_read(pru_num, PRU_STATUS_REG) & 0xFFFF;
+	}
+	ms = ms_since(&t0);
+	for (i = 0; i < len; i++) {
+		if (map_test(patch, i))
+			iram_unpatch(i);
+	}
+	watch_done();
+
+	if (at_stop)
+		stop_report(addr, len);
+	if (!nwatch)
+		return;
+	printf("%lu stores in %.1f ms", stores, ms);
+	if (ms > 0)
+		printf(", %.0f stores/s", stores / ms * 1e3);
+	printf("\n");
+}
@@ -0,0 +1,735 @@
+/*
+ *
+ *  PRU Debug Program - symbol and line-table index
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pruelf.h"
+#include "sym.h"
+
+#define SYM_CACHE_SUFFIX	".symidx"
+
+// DWARF constants used by the line program
+#define DW_LNS_copy		1
+#define DW_LNS_advance_pc	2
+#define DW_LNS_advance_line	3
+#define DW_LNS_set_file		4
+#define DW_LNS_const_add_pc	8
+#define DW_LNS_fixed_advance_pc	9
+#define DW_LNE_end_sequence	1
+#define DW_LNE_set_address	2
+#define DW_LNE_define_file	3
+#define DW_LNCT_path		1
+#define DW_FORM_block2		0x03
+#define DW_FORM_block4		0x04
+#define DW_FORM_data2		0x05
+#define DW_FORM_data4		0x06
+#define DW_FORM_data8		0x07
+#define DW_FORM_string		0x08
+#define DW_FORM_block		0x09
+#define DW_FORM_block1		0x0a
+#define DW_FORM_data1		0x0b
+#define DW_FORM_sdata		0x0d
+#define DW_FORM_strp		0x0e
+#define DW_FORM_udata		0x0f
+#define DW_FORM_data16		0x1e
+#define DW_FORM_line_strp	0x1f
+
+// index under construction
+struct sym_build {
+	struct sym_func		*funcs;
+	struct sym_line		*lines;
+	uint32_t		*files;
+	char			*strs;
+	uint32_t		nfuncs, nlines, nfiles, nstrs;
+	uint32_t		cfuncs, clines, cfiles, cstrs;
+	int			nomem;
+};
+
+// bounds-checked reader over one section
+struct rd {
+	const unsigned char	*p, *end;
+	int			bad;
+};
+
+static void *grow(void *p, uint32_t n, uint32_t *cap, size_t size, int *nomem)
+{
+	void			*q;
+
+	if (n < *cap)
+		return p;
+	q = realloc(p, (*cap ? *cap * 2 : 256) * size);
+	if (!q) {
+		*nomem = 1;
+		return p;
+	}
+	*cap = *cap ? *cap * 2 : 256;
+	return q;
+}
+
+static uint32_t add_str(struct sym_build *b, const char *s)
+{
+	uint32_t		len = strlen(s) + 1, off = b->nstrs;
+
+	while (b->nstrs + len > b->cstrs && !b->nomem)
+		b->strs = grow(b->strs, b->cstrs, &b->cstrs, 1, &b->nomem);
+	if (b->nomem)
+		return 0;
+	memcpy(b->strs + off, s, len);
+	b->nstrs += len;
+	return off;
+}
+
+// file table entry for a path, shared by all compile units
+static uint32_t add_file(struct sym_build *b, const char *path)
+{
+	uint32_t		i;
+
+	for (i = 0; i < b->nfiles; i++)
+		if (!strcmp(b->strs + b->files[i], path))
+			return i;
+	b->files = grow(b->files, b->nfiles, &b->cfiles, sizeof(*b->files), &b->nomem);
+	if (b->nomem)
+		return 0;
+	b->files[b->nfiles] = add_str(b, path);
+	return b->nfiles++;
+}
+
+static void add_line(struct sym_build *b, uint32_t byte_addr, uint32_t file, uint32_t line)
+{
+	b->lines = grow(b->lines, b->nlines, &b->clines, sizeof(*b->lines), &b->nomem);
+	if (b->nomem)
+		return;
+	b->lines[b->nlines].addr = (byte_addr & ~PRU_ELF_IMEM) / 4;
+	b->lines[b->nlines].file = file;
+	b->lines[b->nlines].line = line;
+	b->nlines++;
+}
+
+static uint64_t rd_n(struct rd *r, unsigned int n)
+{
+	uint64_t		v = 0;
+	unsigned int		i;
+
+	if (r->end - r->p < n) {
+		r->bad = 1;
+		r->p = r->end;
+		return 0;
+	}
+	for (i = 0; i < n; i++)
+		v |= (uint64_t)r->p[i] << (8 * i);
+	r->p += n;
+	return v;
+}
+
+static uint64_t rd_uleb(struct rd *r)
+{
+	uint64_t		v = 0;
+	unsigned int		shift = 0;
+	unsigned char		c;
+
+	do {
+		if (r->p >= r->end) {
+			r->bad = 1;
+			return 0;
+		}
+		c = *r->p++;
+		if (shift < 64)
+			v |= (uint64_t)(c & 0x7F) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	return v;
+}
+
+static int64_t rd_sleb(struct rd *r)
+{
+	int64_t			v = 0;
+	unsigned int		shift = 0;
+	unsigned char		c;
+
+	do {
+		if (r->p >= r->end) {
+			r->bad = 1;
+			return 0;
+		}
+		c = *r->p++;
+		if (shift < 64)
+			v |= (int64_t)(c & 0x7F) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	if (shift < 64 && (c & 0x40))
+		v |= -((int64_t)1 << shift);
+	return v;
+}
+
+static const char *rd_str(struct rd *r)
+{
+	const char		*s = (const char *)r->p;
+	const unsigned char	*z = memchr(r->p, 0, r->end - r->p);
+
+	if (!z) {
+		r->bad = 1;
+		r->p = r->end;
+		return "";
+	}
+	r->p = z + 1;
+	return s;
+}
+
+// string at offset of a string section, "" if out of range
+static const char *sec_str(const struct pru_elf *e, const Elf32_Shdr *sh, uint64_t off)
+{
+	if (!sh || off >= sh->sh_size)
+		return "";
+	if (!memchr(e->data + sh->sh_offset + off, 0, sh->sh_size - off))
+		return "";
+	return (const char *)e->data + sh->sh_offset + off;
+}
+
+// one attribute of a DWARF 5 directory/file entry; returns the path for
+// string forms, NULL otherwise
+static const char *rd_form(struct rd *r, const struct pru_elf *e, unsigned int form, int dwarf64)
+{
+	unsigned int		off = dwarf64 ? 8 : 4;
+
+	switch (form) {
+		case DW_FORM_string:	return rd_str(r);
+		case DW_FORM_strp:	return sec_str(e, pru_elf_section(e, ".debug_str"), rd_n(r, off));
+		case DW_FORM_line_strp:	return sec_str(e, pru_elf_section(e, ".debug_line_str"), rd_n(r, off));
+		case DW_FORM_data1:	rd_n(r, 1); break;
+		case DW_FORM_data2:	rd_n(r, 2); break;
+		case DW_FORM_data4:	rd_n(r, 4); break;
+		case DW_FORM_data8:	rd_n(r, 8); break;
+		case DW_FORM_data16:	rd_n(r, 16); break;
+		case DW_FORM_udata:	rd_uleb(r); break;
+		case DW_FORM_sdata:	rd_sleb(r); break;
+		case DW_FORM_block1:	rd_n(r, rd_n(r, 1)); break;
+		case DW_FORM_block2:	rd_n(r, rd_n(r, 2)); break;
+		case DW_FORM_block4:	rd_n(r, rd_n(r, 4)); break;
+		case DW_FORM_block:	rd_n(r, rd_uleb(r)); break;
+		default:		r->bad = 1; break;
+	}
+	return NULL;
+}
+
+// DWARF 5 file name table, mapped to global file indices
+static uint32_t *read_files_v5(struct rd *r, const struct pru_elf *e, struct sym_build *b,
+			       int dwarf64, uint32_t *nfiles)
+{
+	unsigned int		nfmt, i, j;
+	uint64_t		fmt[2 * 16], n;
+	const char		*path, *s;
+	uint32_t		*map;
+
+	// directories first, they are not needed
+	for (j = 0; j < 2; j++) {
+		nfmt = rd_n(r, 1);
+		if (nfmt > 16) {
+			r->bad = 1;
+			return NULL;
+		}
+		for (i = 0; i < nfmt; i++) {
+			fmt[2 * i] = rd_uleb(r);
+			fmt[2 * i + 1] = rd_uleb(r);
+		}
+		n = rd_uleb(r);
+		if (r->bad || n > (uint64_t)(r->end - r->p))
+			return NULL;
+		map = j ? calloc(n + 1, sizeof(uint32_t)) : NULL;
+		if (j && !map)
+			return NULL;
+		for (*nfiles = 0; *nfiles < n && !r->bad; (*nfiles)++) {
+			path = "";
+			for (i = 0; i < nfmt; i++) {
+				s = rd_form(r, e, fmt[2 * i + 1], dwarf64);
+				if (fmt[2 * i] == DW_LNCT_path && s)
+					path = s;
+			}
+			if (j)
+				map[*nfiles] = add_file(b, path);
+		}
+		if (j)
+			return map;
+	}
+	return NULL;
+}
+
+// DWARF 2-4 file name table; file numbers start at 1
+static uint32_t *read_files_v2(struct rd *r, struct sym_build *b, uint32_t *nfiles)
+{
+	struct rd		scan;
+	const char		*s;
+	uint32_t		*map, n = 0;
+
+	while (*rd_str(r) && !r->bad)
+		;	// include directories
+	scan = *r;
+	while (*(s = rd_str(&scan)) && !scan.bad) {
+		rd_uleb(&scan), rd_uleb(&scan), rd_uleb(&scan);
+		n++;
+	}
+	map = calloc(n + 2, sizeof(uint32_t));
+	if (!map)
+		return NULL;
+	for (*nfiles = 1; *nfiles <= n; (*nfiles)++) {
+		map[*nfiles] = add_file(b, rd_str(r));
+		rd_uleb(r), rd_uleb(r), rd_uleb(r);
+	}
+	rd_str(r);
+	return map;
+}
+
+// run the line number program of one unit, rows go to b->lines
+static void read_line_unit(struct rd *r, const struct pru_elf *e, struct sym_build *b)
+{
+	unsigned int		version, min_inst, line_range, opcode_base, op, i;
+	unsigned char		std_len[256];
+	int			line_base, dwarf64 = 0;
+	uint64_t		len, hlen, addr = 0, line = 1, file = 1, n;
+	uint32_t		*map, nfiles = 0;
+	struct rd		u, prog;
+
+	len = rd_n(r, 4);
+	if (len == 0xFFFFFFFF) {
+		dwarf64 = 1;
+		len = rd_n(r, 8);
+	}
+	if (r->bad || len > (uint64_t)(r->end - r->p)) {
+		r->bad = 1;
+		return;
+	}
+	u.p = r->p;
+	u.end = r->p + len;
+	u.bad = 0;
+	r->p = u.end;
+
+	version = rd_n(&u, 2);
+	if (version < 2 || version > 5)
+		return;
+	if (version >= 5)
+		rd_n(&u, 2);		// address and segment selector size
+	hlen = rd_n(&u, dwarf64 ? 8 : 4);
+	if (u.bad || hlen > (uint64_t)(u.end - u.p))
+		return;
+	prog.p = u.p + hlen;
+	prog.end = u.end;
+	prog.bad = 0;
+	min_inst = rd_n(&u, 1);
+	if (version >= 4)
+		rd_n(&u, 1);		// maximum operations per instruction
+	rd_n(&u, 1);			// default is_stmt
+	line_base = (signed char)rd_n(&u, 1);
+	line_range = rd_n(&u, 1);
+	opcode_base = rd_n(&u, 1);
+	if (u.bad || line_range == 0 || opcode_base == 0)
+		return;
+	for (i = 1; i < opcode_base; i++)
+		std_len[i] = rd_n(&u, 1);
+	if (version >= 5) {
+		map = read_files_v5(&u, e, b, dwarf64, &nfiles);
+		file = 1;
+	} else {
+		map = read_files_v2(&u, b, &nfiles);
+	}
+	if (!map)
+		return;
+
+	while (prog.p < prog.end && !prog.bad && !b->nomem) {
+		op = rd_n(&prog, 1);
+		if (op >= opcode_base) {
+			op -= opcode_base;
+			addr += (op / line_range) * min_inst;
+			line += line_base + (int)(op % line_range);
+			add_line(b, addr, file < nfiles ? map[file] : 0, line);
+			continue;
+		}
+		switch (op) {
+			case 0:
+				n = rd_uleb(&prog);
+				if (n == 0 || n > (uint64_t)(prog.end - prog.p)) {
+					prog.bad = 1;
+					break;
+				}
+				op = rd_n(&prog, 1);
+				if (op == DW_LNE_end_sequence) {
+					add_line(b, addr, 0, 0);
+					addr = 0;
+					line = 1;
+					file = 1;
+				} else if (op == DW_LNE_set_address) {
+					addr = rd_n(&prog, n - 1);
+				} else {
+					prog.p += n - 1;	// define_file and vendor ops
+				}
+				break;
+			case DW_LNS_copy:
+				add_line(b, addr, file < nfiles ? map[file] : 0, line);
+				break;
+			case DW_LNS_advance_pc:
+				addr += rd_uleb(&prog) * min_inst;
+				break;
+			case DW_LNS_advance_line:
+				line += rd_sleb(&prog);
+				break;
+			case DW_LNS_set_file:
+				file = rd_uleb(&prog);
+				break;
+			case DW_LNS_const_add_pc:
+				addr += ((255 - opcode_base) / line_range) * min_inst;
+				break;
+			case DW_LNS_fixed_advance_pc:
+				addr += rd_n(&prog, 2);
+				break;
+			default:
+				for (i = 0; i < std_len[op]; i++)
+					rd_uleb(&prog);
+				break;
+		}
+	}
+	free(map);
+}
+
+static void read_lines(const struct pru_elf *e, struct sym_build *b)
+{
+	const Elf32_Shdr	*sh = pru_elf_section(e, ".debug_line");
+	struct rd		r;
+
+	if (!sh || sh->sh_type == SHT_NOBITS)
+		return;
+	r.p = e->data + sh->sh_offset;
+	r.end = r.p + sh->sh_size;
+	r.bad = 0;
+	while (r.p < r.end && !r.bad && !b->nomem)
+		read_line_unit(&r, e, b);
+}
+
+static void read_funcs(const struct pru_elf *e, struct sym_build *b)
+{
+	const Elf32_Shdr	*symtab = pru_elf_section(e, ".symtab");
+	const Elf32_Shdr	*strtab = pru_elf_section(e, ".strtab");
+	const Elf32_Sym		*sym;
+	const char		*name;
+	unsigned int		i, n, type;
+	int			code;
+
+	if (!symtab || !strtab || symtab->sh_entsize != sizeof(Elf32_Sym))
+		return;
+	sym = (const Elf32_Sym *)(e->data + symtab->sh_offset);
+	n = symtab->sh_size / sizeof(Elf32_Sym);
+	for (i = 1; i < n && !b->nomem; i++) {
+		type = ELF32_ST_TYPE(sym[i].st_info);
+		if (type != STT_FUNC && type != STT_NOTYPE)
+			continue;
+		if (sym[i].st_shndx == SHN_UNDEF || sym[i].st_shndx >= e->eh->e_shnum)
+			continue;
+		code = (e->sh[sym[i].st_shndx].sh_flags & SHF_EXECINSTR) != 0;
+		name = sec_str(e, strtab, sym[i].st_name);
+		// local labels and mapping symbols are noise
+		if (!code || !*name || name[0] == '$' || name[0] == '.')
+			continue;
+		b->funcs = grow(b->funcs, b->nfuncs, &b->cfuncs, sizeof(*b->funcs), &b->nomem);
+		if (b->nomem)
+			return;
+		b->funcs[b->nfuncs].start = (sym[i].st_value & ~PRU_ELF_IMEM) / 4;
+		b->funcs[b->nfuncs].end = b->funcs[b->nfuncs].start + (sym[i].st_size + 3) / 4;
+		b->funcs[b->nfuncs].name = add_str(b, name);
+		// a sized FUNC symbol wins over a label at the same address
+		if (type == STT_FUNC && sym[i].st_size)
+			b->funcs[b->nfuncs].end |= 0x80000000;
+		b->nfuncs++;
+	}
+}
+
+static int cmp_func(const void *a, const void *b)
+{
+	const struct sym_func	*x = a, *y = b;
+
+	if (x->start != y->start)
+		return x->start < y->start ? -1 : 1;
+	// preferred symbol first
+	return (y->end >> 31) - (x->end >> 31);
+}
+
+static int cmp_line(const void *a, const void *b)
+{
+	const struct sym_line	*x = a, *y = b;
+
+	if (x->addr != y->addr)
+		return x->addr < y->addr ? -1 : 1;
+	// real rows before end-of-sequence markers
+	return (x->line == 0) - (y->line == 0);
+}
+
+// sort, drop duplicate addresses and close unsized functions at the next one
+static void finish(struct sym_build *b)
+{
+	uint32_t		i, n;
+
+	qsort(b->funcs, b->nfuncs, sizeof(*b->funcs), cmp_func);
+	for (i = n = 0; i < b->nfuncs; i++) {
+		if (n && b->funcs[n - 1].start == b->funcs[i].start)
+			continue;
+		b->funcs[n++] = b->funcs[i];
+	}
+	b->nfuncs = n;
+	for (i = 0; i < n; i++) {
+		b->funcs[i].end &= 0x7FFFFFFF;
+		if (b->funcs[i].end == b->funcs[i].start)
+			b->funcs[i].end = i + 1 < n ? b->funcs[i + 1].start : b->funcs[i].start + 1;
+	}
+
+	// keep one row per address, preferring a real row over an end marker
+	qsort(b->lines, b->nlines, sizeof(*b->lines), cmp_line);
+	for (i = n = 0; i < b->nlines; i++) {
+		if (n && b->lines[n - 1].addr == b->lines[i].addr)
+			continue;
+		b->lines[n++] = b->lines[i];
+	}
+	b->nlines = n;
+}
+
+// lay the index out as in the cache file
+static struct sym_index *serialize(struct sym_build *b, const struct stat *st)
+{
+	struct sym_index	*s;
+	struct sym_header	h;
+	unsigned char		*p;
+	size_t			size;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SYM_MAGIC, sizeof(h.magic));
+	h.src_size = st->st_size;
+	h.src_mtime = st->st_mtime;
+	h.nfuncs = b->nfuncs;
+	h.nlines = b->nlines;
+	h.nfiles = b->nfiles;
+	h.strlen = b->nstrs;
+	h.funcs = sizeof(h);
+	h.lines = h.funcs + b->nfuncs * sizeof(struct sym_func);
+	h.files = h.lines + b->nlines * sizeof(struct sym_line);
+	h.strs = h.files + b->nfiles * sizeof(uint32_t);
+	size = h.strs + b->nstrs;
+
+	s = calloc(1, sizeof(*s));
+	p = malloc(size);
+	if (!s || !p) {
+		free(s);
+		free(p);
+		return NULL;
+	}
+	memcpy(p, &h, sizeof(h));
+	memcpy(p + h.funcs, b->funcs, b->nfuncs * sizeof(struct sym_func));
+	memcpy(p + h.lines, b->lines, b->nlines * sizeof(struct sym_line));
+	memcpy(p + h.files, b->files, b->nfiles * sizeof(uint32_t));
+	memcpy(p + h.strs, b->strs, b->nstrs);
+	s->size = size;
+	s->hdr = (const struct sym_header *)p;
+	return s;
+}
+
+// point the index at its arrays, rejecting a damaged or stale image
+static int attach(struct sym_index *s, const struct stat *st)
+{
+	const struct sym_header	*h = s->hdr;
+	const unsigned char	*p = (const unsigned char *)h;
+
+	if (s->size < sizeof(*h) || memcmp(h->magic, SYM_MAGIC, sizeof(h->magic)))
+		return -1;
+	if (h->src_size != (uint64_t)st->st_size || h->src_mtime != st->st_mtime)
+		return -1;
+	if (h->funcs != sizeof(*h) ||
+	    h->lines != h->funcs + (uint64_t)h->nfuncs * sizeof(struct sym_func) ||
+	    h->files != h->lines + (uint64_t)h->nlines * sizeof(struct sym_line) ||
+	    h->strs != h->files + (uint64_t)h->nfiles * sizeof(uint32_t) ||
+	    (uint64_t)h->strs + h->strlen != s->size ||
+	    (h->strlen && p[s->size - 1] != 0))
+		return -1;
+	s->funcs = (const struct sym_func *)(p + h->funcs);
+	s->lines = (const struct sym_line *)(p + h->lines);
+	s->files = (const uint32_t *)(p + h->files);
+	s->strs = (const char *)(p + h->strs);
+	return 0;
+}
+
+static struct sym_index *load_cache(const char *cache, const struct stat *st)
+{
+	struct sym_index	*s;
+	struct stat		cst;
+	void			*p;
+	int			f;
+
+	f = open(cache, O_RDONLY);
+	if (f == -1)
+		return NULL;
+	if (fstat(f, &cst) || cst.st_size < (off_t)sizeof(struct sym_header) ||
+	    (p = mmap(NULL, cst.st_size, PROT_READ, MAP_PRIVATE, f, 0)) == MAP_FAILED) {
+		close(f);
+		return NULL;
+	}
+	close(f);
+	s = calloc(1, sizeof(*s));
+	if (s) {
+		s->hdr = p;
+		s->size = cst.st_size;
+		s->mapped = 1;
+		if (attach(s, st) == 0)
+			return s;
+	}
+	free(s);
+	munmap(p, cst.st_size);
+	return NULL;
+}
+
+// the cache is best effort, the firmware directory may be read-only
+static void save_cache(const char *cache, const struct sym_index *s)
+{
+	char			tmp[PATH_MAX];
+	FILE			*f;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.%d", cache, (int)getpid()) >= (int)sizeof(tmp))
+		return;
+	f = fopen(tmp, "w");
+	if (!f)
+		return;
+	if (fwrite(s->hdr, s->size, 1, f) != 1) {
+		fclose(f);
+		unlink(tmp);
+		return;
+	}
+	if (fclose(f) || rename(tmp, cache))
+		unlink(tmp);
+}
+
+// index of elf_file, from its cache if that is up to date
+struct sym_index *sym_load(const char *elf_file)
+{
+	struct sym_build	b;
+	struct sym_index	*s;
+	struct pru_elf		e;
+	struct stat		st;
+	char			cache[PATH_MAX];
+
+	if (stat(elf_file, &st)) {
+		printf("ERROR: could not open %s\n", elf_file);
+		return NULL;
+	}
+	if (snprintf(cache, sizeof(cache), "%s" SYM_CACHE_SUFFIX, elf_file) < (int)sizeof(cache) &&
+	    (s = load_cache(cache, &st)))
+		return s;
+
+	if (pru_elf_open(&e, elf_file))
+		return NULL;
+	memset(&b, 0, sizeof(b));
+	add_str(&b, "");
+	read_funcs(&e, &b);
+	read_lines(&e, &b);
+	pru_elf_close(&e);
+	s = NULL;
+	if (!b.nomem) {
+		finish(&b);
+		s = serialize(&b, &st);
+	}
+	free(b.funcs);
+	free(b.lines);
+	free(b.files);
+	free(b.strs);
+	if (!s || attach(s, &st)) {
+		printf("ERROR: could not allocate memory\n");
+		sym_free(s);
+		return NULL;
+	}
+	save_cache(cache, s);
+	return s;
+}
+
+void sym_free(struct sym_index *s)
+{
+	if (!s)
+		return;
+	if (s->mapped)
+		munmap((void *)s->hdr, s->size);
+	else
+		free((void *)s->hdr);
+	free(s);
+}
+
+// function and source line containing addr
+void sym_lookup(const struct sym_index *s, uint32_t addr, struct sym_loc *loc)
+{
+	uint32_t		lo, hi, mid;
+
+	memset(loc, 0, sizeof(*loc));
+
+	// last function starting at or before addr
+	lo = 0;
+	hi = s->hdr->nfuncs;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (s->funcs[mid].start <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo && addr < s->funcs[lo - 1].end) {
+		loc->func = s->strs + s->funcs[lo - 1].name;
+		loc->offset = addr - s->funcs[lo - 1].start;
+	}
+
+	// last line row at or before addr
+	lo = 0;
+	hi = s->hdr->nlines;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (s->lines[mid].addr <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo && s->lines[lo - 1].line) {
+		loc->file = s->strs + s->files[s->lines[lo - 1].file];
+		loc->line = s->lines[lo - 1].line;
+	}
+}
+
+// address of "name" or "name+offset", offset in instructions
+int sym_resolve(const struct sym_index *s, const char *name, uint32_t *addr)
+{
+	const char		*plus = strchr(name, '+');
+	size_t			len = plus ? (size_t)(plus - name) : strlen(name);
+	uint32_t		i;
+
+	for (i = 0; i < s->hdr->nfuncs; i++) {
+		const char *n = s->strs + s->funcs[i].name;
+		if (!strncmp(n, name, len) && n[len] == 0) {
+			*addr = s->funcs[i].start + (plus ? strtoul(plus + 1, NULL, 0) : 0);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// "func+off (file:line)" for addr, returns 0 if nothing is known
+int sym_format(const struct sym_index *s, uint32_t addr, char *str, unsigned int len)
+{
+	struct sym_loc		loc;
+	int			n = 0;
+
+	str[0] = 0;
+	sym_lookup(s, addr, &loc);
+	if (loc.func && loc.offset)
+		n = snprintf(str, len, "%s+%u", loc.func, loc.offset);
+	else if (loc.func)
+		n = snprintf(str, len, "%s", loc.func);
+	if (loc.file && n >= 0 && (unsigned int)n < len)
+		n += snprintf(str + n, len - n, "%s%s:%u", n ? " " : "", loc.file, loc.line);
+	return loc.func || loc.file;
+}
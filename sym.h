@@ -0,0 +1,62 @@
+/*
+ *
+ *  PRU Debug Program - symbol and line-table index header file
+ *
+ *  Function symbols from .symtab and the rows of the DWARF .debug_line
+ *  program are flattened into two address-sorted arrays and a string
+ *  table.  The in-memory index has exactly the layout of the cache file
+ *  written next to the firmware (<firmware>.symidx), so a cached index is
+ *  simply mapped and used.  All addresses are instruction word addresses.
+ *
+ */
+
+#ifndef SYM_H
+#define SYM_H
+#include <stdint.h>
+
+#define SYM_MAGIC		"PRUSYMX1"
+
+struct sym_header {
+	char			magic[8];
+	uint64_t		src_size;	// size and mtime of the ELF file
+	int64_t			src_mtime;
+	uint32_t		nfuncs, nlines, nfiles, strlen;
+	uint32_t		funcs, lines, files, strs;	// byte offsets from the header
+};
+
+struct sym_func {
+	uint32_t		start, end;	// [start, end)
+	uint32_t		name;		// string offset
+};
+
+struct sym_line {
+	uint32_t		addr;
+	uint32_t		file;		// index into the file table, line 0 marks a gap
+	uint32_t		line;
+};
+
+struct sym_index {
+	const struct sym_header	*hdr;
+	const struct sym_func	*funcs;
+	const struct sym_line	*lines;
+	const uint32_t		*files;		// string offsets
+	const char		*strs;
+	size_t			size;
+	int			mapped;
+};
+
+// result of a lookup; any field may be NULL/0 when not known
+struct sym_loc {
+	const char		*func;
+	uint32_t		offset;		// from the function start
+	const char		*file;
+	uint32_t		line;
+};
+
+struct sym_index *sym_load(const char *elf_file);
+void sym_free(struct sym_index *s);
+void sym_lookup(const struct sym_index *s, uint32_t addr, struct sym_loc *loc);
+int sym_resolve(const struct sym_index *s, const char *name, uint32_t *addr);
+int sym_format(const struct sym_index *s, uint32_t addr, char *str, unsigned int len);
+
+#endif // SYM_H
@@ -0,0 +1,230 @@
+/*
+ *
+ *  PRU Debug Program - streaming PC trace
+ *
+ *  TRACE STREAM lets the PRU run free while a sampler thread reads its
+ *  status register as fast as the bus allows.  Every change of PC becomes
+ *  a timestamped record (trace.h) pushed into a single-producer,
+ *  single-consumer ring; a writer thread drains the ring and encodes it
+ *  into the block format of tracefile.c, so the length of a trace is
+ *  bounded by the disk only.
+ *  The sampler does nothing but poll, time and push: it can be pinned to
+ *  a core and run under SCHED_FIFO.  When the ring is full a record is
+ *  dropped and counted rather than stalling the sampler.
+ *
+ */
+
+#define _GNU_SOURCE		// pthread_attr_setaffinity_np()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+#include "prudbg.h"
+#include "backend.h"
+#include "trace.h"
+
+#define TRACE_RING		(1u << 20)	// records, a power of two
+#define TRACE_IDLE_US		1000		// writer sleep when the ring is empty
+
+struct trace_run {
+	struct pru_trace_record	*ring;
+	unsigned long		head;		// written by the sampler only
+	unsigned long		tail;		// written by the writer only
+	int			done;		// sampler finished
+	struct tracefile_writer	w;
+	const struct trace_opts	*opts;
+	volatile int		*interrupted;
+	struct timespec		t0;
+	uint64_t		polls, dropped, records, duration_ns;
+	unsigned int		halt_pc;	// PC of the HALT that ended the trace, or -1
+};
+
+static inline uint64_t ns_since(const struct timespec *t0)
+{
+	struct timespec		t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec - t0->tv_sec) * 1000000000ull + t.tv_nsec - t0->tv_nsec;
+}
+
+// hand one record to the writer, or count it as dropped
+static inline void trace_push(struct trace_run *r, uint64_t t, unsigned int pc, uint32_t polls)
+{
+	unsigned long		head = r->head;
+	struct pru_trace_record	*rec;
+
+	if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == TRACE_RING) {
+		r->dropped++;
+		return;
+	}
+	rec = &r->ring[head & (TRACE_RING - 1)];
+	rec->t = t;
+	rec->pc = pc;
+	rec->polls = polls;
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void *trace_sampler(void *arg)
+{
+	struct trace_run	*r = arg;
+	unsigned int		pc, last;
+	uint64_t		t, polls = 0, pushed = 0, max = r->opts->max_samples;
+	uint32_t		same = 1;
+
+	last = pru_ctrl_read(pru_num, PRU_STATUS_REG) & 0xFFFF;
+	t = 0;
+	polls++;
+	if (r->opts->on_halt && iram_is_halt(last))
+		r->halt_pc = last;
+	// the sample being timed is pushed after the loop, so it ends one short of max
+	while (r->halt_pc == -1u && !*r->interrupted && (!max || pushed + 1 < max)) {
+		pc = pru_ctrl_read(pru_num, PRU_STATUS_REG) & 0xFFFF;
+		polls++;
+		if (pc == last) {
+			if (same != UINT32_MAX)
+				same++;
+			continue;
+		}
+		trace_push(r, t, last, same);
+		pushed++;
+		t = ns_since(&r->t0);
+		last = pc;
+		same = 1;
+		if (r->opts->on_halt && iram_is_halt(pc))
+			r->halt_pc = pc;
+	}
+	trace_push(r, t, last, same);
+	r->duration_ns = ns_since(&r->t0);
+	r->polls = polls;
+	__atomic_store_n(&r->done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void *trace_writer(void *arg)
+{
+	struct trace_run	*r = arg;
+	unsigned long		head, tail = 0;
+	int			done;
+
+	for (;;) {
+		done = __atomic_load_n(&r->done, __ATOMIC_ACQUIRE);
+		head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			if (done)
+				break;
+			usleep(TRACE_IDLE_US);
+			continue;
+		}
+		while (tail != head)
+			tracefile_add(&r->w, &r->ring[tail++ & (TRACE_RING - 1)]);
+		r->records = r->w.h.num_samples;
+		__atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+// start the sampler as the options ask, falling back to a plain thread
+static int start_sampler(pthread_t *th, struct trace_run *r)
+{
+	const struct trace_opts	*o = r->opts;
+	pthread_attr_t		attr;
+	struct sched_param	sp;
+	cpu_set_t		cpus;
+	int			err;
+
+	pthread_attr_init(&attr);
+	if (o->cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(o->cpu, &cpus);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+	if (o->fifo) {
+		memset(&sp, 0, sizeof(sp));
+		sp.sched_priority = sched_get_priority_min(SCHED_FIFO);
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &sp);
+	}
+	err = pthread_create(th, &attr, trace_sampler, r);
+	pthread_attr_destroy(&attr);
+	if (err == EPERM || err == EINVAL) {
+		printf("WARNING: could not %s the sampler (%s), running it unpinned\n",
+		       o->fifo ? "pin or give SCHED_FIFO to" : "pin", strerror(err));
+		err = pthread_create(th, NULL, trace_sampler, r);
+	}
+	return err;
+}
+
+// Run the active PRU and stream its PC changes to fn until *interrupted
+// is set, max_samples were taken or, with on_halt, it reaches a HALT.
+// The PRU is left running.
+void trace_stream(const char *fn, const struct trace_opts *opts, volatile int *interrupted)
+{
+	struct trace_run	r;
+	struct stat		st;
+	pthread_t		sampler, writer;
+	uint32_t		ctrl;
+	double			s;
+	int			err;
+
+	memset(&r, 0, sizeof(r));
+	r.opts = opts;
+	r.interrupted = interrupted;
+	r.halt_pc = -1;
+	r.ring = malloc(TRACE_RING * sizeof(r.ring[0]));
+	if (!r.ring) {
+		printf("ERROR: out of memory\n");
+		return;
+	}
+	if (tracefile_create(&r.w, fn, pru_num, pruss_layout.name)) {
+		printf("ERROR: could not create %s\n", fn);
+		free(r.ring);
+		return;
+	}
+
+	err = pthread_create(&writer, NULL, trace_writer, &r);
+	if (err) {
+		printf("ERROR: could not start the trace writer: %s\n", strerror(err));
+		tracefile_finish(&r.w);
+		free(r.ring);
+		return;
+	}
+	printf("Tracing PRU%u to %s ... press ctrl-C to stop%s\n", pru_num, fn,
+	       opts->on_halt ? " or it will stop on halt" : "");
+	ctrl = pru_ctrl_read(pru_num, PRU_CTRL_REG);
+	pru_ctrl_write(pru_num, PRU_CTRL_REG, (ctrl | PRU_REG_PROC_EN) & ~PRU_REG_SINGLE_STEP);
+	clock_gettime(CLOCK_MONOTONIC, &r.t0);
+	err = start_sampler(&sampler, &r);
+	if (err) {
+		printf("ERROR: could not start the sampler: %s\n", strerror(err));
+		__atomic_store_n(&r.done, 1, __ATOMIC_RELEASE);
+	} else {
+		pthread_join(sampler, NULL);
+	}
+	pthread_join(writer, NULL);
+
+	r.w.h.polls = r.polls;
+	r.w.h.dropped = r.dropped;
+	r.w.h.duration_ns = r.duration_ns;
+	err = tracefile_finish(&r.w);
+	free(r.ring);
+
+	if (r.halt_pc != -1u)
+		printf("\nHALT instruction hit at 0x%04x.\n", r.halt_pc);
+	s = r.duration_ns / 1e9;
+	printf("%llu PC changes from %llu polls in %.3f s", (unsigned long long)r.records,
+	       (unsigned long long)r.polls, s);
+	if (s > 0)
+		printf(", %.0f polls/s", r.polls / s);
+	printf(", %llu dropped\n", (unsigned long long)r.dropped);
+	if (err)
+		printf("ERROR: writing %s: %s, the trace is incomplete\n", fn, strerror(err));
+	else if (!stat(fn, &st))
+		printf("Trace written to %s, %llu bytes\n", fn, (unsigned long long)st.st_size);
+}
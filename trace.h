@@ -0,0 +1,122 @@
+/*
+ *
+ *  PRU Debug Program - PC trace file format
+ *
+ *  A trace is a sequence of samples, each a program counter with the time
+ *  it was first read and the number of consecutive polls that read it.
+ *  The file starts with a struct pru_trace_header, followed by blocks of
+ *  up to block_samples samples and, once the trace is complete, an index
+ *  of num_blocks struct pru_trace_index entries at index_offset.
+ *
+ *  Blocks and the index start at 8-byte aligned offsets.  Every block
+ *  starts with a struct pru_trace_block that repeats its index entry, so
+ *  a file whose index was never written can still be read by walking the
+ *  blocks.  The first sample of a block is stored in its
+ *  header and the data encodes every sample, the first one included,
+ *  against the one before it (the first one against pc - 1 and t), as
+ *  unsigned LEB128 varints.  A token is v << 1 | kind:
+ *
+ *    kind 0, sample	v is zigzag(pc - (prev_pc + 1)), followed by dt
+ *			in ns since the previous sample and polls - 1
+ *    kind 1, run	v more samples at prev_pc + 1, prev_pc + 2, ...
+ *			each with the dt and polls of the previous one
+ *
+ *  Straight-line code thus costs one byte per sample, or one token per
+ *  run when the samples come at a fixed rate, as with stepped traces.
+ *  All fields are little-endian.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdint.h>
+#include <stddef.h>
+
+#define PRU_TRACE_MAGIC		"PRUTRACE"
+#define PRU_TRACE_VERSION	2
+#define PRU_TRACE_BLOCK		4096	// samples per block written by prudebug
+
+struct pru_trace_header {
+	char			magic[8];
+	uint32_t		version;
+	uint32_t		header_len;	// bytes, the first block starts here
+	uint32_t		pru;
+	uint32_t		block_samples;
+	uint64_t		time;		// seconds since the epoch at the start
+	uint64_t		num_samples;
+	uint64_t		polls;		// status register reads
+	uint64_t		dropped;	// samples lost to a full ring
+	uint64_t		duration_ns;
+	uint64_t		index_offset;	// 0 if the trace was not completed
+	uint64_t		num_blocks;
+	char			processor[24];	// short name, e.g. "AM335X"
+};
+
+struct pru_trace_index {
+	uint64_t		sample;		// number of the block's first sample
+	uint64_t		t;		// and its time
+	uint64_t		offset;		// of the struct pru_trace_block
+	uint32_t		pc;		// of the first sample
+	uint32_t		samples;	// in the block
+};
+
+struct pru_trace_block {
+	uint32_t		len;		// bytes of data after this header
+	uint32_t		samples;
+	uint64_t		sample;
+	uint64_t		t;
+	uint32_t		pc;
+	uint32_t		reserved;
+};
+
+// one decoded sample, also what the sampler hands to the writer
+struct pru_trace_record {
+	uint64_t		t;		// ns since the start when pc was first read
+	uint32_t		pc;
+	uint32_t		polls;		// consecutive reads of this pc
+};
+
+// writing (tracefile.c)
+struct tracefile_writer {
+	int			fd;
+	int			err;		// errno of the first failed write
+	struct pru_trace_header	h;
+	struct pru_trace_index	*index;
+	uint64_t		index_alloc;
+	uint64_t		offset;		// where the next block goes
+	unsigned char		*buf;		// the block being encoded
+	size_t			len;
+	struct pru_trace_block	blk;
+	struct pru_trace_record	prev;
+	uint64_t		prev_dt;
+	uint32_t		run;		// samples in the pending run token
+};
+
+int tracefile_create(struct tracefile_writer *w, const char *fn, unsigned int pru,
+		     const char *processor);
+void tracefile_add(struct tracefile_writer *w, const struct pru_trace_record *s);
+int tracefile_finish(struct tracefile_writer *w);
+
+// reading (tracefile.c): mmap()ed, seeks through the index
+struct tracefile_reader {
+	const unsigned char	*data;
+	size_t			size;
+	const struct pru_trace_header *h;
+	struct pru_trace_index	*index;		// from the file or rebuilt
+	uint64_t		num_blocks;
+	int			own_index;
+	uint64_t		block;		// current block
+	const unsigned char	*p, *end;	// its undecoded data
+	uint64_t		left;		// samples not yet returned from it
+	struct pru_trace_record	prev;
+	uint64_t		prev_dt;
+	uint64_t		run;		// samples left of a run token
+};
+
+int tracefile_open(struct tracefile_reader *r, const char *fn);
+void tracefile_close(struct tracefile_reader *r);
+int tracefile_seek_sample(struct tracefile_reader *r, uint64_t n);
+int tracefile_seek_time(struct tracefile_reader *r, uint64_t t);
+int tracefile_next(struct tracefile_reader *r, struct pru_trace_record *s);
+
+#endif // TRACE_H
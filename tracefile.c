@@ -0,0 +1,392 @@
+/*
+ *
+ *  PRU Debug Program - PC trace files
+ *
+ *  Encoder and decoder for the block format in trace.h.  The writer keeps
+ *  one block and the index in memory and writes each block as it fills;
+ *  the reader maps the file and finds the block holding a sample number
+ *  or a time by binary search of the index, so only that block is
+ *  decoded.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+#define TRACE_MAX_TOKEN		(5 + 10 + 5)	// bytes of the largest sample token
+
+static inline uint64_t align8(uint64_t v)
+{
+	return (v + 7) & ~(uint64_t)7;
+}
+
+static inline unsigned char *put_varint(unsigned char *p, uint64_t v)
+{
+	while (v >= 0x80) {
+		*p++ = v | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+// read a varint, 0 if it runs past end
+static inline int get_varint(const unsigned char **p, const unsigned char *end, uint64_t *v)
+{
+	unsigned int		shift = 0;
+	uint64_t		x = 0;
+
+	while (*p < end && shift < 64) {
+		x |= (uint64_t)(**p & 0x7F) << shift;
+		if (!(*(*p)++ & 0x80)) {
+			*v = x;
+			return 1;
+		}
+		shift += 7;
+	}
+	return 0;
+}
+
+static void wr(struct tracefile_writer *w, const void *buf, size_t len, uint64_t off)
+{
+	ssize_t			n;
+
+	while (len && !w->err) {
+		n = pwrite(w->fd, buf, len, off);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			w->err = errno ? errno : EIO;
+			return;
+		}
+		buf = (const char *)buf + n;
+		len -= n;
+		off += n;
+	}
+}
+
+int tracefile_create(struct tracefile_writer *w, const char *fn, unsigned int pru,
+		     const char *processor)
+{
+	memset(w, 0, sizeof(*w));
+	w->buf = malloc(PRU_TRACE_BLOCK * TRACE_MAX_TOKEN);
+	if (!w->buf)
+		return -1;
+	w->fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (w->fd < 0) {
+		free(w->buf);
+		return -1;
+	}
+	memcpy(w->h.magic, PRU_TRACE_MAGIC, sizeof(w->h.magic));
+	w->h.version = PRU_TRACE_VERSION;
+	w->h.header_len = align8(sizeof(w->h));
+	w->h.pru = pru;
+	w->h.block_samples = PRU_TRACE_BLOCK;
+	w->h.time = time(NULL);
+	snprintf(w->h.processor, sizeof(w->h.processor), "%s", processor);
+	w->offset = w->h.header_len;
+	wr(w, &w->h, sizeof(w->h), 0);
+	return 0;
+}
+
+static void flush_run(struct tracefile_writer *w)
+{
+	if (w->run) {
+		w->len = put_varint(w->buf + w->len, (uint64_t)w->run << 1 | 1) - w->buf;
+		w->run = 0;
+	}
+}
+
+static void flush_block(struct tracefile_writer *w)
+{
+	static const unsigned char zero[8];
+	struct pru_trace_index	*x;
+
+	if (!w->blk.samples)
+		return;
+	flush_run(w);
+	if (w->h.num_blocks == w->index_alloc) {
+		w->index_alloc = w->index_alloc ? 2 * w->index_alloc : 256;
+		x = realloc(w->index, w->index_alloc * sizeof(*x));
+		if (!x) {
+			w->err = ENOMEM;
+			return;
+		}
+		w->index = x;
+	}
+	x = &w->index[w->h.num_blocks++];
+	x->sample = w->blk.sample;
+	x->t = w->blk.t;
+	x->offset = w->offset;
+	x->pc = w->blk.pc;
+	x->samples = w->blk.samples;
+	w->blk.len = w->len;
+	wr(w, &w->blk, sizeof(w->blk), w->offset);
+	wr(w, w->buf, w->len, w->offset + sizeof(w->blk));
+	w->offset += sizeof(w->blk) + w->len;
+	wr(w, zero, align8(w->offset) - w->offset, w->offset);
+	w->offset = align8(w->offset);
+	w->len = 0;
+	w->blk.samples = 0;
+}
+
+void tracefile_add(struct tracefile_writer *w, const struct pru_trace_record *s)
+{
+	unsigned char		*p;
+	uint64_t		dt;
+	int64_t			d;
+
+	if (!w->blk.samples) {
+		memset(&w->blk, 0, sizeof(w->blk));
+		w->blk.sample = w->h.num_samples;
+		w->blk.t = s->t;
+		w->blk.pc = s->pc;
+		w->prev.pc = s->pc - 1;
+		w->prev.t = s->t;
+		w->prev_dt = 0;
+	}
+	dt = s->t - w->prev.t;
+	if (w->blk.samples && s->pc == w->prev.pc + 1 && dt == w->prev_dt && s->polls == w->prev.polls) {
+		w->run++;
+	} else {
+		flush_run(w);
+		d = (int64_t)s->pc - ((int64_t)w->prev.pc + 1);
+		p = put_varint(w->buf + w->len, (((uint64_t)d << 1) ^ (uint64_t)(d >> 63)) << 1);
+		p = put_varint(p, dt);
+		p = put_varint(p, s->polls ? s->polls - 1 : 0);
+		w->len = p - w->buf;
+	}
+	w->prev = *s;
+	w->prev_dt = dt;
+	w->h.num_samples++;
+	if (++w->blk.samples == w->h.block_samples)
+		flush_block(w);
+}
+
+// write the last block, the index and the final header; the caller sets
+// the totals in w->h first.  Returns 0 or an errno.
+int tracefile_finish(struct tracefile_writer *w)
+{
+	int			err;
+
+	flush_block(w);
+	w->h.index_offset = w->offset;
+	wr(w, w->index, w->h.num_blocks * sizeof(w->index[0]), w->offset);
+	wr(w, &w->h, sizeof(w->h), 0);
+	if (close(w->fd) && !w->err)
+		w->err = errno;
+	free(w->index);
+	free(w->buf);
+	err = w->err;
+	memset(w, 0, sizeof(*w));
+	return err;
+}
+
+// walk the blocks of a file without an index
+static int rebuild_index(struct tracefile_reader *r)
+{
+	const struct pru_trace_block *b;
+	struct pru_trace_index	*x;
+	uint64_t		off = r->h->header_len, alloc = 0;
+
+	while (off + sizeof(*b) <= r->size) {
+		b = (const void *)(r->data + off);
+		if (!b->samples || off + sizeof(*b) + b->len > r->size)
+			break;
+		if (r->num_blocks == alloc) {
+			alloc = alloc ? 2 * alloc : 256;
+			x = realloc(r->index, alloc * sizeof(*x));
+			if (!x)
+				return -1;
+			r->index = x;
+		}
+		x = &r->index[r->num_blocks++];
+		x->sample = b->sample;
+		x->t = b->t;
+		x->offset = off;
+		x->pc = b->pc;
+		x->samples = b->samples;
+		off = align8(off + sizeof(*b) + b->len);
+	}
+	r->own_index = 1;
+	return 0;
+}
+
+int tracefile_open(struct tracefile_reader *r, const char *fn)
+{
+	struct stat		st;
+	void			*p;
+	int			fd;
+
+	memset(r, 0, sizeof(*r));
+	fd = open(fn, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(*r->h)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return -1;
+	r->data = p;
+	r->size = st.st_size;
+	r->h = p;
+	if (memcmp(r->h->magic, PRU_TRACE_MAGIC, sizeof(r->h->magic)) ||
+	    r->h->version != PRU_TRACE_VERSION || r->h->header_len > r->size) {
+		tracefile_close(r);
+		errno = EINVAL;
+		return -1;
+	}
+	if (r->h->index_offset && !(r->h->index_offset & 7) && r->h->index_offset <= r->size &&
+	    r->h->num_blocks <= (r->size - r->h->index_offset) / sizeof(r->index[0])) {
+		r->index = (struct pru_trace_index *)(r->data + r->h->index_offset);
+		r->num_blocks = r->h->num_blocks;
+	} else if (rebuild_index(r)) {
+		tracefile_close(r);
+		errno = ENOMEM;
+		return -1;
+	}
+	r->block = -1;
+	return 0;
+}
+
+void tracefile_close(struct tracefile_reader *r)
+{
+	if (r->own_index)
+		free(r->index);
+	if (r->data)
+		munmap((void *)r->data, r->size);
+	memset(r, 0, sizeof(*r));
+}
+
+// make block i the current one, before its first sample
+static int load_block(struct tracefile_reader *r, uint64_t i)
+{
+	const struct pru_trace_block *b;
+	const struct pru_trace_index *x = &r->index[i];
+
+	if (x->offset + sizeof(*b) > r->size)
+		return -1;
+	b = (const void *)(r->data + x->offset);
+	if (x->offset + sizeof(*b) + b->len > r->size)
+		return -1;
+	r->block = i;
+	r->p = (const unsigned char *)(b + 1);
+	r->end = r->p + b->len;
+	r->left = x->samples;
+	r->prev.pc = x->pc - 1;
+	r->prev.t = x->t;
+	r->prev.polls = 1;
+	r->prev_dt = 0;
+	r->run = 0;
+	return 0;
+}
+
+// the next sample into s: 1, or 0 at the end, -1 if the file is damaged
+int tracefile_next(struct tracefile_reader *r, struct pru_trace_record *s)
+{
+	uint64_t		v, dt, polls;
+	int64_t			d;
+
+	while (!r->left) {
+		if (r->block + 1 >= r->num_blocks)
+			return 0;
+		if (load_block(r, r->block + 1))
+			return -1;
+	}
+	if (r->run) {
+		r->run--;
+		r->prev.pc++;
+		r->prev.t += r->prev_dt;
+	} else {
+		if (!get_varint(&r->p, r->end, &v))
+			return -1;
+		if (v & 1) {
+			if (v < 2)
+				return -1;
+			r->run = (v >> 1) - 1;
+			r->prev.pc++;
+			r->prev.t += r->prev_dt;
+		} else {
+			if (!get_varint(&r->p, r->end, &dt) || !get_varint(&r->p, r->end, &polls))
+				return -1;
+			v >>= 1;
+			d = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+			r->prev.pc = r->prev.pc + 1 + d;
+			r->prev.t += dt;
+			r->prev.polls = polls + 1;
+			r->prev_dt = dt;
+		}
+	}
+	r->left--;
+	*s = r->prev;
+	return 1;
+}
+
+// position before sample n; -1 if there is no such sample
+int tracefile_seek_sample(struct tracefile_reader *r, uint64_t n)
+{
+	struct pru_trace_record	s;
+	uint64_t		lo = 0, hi = r->num_blocks, mid;
+
+	if (!r->num_blocks)
+		return -1;
+	// the last block starting at or before n
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (r->index[mid].sample <= n)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	if (n >= r->index[lo].sample + r->index[lo].samples || load_block(r, lo))
+		return -1;
+	for (mid = r->index[lo].sample; mid < n; mid++) {
+		if (tracefile_next(r, &s) != 1)
+			return -1;
+	}
+	return 0;
+}
+
+// position before the first sample at or after time t; -1 if there is none
+int tracefile_seek_time(struct tracefile_reader *r, uint64_t t)
+{
+	struct tracefile_reader	save;
+	struct pru_trace_record	s;
+	uint64_t		lo = 0, hi = r->num_blocks, mid;
+	int			k;
+
+	if (!r->num_blocks)
+		return -1;
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (r->index[mid].t <= t)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	if (load_block(r, lo))
+		return -1;
+	for (;;) {
+		save = *r;
+		k = tracefile_next(r, &s);
+		if (k != 1)
+			return -1;
+		if (s.t >= t) {
+			*r = save;
+			return 0;
+		}
+	}
+}
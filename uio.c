@@ -1,9 +1,17 @@
-/* 
+/*
  *
  *  PRU Debug Program - UIO routines
  *  (c) Copyright 2011,2013 by Arctica Technologies
  *  Written by Steven Anderson
  *
+ *  The PRUSS instances of the board are found with one pass over
+ *  /sys/class/uio and /sys/class/remoteproc.  A UIO device named pruss*
+ *  or icss* gives the instance address and length from its first map;
+ *  several UIO devices mapping the same PRUSS (uio_pruss creates one per
+ *  host interrupt) count once, with the lowest numbered device.  A
+ *  remoteproc PRU core gives the address of the PRUSS/ICSSG node it
+ *  sits under, the length is left to the processor database.
+ *
  */
 
 #include <stdio.h>
@@ -12,52 +20,189 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <string.h>
+#include <limits.h>
 
 #include "uio.h"
 
+#define UIO_CLASS		"/sys/class/uio"
+#define RPROC_CLASS		"/sys/class/remoteproc"
+
+static struct pruss_instance	inst[PRUSS_MAX_INSTANCES];
+static unsigned int		num_inst;
+static int			discovered;
+
+// read a one line sysfs attribute without its newline
+static int read_attr(const char *path, char *buf, size_t len)
+{
+	FILE			*f;
+	char			*nl;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fgets(buf, len, f) == NULL) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	nl = strchr(buf, '\n');
+	if (nl)
+		*nl = 0;
+	return 0;
+}
+
+static unsigned long read_attr_ulong(const char *path)
+{
+	char			buf[32];
+
+	if (read_attr(path, buf, sizeof(buf)))
+		return 0;
+	return strtoul(buf, NULL, 0);
+}
+
+// the instance at address, added if it is new; NULL if the table is full
+static struct pruss_instance *instance_at(unsigned long address)
+{
+	unsigned int		i;
+
+	for (i = 0; i < num_inst; i++) {
+		if (inst[i].map.address == address)
+			return &inst[i];
+	}
+	if (num_inst == PRUSS_MAX_INSTANCES)
+		return NULL;
+	memset(&inst[num_inst], 0, sizeof(inst[0]));
+	inst[num_inst].map.address = address;
+	return &inst[num_inst++];
+}
 
-// get UIO devices and put into structure
-int uio_getprussfile(char *devname, size_t len)
+static void scan_uio()
 {
 	DIR			*d;
 	struct dirent		*dent;
 	char			fn[UIO_MAX_UIO_FILEPATH];
-	FILE			*fd;
 	char			s_name[UIO_MAX_DEV_NAME];
-	
-	// clear user buffer
-	devname[0] = 0;
-	
-	// open directory /dev and scan for uio* files
-	d = opendir("/dev");
-	
-	// read in first entry
-	dent = readdir(d);
-	
-	// scan the entries
-	while (dent != NULL) {
-		// determine if this is a uio* file
-		if (dent->d_name[0] == 'u' && dent->d_name[1] == 'i' && dent->d_name[2] == 'o' && devname[0] == 0) {
-			// get uio device name and version
-			snprintf(fn, UIO_MAX_UIO_FILEPATH, "/sys/class/uio/%s/name", dent->d_name);
-			fd = fopen (fn, "r");
-			if (fgets(s_name, UIO_MAX_DEV_NAME, fd) == NULL) {
-				printf("Could not read from /sys/class/uio/%s/name\n", dent->d_name);
-			}
-			s_name[strlen(s_name)-1] = 0;
-			if (!strncmp(s_name, "pruss", 5)) {
-				snprintf(devname, len, "/dev/%s", dent->d_name);
-			}
-			fclose(fd);
-		}
-		
-		// read next directory entry
-		dent = readdir(d);
-	}
-	
-	// close directory handle
+	struct pruss_instance	*p;
+	unsigned long		address;
+
+	d = opendir(UIO_CLASS);
+	if (!d)
+		return;
+	while ((dent = readdir(d)) != NULL) {
+		if (strncmp(dent->d_name, "uio", 3))
+			continue;
+		snprintf(fn, sizeof(fn), UIO_CLASS "/%s/name", dent->d_name);
+		if (read_attr(fn, s_name, sizeof(s_name)) ||
+		    (strncmp(s_name, "pruss", 5) && strncmp(s_name, "icss", 4)))
+			continue;
+		snprintf(fn, sizeof(fn), UIO_CLASS "/%s/maps/map0/addr", dent->d_name);
+		address = read_attr_ulong(fn);
+		if (!address || !(p = instance_at(address)))
+			continue;
+		// keep the lowest numbered device of the instance
+		if (p->uio_file[0] && atoi(p->uio_file + 8) < atoi(dent->d_name + 3))
+			continue;
+		snprintf(p->uio_file, sizeof(p->uio_file), "/dev/%.*s",
+			 (int)sizeof(p->uio_file) - 6, dent->d_name);
+		snprintf(p->name, sizeof(p->name), "%s", s_name);
+		snprintf(fn, sizeof(fn), UIO_CLASS "/%s/maps/map0/size", dent->d_name);
+		p->map.length = read_attr_ulong(fn);
+	}
 	closedir(d);
-	
-	return 0;
 }
 
+static void scan_remoteproc()
+{
+	DIR			*d;
+	struct dirent		*dent;
+	char			fn[UIO_MAX_UIO_FILEPATH];
+	char			dev[PATH_MAX];
+	char			s_name[UIO_MAX_DEV_NAME];
+	struct pruss_instance	*p;
+	char			*parent, *slash;
+	unsigned long		address;
+
+	d = opendir(RPROC_CLASS);
+	if (!d)
+		return;
+	while ((dent = readdir(d)) != NULL) {
+		if (strncmp(dent->d_name, "remoteproc", 10))
+			continue;
+		snprintf(fn, sizeof(fn), RPROC_CLASS "/%s/name", dent->d_name);
+		if (read_attr(fn, s_name, sizeof(s_name)) ||
+		    (!strstr(s_name, "pru") && !strstr(s_name, "rtu")))
+			continue;
+		// .../4a300000.pruss/4a334000.pru: the parent node is the PRUSS
+		snprintf(fn, sizeof(fn), RPROC_CLASS "/%s/device", dent->d_name);
+		if (!realpath(fn, dev) || !(slash = strrchr(dev, '/')))
+			continue;
+		*slash = 0;
+		parent = strrchr(dev, '/');
+		parent = parent ? parent + 1 : dev;
+		if (!strstr(parent, "pruss") && !strstr(parent, "icss"))
+			continue;
+		address = strtoul(parent, NULL, 16);
+		if (!address || !(p = instance_at(address)))
+			continue;
+		if (!p->name[0])
+			snprintf(p->name, sizeof(p->name), "%.*s", (int)sizeof(p->name) - 1, parent);
+		p->num_cores++;
+	}
+	closedir(d);
+}
+
+static int instance_cmp(const void *a, const void *b)
+{
+	const struct pruss_instance *x = a, *y = b;
+
+	return x->map.address < y->map.address ? -1 : x->map.address > y->map.address;
+}
+
+// the PRUSS instances of the board, ordered by address; sysfs is read once
+const struct pruss_instance *pruss_instances(unsigned int *n)
+{
+	if (!discovered) {
+		scan_uio();
+		scan_remoteproc();
+		qsort(inst, num_inst, sizeof(inst[0]), instance_cmp);
+		discovered = 1;
+	}
+	*n = num_inst;
+	return inst;
+}
+
+// the instance a UIO device file belongs to, NULL if it is not a PRUSS
+const struct pruss_instance *pruss_find_uio(const char *uio_file)
+{
+	const struct pruss_instance *p;
+	unsigned int		i, n;
+
+	p = pruss_instances(&n);
+	for (i = 0; i < n; i++) {
+		if (!strcmp(p[i].uio_file, uio_file))
+			return &p[i];
+	}
+	return NULL;
+}
+
+void pruss_list()
+{
+	const struct pruss_instance *p;
+	unsigned int		i, n;
+
+	p = pruss_instances(&n);
+	if (n == 0) {
+		printf("No PRUSS instances found in " UIO_CLASS " or " RPROC_CLASS ".\n");
+		return;
+	}
+	printf("Idx  Address     Length      UIO device  Cores  Name\n");
+	for (i = 0; i < n; i++) {
+		printf("%3u  0x%08lx  ", i, p[i].map.address);
+		if (p[i].map.length)
+			printf("0x%08lx  ", p[i].map.length);
+		else
+			printf("%-10s  ", "-");
+		printf("%-10s  %5u  %s\n", p[i].uio_file[0] ? p[i].uio_file : "-",
+		       p[i].num_cores, p[i].name);
+	}
+}
@@ -1,4 +1,4 @@
-/* 
+/*
  *
  *  PRU Debug Program - UIO routine header file
  *  (c) Copyright 2011,2013 by Arctica Technologies
@@ -11,6 +11,7 @@
 
 #define UIO_MAX_UIO_FILEPATH	512		// maximum length of the path and name for a uio file (ex. /sys/class/uio/uio7/name)
 #define UIO_MAX_DEV_NAME	50
+#define PRUSS_MAX_INSTANCES	8		// PRUSS/ICSSG instances on one SoC
 
 
 struct uiomap {
@@ -18,16 +19,20 @@ struct uiomap {
 	unsigned long		length;
 };
 
-struct uiodev {
-	char			*uio_file;
-	char			*name;
-	char			*version;
-	struct uiomap		*maps;
+// a PRUSS found in sysfs, through its UIO device and/or the remoteproc
+// devices of its cores
+struct pruss_instance {
+	char			name[UIO_MAX_DEV_NAME];		// UIO name or DT node, e.g. 4a300000.pruss
+	char			uio_file[UIO_MAX_DEV_NAME];	// /dev/uioN, empty if there is none
+	struct uiomap		map;				// length is 0 if sysfs doesn't give it
+	unsigned int		num_cores;			// remoteproc PRU/RTU cores
 };
 
 
 // prototypes
-int uio_getprussfile(char *devname, size_t len);
+const struct pruss_instance *pruss_instances(unsigned int *n);
+const struct pruss_instance *pruss_find_uio(const char *uio_file);
+void pruss_list();
 
 #endif
 
@@ -0,0 +1,186 @@
+/*
+ *
+ *  PRU Debug Program - watch engine
+ *
+ *  Before a stepping run the watches of the active PRU are sorted by
+ *  address and merged into spans: watches that overlap or lie within
+ *  WATCH_SPAN_GAP bytes of each other are read together, rounded out to
+ *  whole words.  Every step reads each span once into a host buffer and
+ *  compares it with the previous read (libc's vectorized memcmp); only
+ *  when a span changed are the watches under the changed words looked at.
+ *  An unchanged span costs one burst read and one memcmp however many
+ *  watches it holds.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prudbg.h"
+#include "backend.h"
+
+#define WATCH_SPAN_GAP		64	// bytes between watches still read as one
+
+struct watch_span {
+	unsigned int		off;		// byte offset in the PRUSS, word aligned
+	unsigned int		len;		// bytes, whole words
+	unsigned char		*cur, *prev;
+	unsigned int		first, n;	// its watches: order[first .. first+n)
+};
+
+static struct watch_span	*spans;
+static unsigned int		num_spans;
+static unsigned int		order[MAX_WATCH];
+static int			first_step;
+
+static int watch_cmp(const void *a, const void *b)
+{
+	const struct watchvariable *x = &wa[pru_num][*(const unsigned int *)a];
+	const struct watchvariable *y = &wa[pru_num][*(const unsigned int *)b];
+
+	return x->address < y->address ? -1 : x->address > y->address;
+}
+
+// set up the spans for the watches of the active PRU, returns their number
+unsigned int watch_plan()
+{
+	struct watchvariable	*w;
+	struct watch_span	*s = NULL;
+	unsigned int		i, n = 0, start, end, base = pru_data_base[pru_num] * 4;
+
+	watch_done();
+	for (i = 0; i < MAX_WATCH; i++) {
+		if (wa[pru_num][i].state != WA_UNUSED)
+			order[n++] = i;
+	}
+	if (n == 0)
+		return 0;
+	qsort(order, n, sizeof(order[0]), watch_cmp);
+	spans = calloc(n, sizeof(*spans));
+	if (!spans) {
+		printf("ERROR: out of memory, watches ignored\n");
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		w = &wa[pru_num][order[i]];
+		start = (base + w->address) & ~3u;
+		end = (base + w->address + w->len + 3) & ~3u;
+		if (s && start <= s->off + s->len + WATCH_SPAN_GAP) {
+			if (end > s->off + s->len)
+				s->len = end - s->off;
+			s->n++;
+			continue;
+		}
+		s = &spans[num_spans++];
+		s->off = start;
+		s->len = end - start;
+		s->first = i;
+		s->n = 1;
+	}
+	for (i = 0; i < num_spans; i++) {
+		spans[i].cur = malloc(spans[i].len);
+		spans[i].prev = malloc(spans[i].len);
+		if (!spans[i].cur || !spans[i].prev) {
+			printf("ERROR: out of memory, watches ignored\n");
+			watch_done();
+			return 0;
+		}
+	}
+	first_step = 1;
+	return n;
+}
+
+void watch_done()
+{
+	unsigned int		i;
+
+	for (i = 0; i < num_spans; i++) {
+		free(spans[i].cur);
+		free(spans[i].prev);
+	}
+	free(spans);
+	spans = NULL;
+	num_spans = 0;
+}
+
+// the first and one past the last differing word of a and b, in bytes
+static void diff_range(const unsigned char *a, const unsigned char *b, unsigned int len,
+		       unsigned int *lo, unsigned int *hi)
+{
+	uint32_t		x, y;
+	unsigned int		i;
+
+	for (i = 0; i < len; i += 4) {
+		memcpy(&x, a + i, 4);
+		memcpy(&y, b + i, 4);
+		if (x != y)
+			break;
+	}
+	*lo = i;
+	for (i = len; i > *lo; i -= 4) {
+		memcpy(&x, a + i - 4, 4);
+		memcpy(&y, b + i - 4, 4);
+		if (x != y)
+			break;
+	}
+	*hi = i;
+}
+
+// check the watches of span s whose bytes overlap [lo, hi) of the span
+static int span_check(struct watch_span *s, unsigned int lo, unsigned int hi,
+		      unsigned int addr, unsigned long t)
+{
+	struct watchvariable	*w;
+	unsigned int		i, o, base = pru_data_base[pru_num] * 4;
+	int			stop = 0;
+
+	for (i = s->first; i < s->first + s->n; i++) {
+		w = &wa[pru_num][order[i]];
+		o = base + w->address - s->off;
+		if (o >= hi)
+			break;
+		if (o + w->len <= lo)
+			continue;
+		if (w->state == WA_PRINT_ON_ANY && memcmp(w->old_value, s->cur + o, w->len)) {
+			printf("@0x%04x  [0x%05x] t=%lu: ", addr, w->address, t);
+			cmd_dx_rows("", s->cur + o, -w->address, w->address, w->len);
+			memcpy(w->old_value, s->cur + o, w->len);
+		} else if (w->state == WA_HALT_ON_VALUE && !memcmp(w->value, s->cur + o, w->len)) {
+			printf("@0x%04x  [0x%05x] t=%lu: ", addr, w->address, t);
+			cmd_dx_rows("", s->cur + o, -w->address, w->address, w->len);
+			stop = 1;
+		}
+	}
+	return stop;
+}
+
+// Read the watched memory after step t, which left the PC at addr, and
+// report changes and matches.  Returns 1 if a halt-on-value watch matched.
+int watch_step(unsigned int addr, unsigned long t)
+{
+	struct watch_span	*s;
+	unsigned char		*tmp;
+	unsigned int		i, lo, hi;
+	int			stop = 0;
+
+	for (i = 0; i < num_spans; i++) {
+		s = &spans[i];
+		pru_read_block(s->off, s->cur, s->len);
+		if (first_step) {
+			// compare everything against the watch values once
+			lo = 0;
+			hi = s->len;
+		} else if (memcmp(s->cur, s->prev, s->len)) {
+			diff_range(s->cur, s->prev, s->len, &lo, &hi);
+		} else {
+			continue;
+		}
+		stop |= span_check(s, lo, hi, addr, t);
+		tmp = s->prev;
+		s->prev = s->cur;
+		s->cur = tmp;
+	}
+	first_step = 0;
+	return stop;
+}
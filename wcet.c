@@ -0,0 +1,617 @@
+/*
+ *
+ *  PRU Debug Program - static worst-case cycle count
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "prudbg.h"
+#include "da.h"
+#include "cfg.h"
+#include "wcet.h"
+
+#define FUNC_TODO		0
+#define FUNC_BUSY		1
+#define FUNC_DONE		2
+#define FUNC_FAILED		3
+
+#define WCET_UNREACHED		(~0ULL)
+
+struct wcet {
+	const struct cfg	*g;
+	const struct wcet_opts	*o;
+	uint64_t		*fcost;		// worst case of each function
+	unsigned char		*fstate;	// FUNC_*
+	const char		**fwhy;		// why a function has no bound
+	uint32_t		*fwhy_addr;
+	uint32_t		*pred, *pred_of; // predecessor lists, CSR
+
+	// scratch of one path search, indexed by block
+	uint32_t		*rep;		// loop header a block was collapsed into
+	uint64_t		*ncost;		// cost of a block or of its collapsed loop
+	uint32_t		*bound;		// bound of a collapsed loop, 0 if none
+	uint64_t		*iter;		// worst iteration of a collapsed loop
+	uint64_t		*dist;		// WCET_UNREACHED if not reached
+	uint32_t		*from;		// predecessor on the worst path
+	uint32_t		*reach, stamp;	// reachable from the source
+	uint32_t		*body, bstamp;	// in the loop being collapsed
+	uint32_t		*onstack;
+	uint32_t		*list, *order, *blist, *stack, *deg, *first;
+	uint32_t		*adj, *next, *back; // by edge
+
+	// why the last search failed
+	const char		*why;
+	uint32_t		why_addr;
+};
+
+static int wcet_error(struct wcet *w, const char *why, uint32_t addr)
+{
+	if (!w->why) {
+		w->why = why;
+		w->why_addr = addr;
+	}
+	return -1;
+}
+
+// annotation files
+
+static int add_item(void **p, uint32_t *n, size_t size, const void *item)
+{
+	void			*q = realloc(*p, (*n + 1) * size);
+
+	if (!q)
+		return -1;
+	memcpy((char *)q + *n * size, item, size);
+	*p = q;
+	(*n)++;
+	return 0;
+}
+
+int wcet_load(struct wcet_opts *o, const char *fn)
+{
+	FILE			*f;
+	char			line[256], *p;
+	unsigned long		a, b, c;
+	unsigned int		lineno = 0;
+	int			r = 0, n;
+
+	f = fopen(fn, "r");
+	if (!f) {
+		printf("ERROR: could not open %s\n", fn);
+		return -1;
+	}
+	while (r == 0 && fgets(line, sizeof(line), f)) {
+		lineno++;
+		if ((p = strchr(line, '#')))
+			*p = 0;
+		for (p = line; isspace((unsigned char)*p); p++)
+			;
+		if (!*p)
+			continue;
+		if (sscanf(p, "loop %li %li %n", &a, &b, &n) == 2 && !p[n]) {
+			struct wcet_bound	bd = {a, b};
+
+			r = add_item((void **)&o->bounds, &o->nbounds, sizeof(bd), &bd);
+		} else if (sscanf(p, "mem %li %li %li %n", &a, &b, &c, &n) == 3 && !p[n]) {
+			struct wcet_region	rg = {a, b, c};
+
+			r = add_item((void **)&o->regions, &o->nregions, sizeof(rg), &rg);
+		} else {
+			printf("ERROR: %s:%u: expected \"loop <addr> <count>\" or \"mem <addr> <len> <cycles>\"\n",
+			       fn, lineno);
+			r = -1;
+		}
+	}
+	fclose(f);
+	return r;
+}
+
+void wcet_free(struct wcet_opts *o)
+{
+	free(o->regions);
+	free(o->bounds);
+	memset(o, 0, sizeof(*o));
+}
+
+// block costs
+
+// extra cycles of an access, the worst region if the address is unknown
+static uint32_t mem_latency(const struct wcet_opts *o, int known, uint32_t addr, uint32_t len)
+{
+	uint32_t		i, worst = 0;
+
+	for (i = 0; i < o->nregions; i++) {
+		if (known && addr - o->regions[i].addr < o->regions[i].len &&
+		    len <= o->regions[i].len - (addr - o->regions[i].addr))
+			return o->regions[i].cycles;
+		if (o->regions[i].cycles > worst)
+			worst = o->regions[i].cycles;
+	}
+	return known ? 0 : worst;
+}
+
+// cycles of one instruction, without any callee
+static uint64_t inst_cost(struct wcet *w, const struct pru_insn *in, const struct pru_regval *t)
+{
+	uint32_t		addr = 0, len = pru_burst_len(in);
+	int			known;
+
+	if (!(in->flags & (PRU_INSN_LOAD | PRU_INSN_STORE)))
+		return 1;
+	known = pru_mem_addr(in, t, &addr);
+	return 1 + mem_latency(w->o, known, addr, len ? len : 1);
+}
+
+// cycles of instructions [lo, hi] of block b, callee included for a JAL
+static uint64_t range_cost(struct wcet *w, uint32_t b, uint32_t lo, uint32_t hi)
+{
+	const struct cfg_block	*blk = &w->g->blocks[b];
+	struct pru_regval	t;
+	struct pru_insn		in;
+	uint64_t		c = 0, ic;
+	uint32_t		pc, f;
+
+	memset(&t, 0, sizeof(t));
+	for (pc = blk->start; pc < blk->start + blk->len && pc <= hi; pc++) {
+		pru_decode(w->g->image[pc - w->g->base], &in);
+		ic = inst_cost(w, &in, &t);
+		pru_regval_update(&t, &in);
+		if (in.op == PRU_JAL) {
+			f = in.io ? cfg_func_entry(w->g, in.imm) : CFG_NONE;
+			if (f == CFG_NONE)
+				return wcet_error(w, "call with unknown target", pc), WCET_UNREACHED;
+			if (w->fstate[f] != FUNC_DONE)
+				return wcet_error(w, "callee has no bound", pc), WCET_UNREACHED;
+			ic += w->fcost[f];
+		}
+		if (pc >= lo)
+			c += ic;
+	}
+	return c;
+}
+
+
+// path search
+
+static uint32_t find(const struct wcet *w, uint32_t b)
+{
+	while (w->rep[b] != b)
+		b = w->rep[b];
+	return b;
+}
+
+// bound of the loop headed by block h, 0 if there is none
+static uint32_t loop_bound(const struct wcet *w, uint32_t h)
+{
+	const struct cfg	*g = w->g;
+	uint32_t		i, j;
+
+	for (i = 0; i < w->o->nbounds; i++)
+		if (cfg_block_at(g, w->o->bounds[i].addr) == h)
+			return w->o->bounds[i].count;
+	for (i = 0; i < g->nloops; i++) {
+		if (cfg_block_at(g, g->loops[i].start) != h)
+			continue;
+		for (j = 0; j < w->o->nbounds; j++)
+			if (w->o->bounds[j].addr == g->loops[i].addr)
+				return w->o->bounds[j].count;
+		if (g->loops[i].count)
+			return g->loops[i].count;
+	}
+	return 0;
+}
+
+// Longest path from src through nodes[0..n), the blocks whose in[] equals
+// stamp, as collapsed through rep[].  Edges back into src are dropped when
+// in_loop is set, any other cycle fails.  Fills dist and from.
+static int dag_longest(struct wcet *w, const uint32_t *nodes, uint32_t n,
+		       const uint32_t *in, uint32_t stamp, uint32_t src, int in_loop)
+{
+	const struct cfg	*g = w->g;
+	const struct cfg_edge	*e;
+	uint32_t		i, k, a, b, c, nadj = 0, head = 0, tail = 0, nnodes = 0;
+
+	for (i = 0; i < n; i++) {
+		b = nodes[i];
+		w->deg[b] = 0;
+		w->first[b] = CFG_NONE;
+		w->dist[b] = WCET_UNREACHED;
+		w->from[b] = CFG_NONE;
+	}
+	for (i = 0; i < n; i++) {
+		b = nodes[i];
+		a = find(w, b);
+		for (k = 0, e = &g->edges[g->blocks[b].edge]; k < g->blocks[b].nedges; k++, e++) {
+			if (e->to == CFG_NONE || in[e->to] != stamp)
+				continue;
+			c = find(w, e->to);
+			if (a == c || (in_loop && c == src))
+				continue;
+			w->adj[nadj] = c;
+			w->next[nadj] = w->first[a];
+			w->first[a] = nadj++;
+			w->deg[c]++;
+		}
+	}
+
+	// Kahn's algorithm, relaxing the edges of each node as it comes out
+	for (i = 0; i < n; i++) {
+		b = nodes[i];
+		if (find(w, b) != b)
+			continue;
+		nnodes++;
+		if (!w->deg[b])
+			w->stack[tail++] = b;
+	}
+	w->dist[src] = w->ncost[src];
+	while (head < tail) {
+		a = w->stack[head++];
+		for (k = w->first[a]; k != CFG_NONE; k = w->next[k]) {
+			c = w->adj[k];
+			if (w->dist[a] != WCET_UNREACHED &&
+			    (w->dist[c] == WCET_UNREACHED || w->dist[a] + w->ncost[c] > w->dist[c])) {
+				w->dist[c] = w->dist[a] + w->ncost[c];
+				w->from[c] = a;
+			}
+			if (!--w->deg[c])
+				w->stack[tail++] = c;
+		}
+	}
+	if (tail != nnodes)
+		return wcet_error(w, "irreducible loop", g->blocks[src].start);
+	return 0;
+}
+
+// collapse the loop headed by h, if h is the target of a back edge
+static int collapse_loop(struct wcet *w, uint32_t h, uint32_t nback)
+{
+	const struct cfg	*g = w->g;
+	uint32_t		i, k, b, u, nb = 0;
+	uint64_t		iter = 0;
+
+	w->bstamp++;
+	for (i = 0; i < nback; i++) {
+		if (g->edges[w->back[i]].to != h)
+			continue;
+		if (!nb) {
+			w->body[h] = w->bstamp;
+			w->blist[nb++] = h;
+		}
+		b = g->edges[w->back[i]].from;
+		if (w->body[b] != w->bstamp) {
+			w->body[b] = w->bstamp;
+			w->blist[nb++] = b;
+		}
+	}
+	if (!nb)
+		return 0;
+	if (find(w, h) != h)
+		return wcet_error(w, "irreducible loop", g->blocks[h].start);
+
+	// the natural loop: everything that reaches a back edge without h
+	for (k = 1; k < nb; k++) {
+		b = w->blist[k];
+		for (i = w->pred_of[b]; i < w->pred_of[b + 1]; i++) {
+			u = w->pred[i];
+			if (w->reach[u] != w->stamp || w->body[u] == w->bstamp)
+				continue;
+			w->body[u] = w->bstamp;
+			w->blist[nb++] = u;
+		}
+	}
+
+	w->bound[h] = loop_bound(w, h);
+	if (!w->bound[h])
+		return wcet_error(w, "loop needs a bound", g->blocks[h].start);
+	if (dag_longest(w, w->blist, nb, w->body, w->bstamp, h, 1))
+		return -1;
+	for (k = 0; k < nb; k++) {
+		b = w->blist[k];
+		if (find(w, b) == b && w->dist[b] != WCET_UNREACHED && w->dist[b] > iter)
+			iter = w->dist[b];
+	}
+	w->iter[h] = iter;
+	w->ncost[h] = iter * w->bound[h];
+	for (k = 0; k < nb; k++) {
+		b = find(w, w->blist[k]);
+		if (b != h)
+			w->rep[b] = h;
+	}
+	return 0;
+}
+
+// Worst path from instruction lo of block src to instruction hi of block
+// dst, or to the end of any block if dst is CFG_NONE.  Returns the cycles
+// in *len and the last node of the path in *end.
+static int search(struct wcet *w, uint32_t src, uint32_t lo, uint32_t dst, uint32_t hi,
+		  uint64_t *len, uint32_t *end)
+{
+	const struct cfg	*g = w->g;
+	uint32_t		n = 0, nfin = 0, nback = 0, sp, b, e, to, i;
+
+	// reachable blocks, back edges and the DFS finish order
+	w->stamp++;
+	w->reach[src] = w->onstack[src] = w->stamp;
+	w->deg[src] = 0;
+	w->list[n++] = src;
+	w->stack[0] = src;
+	sp = 1;
+	while (sp) {
+		b = w->stack[sp - 1];
+		if (w->deg[b] == g->blocks[b].nedges) {
+			w->onstack[b] = 0;
+			w->order[nfin++] = b;
+			sp--;
+			continue;
+		}
+		e = g->blocks[b].edge + w->deg[b]++;
+		to = g->edges[e].to;
+		if (to == CFG_NONE)
+			continue;
+		if (w->reach[to] == w->stamp) {
+			if (w->onstack[to] == w->stamp)
+				w->back[nback++] = e;
+			continue;
+		}
+		w->reach[to] = w->onstack[to] = w->stamp;
+		w->deg[to] = 0;
+		w->list[n++] = to;
+		w->stack[sp++] = to;
+	}
+
+	for (i = 0; i < n; i++) {
+		b = w->list[i];
+		w->rep[b] = b;
+		w->bound[b] = 0;
+		w->ncost[b] = range_cost(w, b, 0, CFG_NONE);
+		if (w->ncost[b] == WCET_UNREACHED)
+			return -1;
+	}
+	// inner loops finish first
+	for (i = 0; i < nfin; i++)
+		if (collapse_loop(w, w->order[i], nback))
+			return -1;
+
+	// only part of the first and last block when they are not loops
+	if (find(w, src) == src && !w->bound[src])
+		w->ncost[src] = range_cost(w, src, lo, dst == src ? hi : CFG_NONE);
+	if (dst != CFG_NONE) {
+		if (w->reach[dst] != w->stamp)
+			return wcet_error(w, "not reachable", g->blocks[dst].start);
+		if (dst != src && find(w, dst) == dst && !w->bound[dst])
+			w->ncost[dst] = range_cost(w, dst, 0, hi);
+	}
+	if (dag_longest(w, w->list, n, w->reach, w->stamp, find(w, src), 0))
+		return -1;
+
+	if (dst != CFG_NONE) {
+		*end = find(w, dst);
+		if (w->dist[*end] == WCET_UNREACHED)
+			return wcet_error(w, "not reachable", g->blocks[dst].start);
+	} else {
+		for (i = 0, *end = find(w, src); i < n; i++) {
+			b = w->list[i];
+			if (find(w, b) == b && w->dist[b] != WCET_UNREACHED && w->dist[b] > w->dist[*end])
+				*end = b;
+		}
+	}
+	*len = w->dist[*end];
+	return 0;
+}
+
+// worst case of function f from its entry to any exit, callees first
+static int func_cost(struct wcet *w, uint32_t f)
+{
+	const struct cfg	*g = w->g;
+	uint32_t		i, c, end;
+	uint64_t		len;
+
+	if (w->fstate[f] == FUNC_DONE)
+		return 0;
+	if (w->fstate[f] == FUNC_FAILED)
+		return -1;
+	if (w->fstate[f] == FUNC_BUSY)
+		return wcet_error(w, "recursive call", g->funcs[f].entry);
+	w->fstate[f] = FUNC_BUSY;
+	w->why = NULL;
+	for (i = 0; i < g->ncalls; i++) {
+		if (g->calls[i].caller != f)
+			continue;
+		c = g->calls[i].target == CFG_NONE ? CFG_NONE : cfg_func_entry(g, g->calls[i].target);
+		if (c == CFG_NONE) {
+			wcet_error(w, "call with unknown target", g->calls[i].site);
+			goto fail;
+		}
+		if (func_cost(w, c)) {
+			wcet_error(w, "callee has no bound", g->calls[i].site);
+			goto fail;
+		}
+		w->why = NULL;
+	}
+	if (search(w, g->funcs[f].block, g->funcs[f].entry, CFG_NONE, 0, &len, &end))
+		goto fail;
+	w->fcost[f] = len;
+	w->fstate[f] = FUNC_DONE;
+	return 0;
+
+fail:
+	w->fstate[f] = FUNC_FAILED;
+	w->fwhy[f] = w->why;
+	w->fwhy_addr[f] = w->why_addr;
+	return -1;
+}
+
+// report
+
+static void print_path(FILE *f, struct wcet *w, uint32_t src, uint32_t end)
+{
+	const struct cfg	*g = w->g;
+	const struct cfg_block	*blk;
+	uint32_t		n = 0, b;
+
+	for (b = end; b != CFG_NONE && n <= g->nblocks; b = w->from[b]) {
+		w->stack[n++] = b;
+		if (b == src)
+			break;
+	}
+	while (n--) {
+		b = w->stack[n];
+		blk = &g->blocks[b];
+		if (w->bound[b])
+			fprintf(f, "  0x%04x        loop %u x %llu = %llu cycles\n", blk->start,
+				w->bound[b], (unsigned long long)w->iter[b],
+				(unsigned long long)w->ncost[b]);
+		else
+			fprintf(f, "  0x%04x-0x%04x %llu cycles%s\n", blk->start, blk->start + blk->len - 1,
+				(unsigned long long)w->ncost[b],
+				blk->flags & CFG_BLOCK_CALL ? " (with call)" : "");
+	}
+}
+
+#define WCET_ALLOC(p, n)	((p) = calloc((n) + 1, sizeof(*(p))), ok = ok && (p))
+
+// per-function, per-block and loop bounds, then the worst path from-to
+// when from is not CFG_NONE
+int wcet_report(FILE *f, const struct cfg *g, const struct wcet_opts *o, uint32_t from, uint32_t to)
+{
+	struct wcet		w = {0};
+	const struct cfg_block	*blk;
+	uint32_t		i, b, e, src, dst, end, nb = g->nblocks, ne = g->nedges;
+	uint64_t		len;
+	int			ok = 1, r = 0;
+
+	w.g = g;
+	w.o = o;
+	WCET_ALLOC(w.fcost, g->nfuncs);
+	WCET_ALLOC(w.fstate, g->nfuncs);
+	WCET_ALLOC(w.fwhy, g->nfuncs);
+	WCET_ALLOC(w.fwhy_addr, g->nfuncs);
+	WCET_ALLOC(w.pred_of, nb + 1);
+	WCET_ALLOC(w.pred, ne);
+	WCET_ALLOC(w.rep, nb);
+	WCET_ALLOC(w.ncost, nb);
+	WCET_ALLOC(w.bound, nb);
+	WCET_ALLOC(w.iter, nb);
+	WCET_ALLOC(w.dist, nb);
+	WCET_ALLOC(w.from, nb);
+	WCET_ALLOC(w.reach, nb);
+	WCET_ALLOC(w.body, nb);
+	WCET_ALLOC(w.onstack, nb);
+	WCET_ALLOC(w.list, nb);
+	WCET_ALLOC(w.order, nb);
+	WCET_ALLOC(w.blist, nb);
+	WCET_ALLOC(w.stack, nb);
+	WCET_ALLOC(w.deg, nb);
+	WCET_ALLOC(w.first, nb);
+	WCET_ALLOC(w.adj, ne);
+	WCET_ALLOC(w.next, ne);
+	WCET_ALLOC(w.back, ne);
+	if (!ok) {
+		fprintf(stderr, "wcet: couldn't allocate memory\n");
+		r = -1;
+		goto cleanup;
+	}
+
+	// predecessors, counted and then placed
+	for (e = 0; e < ne; e++)
+		if (g->edges[e].to != CFG_NONE)
+			w.pred_of[g->edges[e].to + 1]++;
+	for (b = 0; b < nb; b++)
+		w.pred_of[b + 1] += w.pred_of[b];
+	for (b = 0; b < nb; b++)
+		w.first[b] = w.pred_of[b];
+	for (e = 0; e < ne; e++)
+		if (g->edges[e].to != CFG_NONE)
+			w.pred[w.first[g->edges[e].to]++] = g->edges[e].from;
+
+	fprintf(f, "Worst-case cycles: 1 per instruction, %u memory region%s, %u loop bound%s\n",
+		o->nregions, o->nregions == 1 ? "" : "s", o->nbounds, o->nbounds == 1 ? "" : "s");
+
+	fprintf(f, "\nFunctions:\n");
+	for (i = 0; i < g->nfuncs; i++)
+		func_cost(&w, i);
+	for (i = 0; i < g->nfuncs; i++) {
+		if (w.fstate[i] == FUNC_DONE)
+			fprintf(f, "  0x%04x  %llu cycles\n", g->funcs[i].entry,
+				(unsigned long long)w.fcost[i]);
+		else
+			fprintf(f, "  0x%04x  unbounded: %s at 0x%04x\n", g->funcs[i].entry,
+				w.fwhy[i] ? w.fwhy[i] : "unknown", w.fwhy_addr[i]);
+	}
+
+	fprintf(f, "\nBlocks:\n");
+	for (b = 0; b < nb; b++) {
+		blk = &g->blocks[b];
+		if (blk->func == CFG_NONE)
+			continue;
+		w.why = NULL;
+		len = range_cost(&w, b, 0, CFG_NONE);
+		fprintf(f, "  0x%04x-0x%04x %4u insns  ", blk->start, blk->start + blk->len - 1, blk->len);
+		if (len == WCET_UNREACHED)
+			fprintf(f, "unbounded: %s\n", w.why);
+		else
+			fprintf(f, "%llu cycles\n", (unsigned long long)len);
+	}
+
+	if (g->nloops) {
+		fprintf(f, "\nLOOP instructions:\n");
+		for (i = 0; i < g->nloops; i++) {
+			b = cfg_block_at(g, g->loops[i].start);
+			fprintf(f, "  0x%04x  body 0x%04x-0x%04x  ", g->loops[i].addr,
+				g->loops[i].start, g->loops[i].end - 1);
+			if (b != CFG_NONE && (e = loop_bound(&w, b)))
+				fprintf(f, "bound %u\n", e);
+			else
+				fprintf(f, "needs a bound\n");
+		}
+	}
+
+	if (from != CFG_NONE) {
+		src = cfg_block_at(g, from);
+		dst = cfg_block_at(g, to);
+		w.why = NULL;
+		if (src == CFG_NONE || dst == CFG_NONE) {
+			fprintf(f, "\nERROR: 0x%04x or 0x%04x is outside the image\n", from, to);
+			r = -1;
+		} else if (search(&w, src, from, dst, to, &len, &end)) {
+			fprintf(f, "\nWorst path 0x%04x -> 0x%04x: unbounded: %s at 0x%04x\n",
+				from, to, w.why ? w.why : "unknown", w.why_addr);
+			r = -1;
+		} else {
+			fprintf(f, "\nWorst path 0x%04x -> 0x%04x: %llu cycles\n", from, to,
+				(unsigned long long)len);
+			print_path(f, &w, find(&w, src), end);
+		}
+	}
+
+cleanup:
+	free(w.fcost);
+	free(w.fstate);
+	free(w.fwhy);
+	free(w.fwhy_addr);
+	free(w.pred_of);
+	free(w.pred);
+	free(w.rep);
+	free(w.ncost);
+	free(w.bound);
+	free(w.iter);
+	free(w.dist);
+	free(w.from);
+	free(w.reach);
+	free(w.body);
+	free(w.onstack);
+	free(w.list);
+	free(w.order);
+	free(w.blist);
+	free(w.stack);
+	free(w.deg);
+	free(w.first);
+	free(w.adj);
+	free(w.next);
+	free(w.back);
+	return r;
+}
@@ -0,0 +1,47 @@
+/*
+ *
+ *  PRU Debug Program - static worst-case cycle count header file
+ *
+ *  Works on a struct cfg.  Every instruction costs one cycle; loads and
+ *  stores add the latency of the memory region they hit, and a JAL adds
+ *  the worst case of the function it calls.  Loops are bounded by their
+ *  LOOP count or by an annotation and then collapsed, so the worst path is
+ *  a longest path in an acyclic graph.
+ *
+ *  Annotation files hold one item per line, '#' starts a comment:
+ *	loop <address> <count>		header executes at most count times
+ *	mem <address> <length> <cycles>	extra cycles per access to the region
+ *  Loop addresses are instruction word addresses (the LOOP instruction or
+ *  any instruction of the loop header), memory addresses are PRU data
+ *  addresses in bytes.
+ *
+ */
+
+#ifndef WCET_H
+#define WCET_H
+#include <stdio.h>
+#include <stdint.h>
+
+#include "cfg.h"
+
+struct wcet_region {
+	uint32_t		addr, len;
+	uint32_t		cycles;
+};
+
+struct wcet_bound {
+	uint32_t		addr;
+	uint32_t		count;
+};
+
+struct wcet_opts {
+	struct wcet_region	*regions;
+	struct wcet_bound	*bounds;
+	uint32_t		nregions, nbounds;
+};
+
+int wcet_load(struct wcet_opts *o, const char *fn);
+void wcet_free(struct wcet_opts *o);
+int wcet_report(FILE *f, const struct cfg *g, const struct wcet_opts *o, uint32_t from, uint32_t to);
+
+#endif // WCET_H